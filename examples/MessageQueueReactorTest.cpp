@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "MessageQueueReactor.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class NotifyMessageImpl : public INotifyMessage
+{
+public:
+	NotifyMessageImpl() : m_count(0) {}
+
+	// implements
+	void FirstMessageArrived(MessageQueue &mq)
+	{
+		std::vector<ByteBuffer> list;
+		Result res = mq.Receive(list);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			return;
+		}
+		::printf("[%lu] %s receved list size=%zu\n", Thread::CurrentThreadId(), mq.Name().c_str(), list.size());
+		m_count += list.size();
+	}
+
+	size_t m_count;
+};
+
+void test0(MessageQueueReactor &reactor, std::vector<MessageQueue *> &queues, std::vector<NotifyMessageImpl> &notifications)
+{
+	::printf("\ntest0 add/receive\n");
+
+	for (size_t i = 0; i < queues.size(); i++) {
+		Result res = reactor.Add(queues[i], &notifications[i]);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+		}
+	}
+	Result res = reactor.Add(queues[0], &notifications[0]);
+	::printf("add twice: %s\n", res.ErrorMessage().c_str());
+
+	reactor.Start();
+	for (size_t i = 0; i < queues.size(); i++) {
+		for (int j = 0; j < 3; j++) {
+			ByteBuffer bb;
+			bb.Append(j);
+			queues[i]->Send(bb);
+		}
+	}
+	Thread::MilliSleep(200);
+	for (size_t i = 0; i < queues.size(); i++) {
+		::printf("%s count %zu\n", queues[i]->Name().c_str(), notifications[i].m_count);
+	}
+}
+
+void test1(MessageQueueReactor &reactor, std::vector<MessageQueue *> &queues, std::vector<NotifyMessageImpl> &notifications)
+{
+	::printf("\ntest1 remove\n");
+
+	Result res = reactor.Remove(queues[0]);
+	::printf("remove: %s\n", (res ? "ok" : res.ErrorMessage().c_str()));
+	res = reactor.Remove(queues[0]);
+	::printf("remove twice: %s\n", res.ErrorMessage().c_str());
+
+	ByteBuffer bb;
+	bb.Append(0);
+	queues[0]->Send(bb);
+	Thread::MilliSleep(200);
+	::printf("%s CurrentMessageCount %ld (not received)\n", queues[0]->Name().c_str(), queues[0]->CurrentMessageCount());
+	queues[0]->Clear();
+}
+
+void test2(MessageQueueReactor &reactor, std::vector<MessageQueue *> &queues, std::vector<NotifyMessageImpl> &notifications)
+{
+	::printf("\ntest2 stop/restart\n");
+
+	reactor.Stop();
+	ByteBuffer bb;
+	bb.Append(0);
+	queues[1]->Send(bb);
+	Thread::MilliSleep(200);
+	::printf("stopped: %s CurrentMessageCount %ld\n", queues[1]->Name().c_str(), queues[1]->CurrentMessageCount());
+	reactor.Start();
+	Thread::MilliSleep(200);
+	::printf("restarted: %s CurrentMessageCount %ld\n", queues[1]->Name().c_str(), queues[1]->CurrentMessageCount());
+	reactor.Stop();
+}
+
+int main(int argc, char *argv[]) {
+	MessageQueueReactor reactor;
+	std::vector<MessageQueue *> queues;
+	std::vector<NotifyMessageImpl> notifications(4);
+	for (int i = 0; i < 4; i++) {
+		char name[32];
+		::snprintf(name, sizeof(name), "/mq_reactor%d", i);
+		queues.push_back(new MessageQueue(name, 10, 64));
+	}
+
+	test0(reactor, queues, notifications);
+	test1(reactor, queues, notifications);
+	test2(reactor, queues, notifications);
+
+	for (size_t i = 0; i < queues.size(); i++) {
+		delete queues[i];
+	}
+	return 0;
+}
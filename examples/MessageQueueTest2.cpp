@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "MessageQueue.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+void test0(MessageQueue &mq)
+{
+	::printf("\ntest0 batch send/receive\n");
+
+	std::vector<ByteBuffer> messages;
+	for (int i = 0; i < 12; i++) {
+		ByteBuffer bb;
+		bb.Append(i);
+		messages.push_back(bb);
+	}
+
+	// send message (over MaxMessageCount: the rest is not sent)
+	size_t count = 0;
+	Result res = mq.SendBatch(messages, 100, count);
+	::printf("sent %zu: %s\n", count, (res ? "ok" : res.ErrorMessage().c_str()));
+
+	// receive message (4 at once)
+	std::vector<ByteBuffer> received;
+	res = mq.ReceiveBatch(received, 4, 0, count);
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		::exit(1);
+	}
+	::printf("received %zu:", count);
+	for (size_t i = 0; i < count; i++) {
+		int no;
+		received[i].Value(no);
+		::printf(" %d", no);
+	}
+	::printf("\n");
+
+	// receive message (the rest)
+	res = mq.ReceiveBatch(received, 32, 0, count);
+	::printf("received %zu (buffers %zu)\n", count, received.size());
+
+	// receive message (no message: timeout error)
+	res = mq.ReceiveBatch(received, 32, 100, count);
+	::printf("timeout:%s\n", res.ErrorMessage().c_str());
+}
+
+void test1(MessageQueue &mq)
+{
+	::printf("\ntest1 receive into a buffer\n");
+
+	ByteBuffer bb;
+	bb.Append("direct message");
+	mq.Send(bb);
+
+	char buffer[256];
+	size_t size = 0;
+	Result res = mq.Receive(buffer, sizeof(buffer), size);
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		::exit(1);
+	}
+	::printf("received %zu bytes\n", size);
+
+	// receive message (no message: timeout error)
+	res = mq.TimedReceive(buffer, sizeof(buffer), size, 100);
+	::printf("timeout:%s\n", res.ErrorMessage().c_str());
+
+	// receive message (buffer smaller than MaxMessageSize: error)
+	mq.Send(bb);
+	res = mq.Receive(buffer, 16, size);
+	::printf("small buffer:%s\n", res.ErrorMessage().c_str());
+	mq.Clear();
+}
+
+int main(int argc, char *argv[]) {
+	MessageQueue mq("/mq_batch", 10, 256);
+
+	test0(mq);
+	test1(mq);
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "Rpc.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+struct Point
+{
+	int x;
+	int y;
+};
+
+Result Add(const Point &point, int &outSum)
+{
+	outSum = point.x + point.y;
+	return Result::CreateSuccess();
+}
+
+Result Check(const int &value, int &outValue)
+{
+	if (value < 0) {
+		return Result::CreateError("negative value %d", value);
+	}
+	outValue = value;
+	return Result::CreateSuccess();
+}
+
+Result Echo(const ByteBuffer &data, ByteBuffer &outData)
+{
+	outData.Assign(data.Data().data(), data.Size());
+	return Result::CreateSuccess();
+}
+
+// Handler writing the marshalled result itself
+class Rejecter : public IRpcHandler
+{
+public:
+	RpcStatus Call(ByteBuffer &args, ByteBuffer &outResult)
+	{
+		outResult.Append(12345);
+		outResult.Clear();
+		outResult.Append(std::string("rejected"));
+		return RPC_STATUS_FAILED;
+	}
+};
+
+class Greeter
+{
+public:
+	Greeter(const std::string &prefix) : m_prefix(prefix) {}
+
+	Result Greet(const std::string &name, std::string &outMessage)
+	{
+		outMessage = m_prefix + name;
+		return Result::CreateSuccess();
+	}
+
+	Result Lengths(const std::vector<std::string> &names, std::map<std::string, int> &outLengths)
+	{
+		for (size_t i = 0; i < names.size(); i++) {
+			outLengths[names[i]] = static_cast<int>(names[i].size());
+		}
+		return Result::CreateSuccess();
+	}
+
+private:
+	std::string m_prefix;
+};
+
+void test0(RpcDispatcher &dispatcher, UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 call\n");
+
+	RpcStub<Point, int> add(&client, 1);
+	Point point = {3, 4};
+	int sum = 0;
+	Result result = add.Call(point, sum);
+	::printf("add: %s %d\n", (result ? "ok" : result.ErrorMessage().c_str()), sum);
+
+	RpcStub<std::string, std::string> greet(&client, 3);
+	std::string message;
+	result = greet.Call("world", message);
+	::printf("greet: %s %s\n", (result ? "ok" : result.ErrorMessage().c_str()), message.c_str());
+
+	RpcStub<std::vector<std::string>, std::map<std::string, int> > lengths(&client, 4);
+	std::vector<std::string> names;
+	names.push_back("a");
+	names.push_back("abcd");
+	std::map<std::string, int> outLengths;
+	result = lengths.TimedCall(names, outLengths, 1000);
+	::printf("lengths: %s a=%d abcd=%d\n", (result ? "ok" : result.ErrorMessage().c_str()), outLengths["a"], outLengths["abcd"]);
+
+	// ByteBuffer argument (passed as const ByteBuffer &)
+	RpcStub<ByteBuffer, ByteBuffer> echo(&client, 5);
+	ByteBuffer data;
+	data.Append("payload");
+	ByteBuffer outData;
+	result = echo.Call(data, outData);
+	std::string payload;
+	outData.Value(payload);
+	::printf("echo: %s %s\n", (result ? "ok" : result.ErrorMessage().c_str()), payload.c_str());
+}
+
+void test1(RpcDispatcher &dispatcher, UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 error\n");
+
+	RpcStub<int, int> check(&client, 2);
+	int value = 0;
+	Result result = check.Call(-1, value);
+	::printf("handler error: %s\n", result.ErrorMessage().c_str());
+
+	RpcStub<int, int> unknown(&client, 9);
+	result = unknown.Call(1, value);
+	::printf("unknown method: %s\n", result.ErrorMessage().c_str());
+
+	// The handler clears its result before writing the message
+	RpcStub<int, int> reject(&client, 6);
+	result = reject.Call(1, value);
+	::printf("cleared result: %s\n", result.ErrorMessage().c_str());
+}
+
+void test2(RpcDispatcher &dispatcher, UnixDomainSocketClient &client)
+{
+	::printf("\ntest2 stats\n");
+
+	RpcStub<int, int> check(&client, 2);
+	for (int i = 0; i < 10; i++) {
+		int value = 0;
+		check.Call(i, value);
+	}
+	RpcMethodStats stats;
+	Result result = dispatcher.Stats(2, stats);
+	if (!result) {
+		::printf("err:%s\n", result.ErrorMessage().c_str());
+		return;
+	}
+	::printf("method 2 calls %lu errors %lu max %llu nsec\n", stats.calls, stats.errors, stats.maxNsec);
+	dispatcher.ResetStats();
+	dispatcher.Stats(2, stats);
+	::printf("reset calls %lu\n", stats.calls);
+}
+
+int main(int argc, char *argv[]) {
+	RpcDispatcher dispatcher;
+	RpcFunction<Point, int> add(Add);
+	RpcFunction<int, int> check(Check);
+	RpcFunction<ByteBuffer, ByteBuffer> echo(Echo);
+	Rejecter reject;
+	Greeter greeter("hello ");
+	RpcMemberFunction<Greeter, std::string, std::string> greet(&greeter, &Greeter::Greet);
+	RpcMemberFunction<Greeter, std::vector<std::string>, std::map<std::string, int> > lengths(&greeter, &Greeter::Lengths);
+	dispatcher.Register(1, &add);
+	dispatcher.Register(2, &check);
+	dispatcher.Register(3, &greet);
+	dispatcher.Register(4, &lengths);
+	dispatcher.Register(5, &echo);
+	dispatcher.Register(6, &reject);
+	Result result = dispatcher.Register(1, &check);
+	::printf("register twice: %s\n", result.ErrorMessage().c_str());
+
+	UnixDomainSocketServer server("/tmp/LightIPC_rpc", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	server.SetReceiver(&dispatcher);
+	server.SetWorkerCount(2);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_rpc", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	test0(dispatcher, client);
+	test1(dispatcher, client);
+	test2(dispatcher, client);
+
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "ShmMessageQueue.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+void test0(ShmMessageQueue &mq)
+{
+	::printf("\ntest0 shm message queue attribute check\n");
+
+	Result result = ShmMessageQueue::Exist("/shm_mq1");
+	if (result.IsError()) {
+		::printf("not found: %s\n",result.ErrorMessage().c_str());
+	} else {
+		::printf("found\n");
+	}
+	::printf("mq MaxMessageCount %ld\n", mq.MaxMessageCount());
+	::printf("mq MaxMessageSize %ld\n", mq.MaxMessageSize());
+	::printf("mq CurrentMessageCount %ld\n", mq.CurrentMessageCount());
+}
+
+void test1(ShmMessageQueue &owner, ShmMessageQueue &user)
+{
+	::printf("\ntest1 send/receive\n");
+
+	for (int i = 0; i < 3; i++) {
+		ByteBuffer bb;
+		bb.Append("hello %d",i);
+		Result res = owner.Send(bb);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+	}
+	::printf("CurrentMessageCount %ld\n", user.CurrentMessageCount());
+	for (int i = 0; i < 3; i++) {
+		ByteBuffer bb;
+		Result res = user.Receive(bb);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+		std::string recv;
+		bb.Value(recv);
+		::printf("recv:%s\n", recv.c_str());
+	}
+}
+
+void test2(ShmMessageQueue &owner, ShmMessageQueue &user)
+{
+	::printf("\ntest2 timeout/limit\n");
+
+	// receive message (no message: timeout error)
+	{
+		ByteBuffer bb;
+		Result res = user.TimedReceive(bb, 100);
+		if (!res) {
+			::printf("timeout:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+
+	// send message (overflow: error)
+	for (long i = 0; i < owner.MaxMessageCount(); i++) {
+		ByteBuffer bb;
+		bb.Append(static_cast<int>(i));
+		owner.Send(bb);
+	}
+	{
+		ByteBuffer bb;
+		bb.Append("Over MaxMessageCount");
+		Result res = owner.TimedSend(bb, 100);
+		if (!res) {
+			::printf("timeout:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+
+	// receive all messages
+	{
+		std::vector<ByteBuffer> list;
+		Result res = user.Receive(list);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+		::printf("receved list size=%zu\n", list.size());
+	}
+
+	// send message (too large: error)
+	{
+		ByteBuffer bb;
+		bb.Append(std::string(owner.MaxMessageSize() + 1, 'a'));
+		Result res = owner.Send(bb);
+		if (!res) {
+			::printf("too large:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+}
+
+class Consumer : public IRunnable
+{
+public:
+	void Run()
+	{
+		ShmMessageQueue mq("/shm_mq2");
+		long sum = 0;
+		for (int i = 0; i < 100000; i++) {
+			ByteBuffer bb;
+			Result res = mq.Receive(bb);
+			if (!res) {
+				::printf("err:%s\n", res.ErrorMessage().c_str());
+				break;
+			}
+			int no;
+			bb.Value(no);
+			sum += no;
+		}
+		::printf("[end receive] sum=%ld\n", sum);
+	}
+};
+
+void test3()
+{
+	::printf("\ntest3 producer/consumer (100000 messages)\n");
+
+	ShmMessageQueue mq("/shm_mq2", 16, 64);
+	Consumer consumer;
+	Thread t(&consumer, NULL);
+	t.Start();
+	::printf("[start send]\n");
+	for (int i = 0; i < 100000; i++) {
+		ByteBuffer bb;
+		bb.Append(i);
+		Result res = mq.Send(bb);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			break;
+		}
+	}
+	::printf("[end send]\n");
+	t.Join();
+}
+
+int main(int argc, char *argv[]) {
+	ShmMessageQueue owner("/shm_mq1", 3, 64);
+	ShmMessageQueue user("/shm_mq1");
+
+	test0(user);
+	test1(owner, user);
+	test2(owner, user);
+	test3();
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "ShmMpmcQueue.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+void test0(ShmMpmcQueue &mq)
+{
+	::printf("\ntest0 shm mpmc queue attribute check\n");
+
+	Result result = ShmMpmcQueue::Exist("/shm_mpmc1");
+	if (result.IsError()) {
+		::printf("not found: %s\n",result.ErrorMessage().c_str());
+	} else {
+		::printf("found\n");
+	}
+	::printf("mq MaxMessageCount %ld\n", mq.MaxMessageCount());
+	::printf("mq MaxMessageSize %ld\n", mq.MaxMessageSize());
+	::printf("mq CurrentMessageCount %ld\n", mq.CurrentMessageCount());
+}
+
+void test1(ShmMpmcQueue &owner, ShmMpmcQueue &user)
+{
+	::printf("\ntest1 send/receive\n");
+
+	for (int i = 0; i < 3; i++) {
+		ByteBuffer bb;
+		bb.Append("hello %d",i);
+		Result res = owner.Send(bb);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+	}
+	::printf("CurrentMessageCount %ld\n", user.CurrentMessageCount());
+	for (int i = 0; i < 3; i++) {
+		ByteBuffer bb;
+		Result res = user.Receive(bb);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+		std::string recv;
+		bb.Value(recv);
+		::printf("recv:%s\n", recv.c_str());
+	}
+}
+
+void test2(ShmMpmcQueue &owner, ShmMpmcQueue &user)
+{
+	::printf("\ntest2 timeout/limit\n");
+
+	// receive message (no message: timeout error)
+	{
+		ByteBuffer bb;
+		Result res = user.TimedReceive(bb, 100);
+		if (!res) {
+			::printf("timeout:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+
+	// send message (overflow: error)
+	for (long i = 0; i < owner.MaxMessageCount(); i++) {
+		ByteBuffer bb;
+		bb.Append(static_cast<int>(i));
+		owner.Send(bb);
+	}
+	{
+		ByteBuffer bb;
+		bb.Append("Over MaxMessageCount");
+		Result res = owner.TimedSend(bb, 100);
+		if (!res) {
+			::printf("timeout:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+
+	// receive all messages
+	{
+		std::vector<ByteBuffer> list;
+		Result res = user.Receive(list);
+		if (!res) {
+			::printf("err:%s\n", res.ErrorMessage().c_str());
+			::exit(1);
+		}
+		::printf("receved list size=%zu\n", list.size());
+	}
+
+	// send message (too large: error)
+	{
+		ByteBuffer bb;
+		bb.Append(std::string(owner.MaxMessageSize() + 1, 'a'));
+		Result res = owner.Send(bb);
+		if (!res) {
+			::printf("too large:%s\n", res.ErrorMessage().c_str());
+		} else {
+			::exit(1);
+		}
+	}
+}
+
+class Producer : public IRunnable
+{
+public:
+	void Run()
+	{
+		ShmMpmcQueue mq("/shm_mpmc2");
+		for (int i = 0; i < 50000; i++) {
+			ByteBuffer bb;
+			bb.Append(1);
+			Result res = mq.Send(bb);
+			if (!res) {
+				::printf("err:%s\n", res.ErrorMessage().c_str());
+				break;
+			}
+		}
+	}
+};
+
+class Consumer : public IRunnable
+{
+public:
+	Consumer() : m_count(0) {}
+
+	void Run()
+	{
+		ShmMpmcQueue mq("/shm_mpmc2");
+		do {
+			ByteBuffer bb;
+			Result res = mq.TimedReceive(bb, 500);
+			if (!res) {
+				break;
+			}
+			int no;
+			bb.Value(no);
+			m_count += no;
+		} while (true);
+	}
+
+	long m_count;
+};
+
+void test3()
+{
+	::printf("\ntest3 2 producers/2 consumers (100000 messages)\n");
+
+	ShmMpmcQueue mq("/shm_mpmc2", 16, 64);
+	Producer producer;
+	Consumer consumer1;
+	Consumer consumer2;
+	Thread c1(&consumer1, NULL);
+	Thread c2(&consumer2, NULL);
+	Thread p1(&producer, NULL);
+	Thread p2(&producer, NULL);
+	c1.Start();
+	c2.Start();
+	p1.Start();
+	p2.Start();
+	p1.Join();
+	p2.Join();
+	c1.Join();
+	c2.Join();
+	::printf("received %ld + %ld = %ld\n", consumer1.m_count, consumer2.m_count, consumer1.m_count + consumer2.m_count);
+}
+
+int main(int argc, char *argv[]) {
+	ShmMpmcQueue owner("/shm_mpmc1", 3, 64);
+	ShmMpmcQueue user("/shm_mpmc1");
+
+	test0(user);
+	test1(owner, user);
+	test2(owner, user);
+	test3();
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+void test(int no, UnixDomainSocket::SocketMode mode)
+{
+	::printf("\ntest%d abstract address, %s\n", no, (mode == UnixDomainSocket::SOCKET_MODE_SEQPACKET ? "seqpacket" : "datagram"));
+
+	// Only a name: no directory is needed and no socket file is created
+	UnixDomainSocketServer server("LightIPC_uds10", mode, UnixDomainSocket::ADDRESS_ABSTRACT);
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("LightIPC_uds10", mode, UnixDomainSocket::ADDRESS_ABSTRACT);
+	::printf("address:%s\n", (client.Address() == UnixDomainSocket::ADDRESS_ABSTRACT ? "abstract" : "filesystem"));
+	int errors = 0;
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer req;
+		ByteBuffer res;
+		req.Append(i);
+		Result result = client.SendReceive(req, res);
+		int value = 0;
+		res.Value(value);
+		if (!result || value != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d\n", errors);
+	::printf("socket file:%s\n", (::access("LightIPC_uds10", F_OK) == 0 ? "exists" : "none"));
+
+	// The name is released when the sockets are closed, the next server can take it at once
+	server.Stop();
+}
+
+int main(int argc, char *argv[]) {
+	test(0, UnixDomainSocket::SOCKET_MODE_DATAGRAM);
+	test(1, UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include <string>
+#include "UnixDomainSocket.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+// Heap allocations of the threads that count them
+static __thread bool s_isCounting = false;
+static __thread unsigned long s_allocations = 0;
+
+void *operator new(size_t size)
+{
+	if (s_isCounting) {
+		s_allocations++;
+	}
+	void *p = ::malloc(size ? size : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) throw()
+{
+	::free(p);
+}
+
+class MessageSender : public IRunnable
+{
+public:
+	MessageSender(UnixDomainSocket &sender, ByteBuffer &body, int count)
+		: m_sender(sender), m_body(body), m_count(count) {}
+
+	void Run()
+	{
+		ByteBuffer header;
+		header.Append(1);
+		for (int i = 0; i < m_count; i++) {
+			m_sender.Send(header, m_body);
+		}
+	}
+
+	UnixDomainSocket &m_sender;
+	ByteBuffer &m_body;
+	int m_count;
+};
+
+void test(int no, UnixDomainSocket &sender, UnixDomainSocket &receiver, size_t bodySize, bool isReused)
+{
+	::printf("\ntest%d %zu byte bodies (%s, %s buffers, 100 messages)\n", no, bodySize
+		, (sender.Framing() == UnixDomainSocket::FRAMING_DATAGRAM ? "datagram" : "fragmented")
+		, (isReused ? "reused" : "new"));
+
+	ByteBuffer body;
+	body.Append(std::string(bodySize, 'x'));
+	MessageSender messageSender(sender, body, 101);
+	Thread t(&messageSender, NULL);
+	t.Start();
+
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	// The first reception makes the buffers large enough
+	receiver.Receive(outHeader, outBody);
+
+	int errors = 0;
+	s_allocations = 0;
+	s_isCounting = true;
+	for (int i = 0; i < 100; i++) {
+		if (isReused) {
+			if (!receiver.Receive(outHeader, outBody) || outBody.Data() != body.Data()) {
+				errors++;
+			}
+		} else {
+			ByteBuffer newHeader;
+			ByteBuffer newBody;
+			if (!receiver.Receive(newHeader, newBody) || newBody.Data() != body.Data()) {
+				errors++;
+			}
+		}
+	}
+	s_isCounting = false;
+	t.Join();
+	::printf("errors %d, allocations %lu\n", errors, s_allocations);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds11", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds11", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+
+	test(0, partner, owner, 16*1024, false);
+	// Steady state: no allocation
+	test(1, partner, owner, 16*1024, true);
+	partner.SetFramingMode(UnixDomainSocket::FRAMING_FRAGMENTED);
+	test(2, partner, owner, 16*1024, false);
+	test(3, partner, owner, 16*1024, true);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
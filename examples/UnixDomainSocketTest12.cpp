@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+static double elapsedUsec(const timeval &start)
+{
+	timeval now;
+	::gettimeofday(&now, NULL);
+	return (now.tv_sec - start.tv_sec) * 1000000.0 + (now.tv_usec - start.tv_usec);
+}
+
+void test(int no, unsigned int busyPoll)
+{
+	::printf("\ntest%d busy poll %u us (10000 requests)\n", no, busyPoll);
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds12");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	// Both sides spin: the server for the requests, the client for the responses
+	server.SetBusyPoll(busyPoll);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds12");
+	client.SetBusyPoll(busyPoll);
+	client.Ping();
+
+	timeval start;
+	::gettimeofday(&start, NULL);
+	int errors = 0;
+	for (int i = 0; i < 10000; i++) {
+		ByteBuffer req;
+		ByteBuffer res;
+		req.Append(i);
+		Result result = client.SendReceive(req, res);
+		int value = 0;
+		res.Value(value);
+		if (!result || value != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d, %.1f us per request\n", errors, elapsedUsec(start) / 10000);
+	::printf("client hits:%lu misses:%lu\n", client.BusyPollHits(), client.BusyPollMisses());
+	::printf("server hits:%lu misses:%lu\n", server.BusyPollHits(), server.BusyPollMisses());
+
+	server.Stop();
+}
+
+int main(int argc, char *argv[]) {
+	// 0: Disabled, the counters stay 0
+	test(0, 0);
+	// Pays off only when the client and the server run on CPUs of their own
+	test(1, 50);
+	return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class SlowReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		// The request is the processing time (milliseconds)
+		int msec = 0;
+		request.Value(msec);
+		Thread::MilliSleep(msec);
+		response.Append(msec);
+	}
+};
+
+class ResponseReceiver : public IResponseReceiver
+{
+public:
+	ResponseReceiver() : m_count(0) {}
+
+	void ReceiveResponse(unsigned int requestId, const Result &result, ByteBuffer &response)
+	{
+		::printf("response of %u:%s\n", requestId, (result ? "ok" : result.ErrorMessage().c_str()));
+		m_count++;
+	}
+
+	int m_count;
+};
+
+void test0(UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 timed send/receive\n");
+
+	ByteBuffer req;
+	ByteBuffer res;
+	req.Append(10);
+	Result result = client.TimedSendReceive(req, res, 100);
+	::printf("10 ms request, 100 ms timeout:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+
+	// The late response is discarded when it arrives
+	req.Clear();
+	req.Append(300);
+	result = client.TimedSendReceive(req, res, 100);
+	::printf("300 ms request, 100 ms timeout:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 future timed wait and cancel\n");
+
+	ByteBuffer req;
+	req.Append(200);
+	ResponseFuture future;
+	client.AsyncSendReceive(req, future);
+	// The request is still in progress after the timeout
+	Result result = future.TimedWait(50);
+	::printf("timed wait 50 ms:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+	result = future.TimedWait(1000);
+	::printf("timed wait 1000 ms:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+
+	client.AsyncSendReceive(req, future);
+	result = future.Cancel();
+	::printf("cancel:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+	result = future.Wait();
+	::printf("wait:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+	// Nothing left to cancel
+	result = future.Cancel();
+	::printf("cancel again:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+}
+
+void test2(UnixDomainSocketClient &client)
+{
+	::printf("\ntest2 cancel a request of a response receiver\n");
+
+	ResponseReceiver receiver;
+	ByteBuffer req;
+	req.Append(200);
+	unsigned int requestId = 0;
+	client.AsyncSendReceive(req, &receiver, requestId);
+	// The receiver is called with the cancel error
+	Result result = client.CancelRequest(requestId);
+	::printf("cancel %u:%s\n", requestId, (result ? "ok" : result.ErrorMessage().c_str()));
+	Thread::MilliSleep(300);
+	::printf("responses %d\n", receiver.m_count);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds13");
+	SlowReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetWorkerCount(4);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds13");
+	test0(client);
+	test1(client);
+	test2(client);
+
+	server.Stop();
+	return 0;
+}
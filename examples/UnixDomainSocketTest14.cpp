@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		response.Append("plain response");
+	}
+};
+
+class StreamReceiver : public IStreamReceiver
+{
+public:
+	StreamReceiver() : m_size(0) {}
+
+	void StreamBegin(unsigned long streamId)
+	{
+		::printf("stream %lu begin\n", streamId);
+		m_size = 0;
+	}
+
+	void StreamReceived(unsigned long streamId, ByteBuffer &chunk)
+	{
+		m_size += chunk.Size();
+	}
+
+	void StreamEnd(unsigned long streamId, ByteBuffer &response)
+	{
+		::printf("stream %lu end %lu bytes\n", streamId, m_size);
+		response.Append(m_size);
+	}
+
+	void StreamAborted(unsigned long streamId)
+	{
+		::printf("stream %lu aborted %lu bytes\n", streamId, m_size);
+	}
+
+private:
+	unsigned long m_size;
+};
+
+void test0(UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 stream (64 chunks of 64KB)\n");
+
+	StreamWriter writer;
+	Result result = client.OpenStream(writer);
+	if (!result) {
+		::printf("open error :%s\n", result.ErrorMessage().c_str());
+		return;
+	}
+	ByteBuffer chunk(std::string(64 * 1024, 'c'));
+	for (int i = 0; i < 64; i++) {
+		result = writer.Write(chunk);
+		if (!result) {
+			::printf("write error :%s\n", result.ErrorMessage().c_str());
+			return;
+		}
+		if (i == 32) {
+			// other requests are served while the stream is open
+			ByteBuffer req;
+			ByteBuffer res;
+			result = client.SendReceive(req, res);
+			std::string plain;
+			res.Value(plain);
+			::printf("interleaved :%s\n", plain.c_str());
+		}
+	}
+	ByteBuffer response;
+	result = writer.Close(response);
+	if (!result) {
+		::printf("close error :%s\n", result.ErrorMessage().c_str());
+		return;
+	}
+	unsigned long size = 0;
+	response.Value(size);
+	::printf("response %lu bytes, open:%s\n", size, (writer.IsOpen() ? "true" : "false"));
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 stream abort\n");
+
+	StreamWriter writer;
+	client.OpenStream(writer);
+	ByteBuffer chunk(std::string(1024, 'a'));
+	writer.Write(chunk);
+	Result result = writer.Abort();
+	::printf("abort :%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+	Thread::MilliSleep(100);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds14", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	RequestReceiver receiver;
+	StreamReceiver streamReceiver;
+	server.SetReceiver(&receiver);
+	server.SetStreamReceiver(&streamReceiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds14", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	test0(client);
+	test1(client);
+
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <map>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+	}
+};
+
+class NotifyReceiver : public INotifyReceiver
+{
+public:
+	NotifyReceiver() : m_count(0) {}
+
+	void ReceiveNotify(ByteBuffer &update)
+	{
+		int key = 0;
+		int value = 0;
+		update.Value(key).Value(value);
+		m_values[key] = value;
+		m_count++;
+	}
+
+	int m_count;
+	std::map<int, int> m_values;
+};
+
+void test0(UnixDomainSocketServer &server, NotifyReceiver &notifyReceiver)
+{
+	::printf("\ntest0 queue 1000 notifications (sent by size and by delay)\n");
+
+	// Each datagram carries as many notifications as fit in 4096 bytes,
+	// the rest is sent 1 ms after it was queued
+	for (int i = 0; i < 1000; i++) {
+		ByteBuffer update;
+		update.Append(i).Append(i);
+		server.QueueNotify(update);
+	}
+	Thread::MilliSleep(200);
+	::printf("notified %d\n", notifyReceiver.m_count);
+}
+
+void test1(UnixDomainSocketServer &server, NotifyReceiver &notifyReceiver)
+{
+	::printf("\ntest1 queue 1000 values of 10 keys (latest value wins)\n");
+
+	notifyReceiver.m_count = 0;
+	notifyReceiver.m_values.clear();
+	for (int i = 0; i < 1000; i++) {
+		ByteBuffer update;
+		int key = i % 10;
+		update.Append(key).Append(i);
+		server.QueueNotify(key, update);
+	}
+	server.FlushNotify();
+	Thread::MilliSleep(200);
+	// The replaced values are never sent, each key ends with its latest value
+	bool isLatest = true;
+	for (int key = 0; key < 10; key++) {
+		if (notifyReceiver.m_values[key] != 990 + key) {
+			isLatest = false;
+		}
+	}
+	::printf("notified %d (at most 1000), latest:%s\n", notifyReceiver.m_count, (isLatest ? "true" : "false"));
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds15");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetNotifyCoalescing(4096, 1000);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds15");
+	NotifyReceiver notifyReceiver;
+	client.SetNotifyReceiver(&notifyReceiver);
+	client.Ping();
+	test0(server, notifyReceiver);
+	test1(server, notifyReceiver);
+
+	server.Stop();
+	return 0;
+}
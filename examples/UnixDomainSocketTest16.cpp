@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+class NotifyReceiver : public INotifyReceiver
+{
+public:
+	NotifyReceiver() : m_count(0) {}
+
+	void ReceiveNotify(ByteBuffer &update)
+	{
+		m_count++;
+	}
+
+	int m_count;
+};
+
+void test0(UnixDomainSocketServer &server, UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 engine\n");
+
+	// IO_ENGINE_SOCKET when io_uring is not available
+	::printf("server engine:%s\n", (server.Engine() == UnixDomainSocket::IO_ENGINE_URING ? "io_uring" : "socket"));
+	::printf("client engine:%s\n", (client.Engine() == UnixDomainSocket::IO_ENGINE_URING ? "io_uring" : "socket"));
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 send/receive (1000 requests)\n");
+
+	int errors = 0;
+	for (int i = 0; i < 1000; i++) {
+		ByteBuffer req;
+		ByteBuffer res;
+		req.Append(i);
+		Result result = client.SendReceive(req, res);
+		int no = 0;
+		res.Value(no);
+		if (!result || no != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d\n", errors);
+}
+
+void test2(UnixDomainSocketServer &server, NotifyReceiver &notifyReceiver)
+{
+	::printf("\ntest2 notify (100 messages)\n");
+
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer notify;
+		notify.Append(i);
+		server.Notify(notify);
+	}
+	Thread::MilliSleep(200);
+	::printf("notified %d\n", notifyReceiver.m_count);
+}
+
+class BatchSender : public IRunnable
+{
+public:
+	BatchSender(UnixDomainSocket &sender, int count) : m_sender(sender), m_count(count) {}
+
+	void Run()
+	{
+		std::vector<ByteBuffer> bodies(m_count);
+		std::vector<UnixDomainSocket::MessageBuffer> messages(m_count);
+		ByteBuffer header;
+		for (int i = 0; i < m_count; i++) {
+			bodies[i].Append(i);
+			messages[i].frame = NULL;
+			messages[i].header = &header;
+			messages[i].body = &bodies[i];
+			messages[i].mapped = NULL;
+		}
+		m_result = m_sender.SendBatch(messages);
+	}
+
+	UnixDomainSocket &m_sender;
+	int m_count;
+	Result m_result;
+};
+
+void test3(UnixDomainSocket &owner, UnixDomainSocket &partner)
+{
+	::printf("\ntest3 SendBatch through io_uring (200 messages)\n");
+
+	// More than the socket queue holds: the sends wait for room
+	BatchSender sender(partner, 200);
+	Thread t(&sender, NULL);
+	t.Start();
+	int errors = 0;
+	for (int i = 0; i < 200; i++) {
+		ByteBuffer header;
+		ByteBuffer body;
+		Result result = owner.Receive(header, body);
+		int no = -1;
+		body.Value(no);
+		if (!result || no != i) {
+			errors++;
+		}
+	}
+	t.Join();
+	::printf("send:%s errors %d\n", (sender.m_result ? "ok" : sender.m_result.ErrorMessage().c_str()), errors);
+}
+
+void test4(UnixDomainSocket &owner, UnixDomainSocket &partner)
+{
+	::printf("\ntest4 datagram larger than the io_uring buffers\n");
+
+	::printf("datagram size:%zu\n", owner.UringDatagramSize());
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(std::string(16*1024, 'x'));
+	partner.Send(header, body);
+
+	// The first one is lost as truncated, the buffers are rebuilt for the next one
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	Result result = owner.Receive(outHeader, outBody);
+	::printf("first:%s\n", (result ? "ok" : result.ErrorMessage().c_str()));
+	partner.Send(header, body);
+	result = owner.Receive(outHeader, outBody);
+	::printf("second:%s same:%s\n", (result ? "ok" : result.ErrorMessage().c_str())
+		, (outBody.Data() == body.Data() ? "yes" : "no"));
+	::printf("datagram size:%s\n", (owner.UringDatagramSize() >= 16*1024 ? "grown" : "not grown"));
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds16", UnixDomainSocket::SOCKET_MODE_DATAGRAM
+		, UnixDomainSocket::ADDRESS_FILESYSTEM, UnixDomainSocket::IO_ENGINE_URING);
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds16", UnixDomainSocket::SOCKET_MODE_DATAGRAM
+		, UnixDomainSocket::ADDRESS_FILESYSTEM, UnixDomainSocket::IO_ENGINE_URING);
+	NotifyReceiver notifyReceiver;
+	client.SetNotifyReceiver(&notifyReceiver);
+	test0(server, client);
+	test1(client);
+	test2(server, notifyReceiver);
+
+	server.Stop();
+
+	UnixDomainSocket owner("/tmp/LightIPC_uds16b", true, UnixDomainSocket::SOCKET_MODE_DATAGRAM
+		, UnixDomainSocket::ADDRESS_FILESYSTEM, UnixDomainSocket::IO_ENGINE_URING);
+	UnixDomainSocket partner("/tmp/LightIPC_uds16b", false, UnixDomainSocket::SOCKET_MODE_DATAGRAM
+		, UnixDomainSocket::ADDRESS_FILESYSTEM, UnixDomainSocket::IO_ENGINE_URING);
+	owner.SetUringDatagramSize(4096);
+	owner.OpenSocket();
+	partner.OpenSocket();
+	test3(owner, partner);
+	test4(owner, partner);
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
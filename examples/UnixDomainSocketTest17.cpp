@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "UnixDomainSocket.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class MessageSender : public IRunnable
+{
+public:
+	MessageSender(UnixDomainSocket &sender, const UnixDomainSocket::Frame *frame, ByteBuffer &header, ByteBuffer &body)
+		: m_sender(sender), m_frame(frame), m_header(header), m_body(body) {}
+
+	void Run()
+	{
+		if (m_frame) {
+			m_result = m_sender.Send(*m_frame, m_header, m_body);
+		} else {
+			m_result = m_sender.Send(m_header, m_body);
+		}
+	}
+
+	UnixDomainSocket &m_sender;
+	const UnixDomainSocket::Frame *m_frame;
+	ByteBuffer &m_header;
+	ByteBuffer &m_body;
+	Result m_result;
+};
+
+// frame NULL: sent without Frame
+void roundTrip(const char *name, UnixDomainSocket &sender, UnixDomainSocket &receiver
+	, const UnixDomainSocket::Frame *frame, size_t headerSize, size_t bodySize)
+{
+	ByteBuffer header;
+	ByteBuffer body;
+	header.Append(std::string(headerSize, 'h'));
+	body.Append(std::string(bodySize, 'b'));
+	// Send on another thread: a fragmented message can exceed what the socket holds
+	MessageSender messageSender(sender, frame, header, body);
+	Thread t(&messageSender, NULL);
+	t.Start();
+
+	UnixDomainSocket::Frame outFrame = {0xff, 0xff, 0xffffffff};
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	Result res = receiver.Receive(outFrame, outHeader, outBody);
+	t.Join();
+
+	UnixDomainSocket::Frame zero = {0, 0, 0};
+	const UnixDomainSocket::Frame &expected = (frame ? *frame : zero);
+	bool isSame = messageSender.m_result && res
+		&& outFrame.type == expected.type && outFrame.flags == expected.flags
+		&& outFrame.correlationId == expected.correlationId
+		&& outHeader.Data() == header.Data() && outBody.Data() == body.Data();
+	::printf("%s:%s (type:%u flags:0x%x correlationId:0x%x)\n", name, (isSame ? "ok" : "ng")
+		, outFrame.type, outFrame.flags, outFrame.correlationId);
+}
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 frame fields in a single datagram\n");
+
+	UnixDomainSocket::Frame frame = {7, 0x5, 0xdeadbeef};
+	roundTrip("no header", sender, receiver, &frame, 0, 100);
+	roundTrip("header", sender, receiver, &frame, 16, 100);
+	frame.type = 255;
+	frame.flags = 0xff;
+	frame.correlationId = 0xffffffff;
+	roundTrip("largest values", sender, receiver, &frame, 0, 0);
+}
+
+void test1(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest1 frame fields of fragmented messages\n");
+
+	UnixDomainSocket::Frame frame = {3, 0x1, 12345};
+	roundTrip("larger than a datagram", sender, receiver, &frame, 16, 1024*1024);
+	sender.SetFramingMode(UnixDomainSocket::FRAMING_FRAGMENTED);
+	roundTrip("FRAMING_FRAGMENTED", sender, receiver, &frame, 16, 10*1024);
+	roundTrip("FRAMING_FRAGMENTED, no header", sender, receiver, &frame, 0, 10*1024);
+	sender.SetFramingMode(UnixDomainSocket::FRAMING_DATAGRAM);
+}
+
+void test2(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest2 sent without frame (the received fields are zero)\n");
+
+	roundTrip("datagram", sender, receiver, NULL, 16, 100);
+	// Starts with the 8 byte Protocol Header of the older peers
+	sender.SetFramingMode(UnixDomainSocket::FRAMING_FRAGMENTED);
+	roundTrip("Protocol Header", sender, receiver, NULL, 16, 10*1024);
+	roundTrip("Protocol Header, no header", sender, receiver, NULL, 0, 10*1024);
+	sender.SetFramingMode(UnixDomainSocket::FRAMING_DATAGRAM);
+
+	// Received without frame
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(1);
+	UnixDomainSocket::Frame frame = {1, 0, 1};
+	sender.Send(frame, header, body);
+	Result res = receiver.Receive(header, body);
+	::printf("received without frame:%s\n", (res ? "ok" : res.ErrorMessage().c_str()));
+}
+
+void test3(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest3 frame fields of a batch (8 messages)\n");
+
+	std::vector<UnixDomainSocket::Frame> frames(8);
+	std::vector<ByteBuffer> headers(8);
+	std::vector<ByteBuffer> bodies(8);
+	std::vector<UnixDomainSocket::MessageBuffer> messages(8);
+	std::vector<UnixDomainSocket::Frame> outFrames(8);
+	std::vector<ByteBuffer> outHeaders(8);
+	std::vector<ByteBuffer> outBodies(8);
+	std::vector<UnixDomainSocket::MessageBuffer> buffers(8);
+	for (int i = 0; i < 8; i++) {
+		frames[i].type = static_cast<unsigned char>(i);
+		frames[i].flags = static_cast<unsigned char>(i * 2);
+		frames[i].correlationId = 1000 + i;
+		bodies[i].Append(i);
+		messages[i].frame = &frames[i];
+		messages[i].header = &headers[i];
+		messages[i].body = &bodies[i];
+		buffers[i].frame = &outFrames[i];
+		buffers[i].header = &outHeaders[i];
+		buffers[i].body = &outBodies[i];
+	}
+	Result res = sender.SendBatch(messages);
+	size_t received = 0;
+	int errors = 0;
+	while (res && received < 8) {
+		size_t count = 0;
+		std::vector<UnixDomainSocket::MessageBuffer> rest(buffers.begin() + received, buffers.end());
+		res = receiver.ReceiveBatch(rest, count);
+		received += count;
+	}
+	for (size_t i = 0; i < received; i++) {
+		if (outFrames[i].type != frames[i].type || outFrames[i].flags != frames[i].flags
+		 || outFrames[i].correlationId != frames[i].correlationId) {
+			errors++;
+		}
+	}
+	::printf("received %d, errors %d\n", static_cast<int>(received), errors);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds17", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds17", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+
+	test0(partner, owner);
+	test1(partner, owner);
+	test2(partner, owner);
+	test3(partner, owner);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
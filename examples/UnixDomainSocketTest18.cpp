@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "UnixDomainSocket.h"
+
+using namespace LightIPC;
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 send/receive with a checksum\n");
+
+	sender.SetChecksum(true);
+	ByteBuffer header;
+	ByteBuffer body;
+	header.Append(1);
+	body.Append(std::string(100*1024, 'x'));
+	UnixDomainSocket::Frame frame = {1, 0, 100};
+	Result res = sender.Send(frame, header, body);
+	::printf("send:%s\n", (res ? "ok" : res.ErrorMessage().c_str()));
+
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	res = receiver.Receive(outFrame, outHeader, outBody);
+	::printf("receive:%s size:%zu correlationId:%u\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, outBody.Size(), outFrame.correlationId);
+}
+
+void test1(const char *path, UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest1 resync after a datagram that does not start a message\n");
+
+	// Stands for the rest of a message whose first datagrams were lost
+	int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+	sockaddr_un addr;
+	::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	char garbage[64];
+	::memset(garbage, 0x5a, sizeof(garbage));
+	::sendto(fd, garbage, sizeof(garbage), 0, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+	::close(fd);
+
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(12345);
+	UnixDomainSocket::Frame frame = {1, 0, 101};
+	sender.Send(frame, header, body);
+
+	// The garbage is discarded, the reception continues with the next message
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	Result res = receiver.Receive(outFrame, outHeader, outBody);
+	int value = 0;
+	outBody.Value(value);
+	::printf("receive:%s value:%d correlationId:%u resync:%lu\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, value, outFrame.correlationId, receiver.ResyncCount());
+}
+
+void test2(const char *path, UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest2 resync when a message starts before the rest of a fragmented body\n");
+
+	// Capture the datagrams of a fragmented message with a short body
+	const char *capturePath = "/tmp/LightIPC_uds18c.rx";
+	::unlink(capturePath);
+	int captureFd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+	sockaddr_un addr;
+	::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	::strncpy(addr.sun_path, capturePath, sizeof(addr.sun_path) - 1);
+	::bind(captureFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+	UnixDomainSocket capture("/tmp/LightIPC_uds18c", false);
+	capture.OpenSocket();
+	capture.SetFramingMode(UnixDomainSocket::FRAMING_FRAGMENTED);
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(1);
+	UnixDomainSocket::Frame frame = {1, 0, 102};
+	capture.Send(frame, header, body);
+	char start[256];
+	ssize_t startSize = ::recv(captureFd, start, sizeof(start), MSG_DONTWAIT);
+	capture.CloseSocket();
+	::close(captureFd);
+	::unlink(capturePath);
+
+	// The start arrives, the body fragment is lost, the next message follows
+	int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+	::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	::sendto(fd, start, startSize, 0, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+	::close(fd);
+	body.Clear();
+	body.Append(67890);
+	frame.correlationId = 103;
+	sender.Send(frame, header, body);
+
+	// The next message is longer than the rest of the body, it is not cut into it
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	Result res = receiver.Receive(outFrame, outHeader, outBody);
+	::printf("lost:%s\n", (res ? "received" : res.ErrorMessage().c_str()));
+	res = receiver.Receive(outFrame, outHeader, outBody);
+	int value = 0;
+	outBody.Value(value);
+	::printf("receive:%s value:%d correlationId:%u\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, value, outFrame.correlationId);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds18", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds18", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+
+	test0(partner, owner);
+	// The owner receives on ${path}.rx
+	test1("/tmp/LightIPC_uds18.rx", partner, owner);
+	test2("/tmp/LightIPC_uds18.rx", partner, owner);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocket.h"
+
+using namespace LightIPC;
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 buffer sizes\n");
+
+	// The kernel reports twice the requested size
+	::printf("sender send buffer:%zu max datagram:%zu\n", sender.SendBufferSize(), sender.MaxDatagramSize());
+	::printf("receiver receive buffer:%zu\n", receiver.ReceiveBufferSize());
+}
+
+void test1(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest1 queue occupancy (5 messages of 10 KB not received yet)\n");
+
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(std::string(10*1024, 'x'));
+	UnixDomainSocket::Frame frame = {1, 0, 0};
+	for (int i = 0; i < 5; i++) {
+		sender.Send(frame, header, body);
+	}
+	// SIOCOUTQ: the bytes in flight, SIOCINQ: the size of the next datagram
+	::printf("send queue:%zu receive queue:%zu\n", sender.SendQueueSize(), receiver.ReceiveQueueSize());
+
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	for (int i = 0; i < 5; i++) {
+		receiver.Receive(outFrame, outHeader, outBody);
+	}
+	::printf("send queue:%zu receive queue:%zu\n", sender.SendQueueSize(), receiver.ReceiveQueueSize());
+}
+
+void test2(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest2 send buffer autotuning (up to 4 MB)\n");
+
+	sender.SetBufferAutotune(4*1024*1024);
+	size_t before = sender.SendBufferSize();
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(std::string(256*1024, 'y'));
+	UnixDomainSocket::Frame frame = {1, 0, 0};
+	sender.Send(frame, header, body);
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	receiver.Receive(outFrame, outHeader, outBody);
+	// Grown for the new peak message size
+	::printf("send buffer:%zu -> %zu, received:%zu\n", before, sender.SendBufferSize(), outBody.Size());
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds19", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds19", false);
+	// Applied when the sockets are opened, the receiver is not smaller than its partner
+	partner.SetSendBufferSize(512*1024);
+	owner.SetReceiveBufferSize(512*1024);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+
+	test0(partner, owner);
+	test1(partner, owner);
+	test2(partner, owner);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
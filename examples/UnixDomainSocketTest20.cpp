@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		// echo the body and its size
+		const std::string &body = request.Data();
+		response.Assign(body.data(), body.size());
+		response.Append(static_cast<int>(body.size()));
+	}
+};
+
+void test0(UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 enable bulk channel\n");
+
+	Result result = client.EnableBulkChannel(4096, 1024 * 1024);
+	::printf("enable :%s bulk:%s\n", (result ? "ok" : result.ErrorMessage().c_str()), (client.IsBulkChannel() ? "true" : "false"));
+	result = client.EnableBulkChannel(4096, 1024 * 1024);
+	::printf("enable twice :%s\n", result.ErrorMessage().c_str());
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 send/receive (socket and shared memory)\n");
+
+	size_t sizes[] = {10, 5000, 200000, 700000};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		ByteBuffer req(std::string(sizes[i], 'b'));
+		ByteBuffer res;
+		Result result = client.SendReceive(req, res);
+		if (!result) {
+			::printf("response error :%s\n", result.ErrorMessage().c_str());
+			continue;
+		}
+		::printf("request %zu bytes -> response %zu bytes\n", sizes[i], res.Size());
+	}
+}
+
+void test2(UnixDomainSocketClient &client)
+{
+	::printf("\ntest2 body larger than the ring\n");
+
+	ByteBuffer req(std::string(2 * 1024 * 1024, 'l'));
+	ByteBuffer res;
+	Result result = client.SendReceive(req, res);
+	::printf("response :%s %zu bytes\n", (result ? "ok" : result.ErrorMessage().c_str()), res.Size());
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds20", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds20", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	test0(client);
+	test1(client);
+	test2(client);
+
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Mutex.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	RequestReceiver() : m_count(0) {}
+
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		Thread::MilliSleep(1);
+		m_mutex.Lock();
+		m_count++;
+		m_mutex.Unlock();
+	}
+
+	Mutex m_mutex;
+	int m_count;
+};
+
+static double elapsedMsec(const timeval &start)
+{
+	timeval now;
+	::gettimeofday(&now, NULL);
+	return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+void test0()
+{
+	::printf("\ntest0 stop an idle server\n");
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds21");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+	Thread::MilliSleep(100);
+
+	// The reception thread is woken up at once, it does not wait for a timeout
+	timeval start;
+	::gettimeofday(&start, NULL);
+	server.Stop();
+	::printf("stopped in %.1f ms\n", elapsedMsec(start));
+}
+
+void test1()
+{
+	::printf("\ntest1 stop a server with queued requests (4 workers)\n");
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds21");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetWorkerCount(4);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds21");
+	ResponseFuture futures[100];
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer req;
+		req.Append(i);
+		client.AsyncSendReceive(req, futures[i]);
+	}
+	Thread::MilliSleep(10);
+
+	// The requests already received are processed before the threads stop
+	timeval start;
+	::gettimeofday(&start, NULL);
+	server.Stop();
+	::printf("stopped in %.1f ms, processed %d\n", elapsedMsec(start), receiver.m_count);
+}
+
+int main(int argc, char *argv[]) {
+	test0();
+	test1();
+	return 0;
+}
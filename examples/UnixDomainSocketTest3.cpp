@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <sys/socket.h>
+#include "UnixDomainSocket.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class MessageSender : public IRunnable
+{
+public:
+	MessageSender(UnixDomainSocket &sender, ByteBuffer &header, ByteBuffer &body)
+		: m_sender(sender), m_header(header), m_body(body) {}
+
+	void Run()
+	{
+		m_result = m_sender.Send(m_header, m_body);
+	}
+
+	UnixDomainSocket &m_sender;
+	ByteBuffer &m_header;
+	ByteBuffer &m_body;
+	Result m_result;
+};
+
+// Send on another thread: a fragmented message can exceed what the socket holds
+// before the receiver reads it
+bool roundTrip(UnixDomainSocket &sender, UnixDomainSocket &receiver, size_t bodySize)
+{
+	ByteBuffer header;
+	ByteBuffer body;
+	header.Append(static_cast<int>(bodySize));
+	body.Append(std::string(bodySize, 'x'));
+	MessageSender messageSender(sender, header, body);
+	Thread t(&messageSender, NULL);
+	t.Start();
+
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	Result res = receiver.Receive(outHeader, outBody);
+	t.Join();
+	if (!messageSender.m_result) {
+		::printf("send error # %s\n", messageSender.m_result.ErrorMessage().c_str());
+	}
+	if (!res) {
+		::printf("receive error # %s\n", res.ErrorMessage().c_str());
+	}
+	return messageSender.m_result && res && outHeader.Data() == header.Data() && outBody.Data() == body.Data();
+}
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 single datagram (max datagram size:%zu)\n", sender.MaxDatagramSize());
+
+	::printf("0 byte:%s\n", (roundTrip(sender, receiver, 0) ? "ok" : "ng"));
+	::printf("64 KB:%s\n", (roundTrip(sender, receiver, 64*1024) ? "ok" : "ng"));
+	::printf("max datagram size / 2:%s\n", (roundTrip(sender, receiver, sender.MaxDatagramSize() / 2) ? "ok" : "ng"));
+}
+
+void test1(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest1 larger than a datagram, fragmented\n");
+
+	::printf("max datagram size:%s\n", (roundTrip(sender, receiver, sender.MaxDatagramSize()) ? "ok" : "ng"));
+	::printf("1 MB:%s\n", (roundTrip(sender, receiver, 1024*1024) ? "ok" : "ng"));
+}
+
+void test2(UnixDomainSocket &partner, UnixDomainSocket &owner)
+{
+	::printf("\ntest2 FRAMING_FRAGMENTED and FRAMING_DATAGRAM talk to each other\n");
+
+	// The receiver accepts both framings regardless of its setting
+	partner.SetFramingMode(UnixDomainSocket::FRAMING_FRAGMENTED);
+	::printf("fragmented -> datagram 10 KB:%s\n", (roundTrip(partner, owner, 10*1024) ? "ok" : "ng"));
+	::printf("datagram -> fragmented 10 KB:%s\n", (roundTrip(owner, partner, 10*1024) ? "ok" : "ng"));
+	partner.SetFramingMode(UnixDomainSocket::FRAMING_DATAGRAM);
+	::printf("datagram -> datagram 10 KB:%s\n", (roundTrip(partner, owner, 10*1024) ? "ok" : "ng"));
+}
+
+void test3(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest3 send buffer lowered after the socket was opened (EMSGSIZE)\n");
+
+	// The sending sockets are the unbound datagram sockets
+	for (int fd = 3; fd < 256; fd++) {
+		int type = 0;
+		socklen_t optlen = sizeof(type);
+		sockaddr_storage addr;
+		socklen_t addrlen = sizeof(addr);
+		if (::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &optlen) == 0 && type == SOCK_DGRAM
+		 && ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addrlen) == 0
+		 && addr.ss_family == AF_UNIX && addrlen == sizeof(sa_family_t)) {
+			int size = 16*1024;
+			::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+		}
+	}
+
+	// Sent fragmented to what the buffer holds now
+	::printf("64 KB:%s\n", (roundTrip(sender, receiver, 64*1024) ? "ok" : "ng"));
+	::printf("max datagram size:%zu\n", sender.MaxDatagramSize());
+	::printf("64 KB again:%s\n", (roundTrip(sender, receiver, 64*1024) ? "ok" : "ng"));
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds3", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds3", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+
+	test0(partner, owner);
+	test1(partner, owner);
+	test2(partner, owner);
+	test3(partner, owner);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
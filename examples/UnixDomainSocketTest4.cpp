@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int thread = 0;
+		int no = 0;
+		request.Value(thread).Value(no);
+		response.Append(thread).Append(no * 2);
+	}
+};
+
+class RequestWorker : public IRunnable
+{
+public:
+	RequestWorker(UnixDomainSocketClient &client, int no) : m_client(client), m_no(no), m_errors(0) {}
+
+	void Run()
+	{
+		for (int i = 0; i < 1000; i++) {
+			ByteBuffer req;
+			ByteBuffer res;
+			req.Append(m_no).Append(i);
+			Result result = m_client.SendReceive(req, res);
+			int thread = -1;
+			int no = 0;
+			res.Value(thread).Value(no);
+			// The response must be the one of this thread's request
+			if (!result || thread != m_no || no != i * 2) {
+				m_errors++;
+			}
+		}
+	}
+
+	UnixDomainSocketClient &m_client;
+	int m_no;
+	int m_errors;
+};
+
+void test0(UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 send/receive from 1 thread (1000 requests)\n");
+
+	RequestWorker worker(client, 0);
+	Thread t(&worker, NULL);
+	t.Start();
+	t.Join();
+	::printf("errors %d\n", worker.m_errors);
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 send/receive from 8 threads at the same time (8 x 1000 requests)\n");
+
+	// The requests of the threads are pipelined on the one client,
+	// each response is handed to the thread waiting for it by its request ID
+	std::vector<RequestWorker *> workers;
+	std::vector<Thread *> threads;
+	for (int i = 0; i < 8; i++) {
+		workers.push_back(new RequestWorker(client, i));
+		threads.push_back(new Thread(workers.back(), NULL));
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i]->Start();
+	}
+	int errors = 0;
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i]->Join();
+		errors += workers[i]->m_errors;
+		delete threads[i];
+		delete workers[i];
+	}
+	::printf("errors %d\n", errors);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds4");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds4");
+	test0(client);
+	test1(client);
+
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Mutex.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+class ResponseReceiver : public IResponseReceiver
+{
+public:
+	ResponseReceiver() : m_count(0), m_errors(0) {}
+
+	void ReceiveResponse(unsigned int requestId, const Result &result, ByteBuffer &response)
+	{
+		int no = 0;
+		response.Value(no);
+		m_mutex.Lock();
+		// The server returns the doubled value
+		if (!result || no % 2 != 0) {
+			m_errors++;
+		}
+		m_count++;
+		m_mutex.Unlock();
+	}
+
+	int Count()
+	{
+		m_mutex.Lock();
+		int count = m_count;
+		m_mutex.Unlock();
+		return count;
+	}
+
+	Mutex m_mutex;
+	int m_count;
+	int m_errors;
+};
+
+void test0(UnixDomainSocketClient &client)
+{
+	::printf("\ntest0 future (1 request)\n");
+
+	ByteBuffer req;
+	req.Append(21);
+	ResponseFuture future;
+	Result result = client.AsyncSendReceive(req, future);
+	::printf("sent:%s requestId:%u\n", (result ? "ok" : result.ErrorMessage().c_str()), future.RequestId());
+
+	// Do something else until the response arrives
+	while (!future.IsReady()) {
+		Thread::Yield();
+	}
+	result = future.Wait();
+	int no = 0;
+	future.Response().Value(no);
+	::printf("response:%d (%s)\n", no, (result ? "ok" : result.ErrorMessage().c_str()));
+}
+
+void test1(UnixDomainSocketClient &client)
+{
+	::printf("\ntest1 future (100 requests in flight)\n");
+
+	// All the requests are sent before any response is waited for
+	ResponseFuture futures[100];
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer req;
+		req.Append(i);
+		client.AsyncSendReceive(req, futures[i]);
+	}
+	int errors = 0;
+	for (int i = 0; i < 100; i++) {
+		Result result = futures[i].Wait();
+		int no = 0;
+		futures[i].Response().Value(no);
+		if (!result || no != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d\n", errors);
+
+	// The futures can be reused once the response arrived
+	ByteBuffer req;
+	req.Append(50);
+	client.AsyncSendReceive(req, futures[0]);
+	futures[0].Wait();
+	int no = 0;
+	futures[0].Response().Value(no);
+	::printf("reused:%d\n", no);
+}
+
+void test2(UnixDomainSocketClient &client)
+{
+	::printf("\ntest2 response receiver (100 requests)\n");
+
+	ResponseReceiver receiver;
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer req;
+		req.Append(i);
+		unsigned int requestId = 0;
+		client.AsyncSendReceive(req, &receiver, requestId);
+	}
+	// ReceiveResponse() is called on the response thread of the client
+	for (int i = 0; i < 100 && receiver.Count() < 100; i++) {
+		Thread::MilliSleep(10);
+	}
+	::printf("received %d errors %d\n", receiver.Count(), receiver.m_errors);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds5");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds5");
+	test0(client);
+	test1(client);
+	test2(client);
+
+	server.Stop();
+	return 0;
+}
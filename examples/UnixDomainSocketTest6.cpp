@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class SlowReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		// Simulates a handler that waits for something (1 ms per request, -1: 300 ms)
+		Thread::MilliSleep(no == -1 ? 300 : 1);
+		response.Append(no * 2);
+	}
+};
+
+static double elapsedMsec(const timeval &start)
+{
+	timeval now;
+	::gettimeofday(&now, NULL);
+	return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+void test(int no, unsigned int workerCount, UnixDomainSocketServer::ResponseOrder order)
+{
+	::printf("\ntest%d %u worker threads, %s (200 requests in flight)\n", no, workerCount
+		, (order == UnixDomainSocketServer::RESPONSE_ORDER_COMPLETION ? "completion order" : "request order"));
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds6");
+	SlowReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetWorkerCount(workerCount);
+	server.SetResponseOrder(order);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds6");
+	timeval start;
+	::gettimeofday(&start, NULL);
+	ResponseFuture futures[200];
+	for (int i = 0; i < 200; i++) {
+		ByteBuffer req;
+		req.Append(i);
+		client.AsyncSendReceive(req, futures[i]);
+	}
+	int errors = 0;
+	for (int i = 0; i < 200; i++) {
+		Result result = futures[i].Wait();
+		int value = 0;
+		futures[i].Response().Value(value);
+		if (!result || value != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d, %.0f ms\n", errors, elapsedMsec(start));
+
+	server.Stop();
+}
+
+void test3()
+{
+	::printf("\ntest3 request order of 2 clients, one waiting for a slow request\n");
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds6", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	SlowReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetWorkerCount(4);
+	server.SetResponseOrder(UnixDomainSocketServer::RESPONSE_ORDER_REQUEST);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient slowClient("/tmp/LightIPC_uds6", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	UnixDomainSocketClient client("/tmp/LightIPC_uds6", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	ByteBuffer slowReq;
+	slowReq.Append(-1);
+	ResponseFuture slowFuture;
+	slowClient.AsyncSendReceive(slowReq, slowFuture);
+	ByteBuffer req;
+	req.Append(1);
+	ResponseFuture nextFuture;
+	slowClient.AsyncSendReceive(req, nextFuture);
+	Thread::MilliSleep(10);
+
+	// The responses are ordered per client, the other client is not held back
+	timeval start;
+	::gettimeofday(&start, NULL);
+	int errors = 0;
+	for (int i = 0; i < 10; i++) {
+		ByteBuffer res;
+		req.Clear();
+		req.Append(i);
+		Result result = client.SendReceive(req, res);
+		int value = 0;
+		res.Value(value);
+		if (!result || value != i * 2) {
+			errors++;
+		}
+	}
+	::printf("other client: errors %d, %s\n", errors, (elapsedMsec(start) < 200 ? "not held back" : "held back"));
+	// The response of the fast request follows the slow one
+	nextFuture.Wait();
+	::printf("slow client: slow response ready:%s\n", (slowFuture.IsReady() ? "true" : "false"));
+	slowFuture.Wait();
+
+	server.Stop();
+}
+
+int main(int argc, char *argv[]) {
+	// 0: the requests are processed one by one on the reception thread
+	test(0, 0, UnixDomainSocketServer::RESPONSE_ORDER_COMPLETION);
+	test(1, 8, UnixDomainSocketServer::RESPONSE_ORDER_COMPLETION);
+	test(2, 8, UnixDomainSocketServer::RESPONSE_ORDER_REQUEST);
+	test3();
+	return 0;
+}
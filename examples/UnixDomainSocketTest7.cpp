@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+class NotifyReceiver : public INotifyReceiver
+{
+public:
+	NotifyReceiver() : m_count(0) {}
+
+	void ReceiveNotify(ByteBuffer &update)
+	{
+		m_count++;
+	}
+
+	int m_count;
+};
+
+void test0(UnixDomainSocketServer &server, std::vector<UnixDomainSocketClient *> &clients)
+{
+	::printf("\ntest0 connect %d clients\n", static_cast<int>(clients.size()));
+
+	for (size_t i = 0; i < clients.size(); i++) {
+		Result result = clients[i]->Ping();
+		if (!result) {
+			::printf("ping error # %s\n", result.ErrorMessage().c_str());
+		}
+	}
+	::printf("connections %d\n", static_cast<int>(server.ConnectionCount()));
+}
+
+void test1(std::vector<UnixDomainSocketClient *> &clients)
+{
+	::printf("\ntest1 send/receive from each client (100 requests each)\n");
+
+	// Each client has its own connection, the responses never cross
+	int errors = 0;
+	for (int i = 0; i < 100; i++) {
+		for (size_t c = 0; c < clients.size(); c++) {
+			ByteBuffer req;
+			ByteBuffer res;
+			int value = static_cast<int>(c) * 1000 + i;
+			req.Append(value);
+			Result result = clients[c]->SendReceive(req, res);
+			int no = 0;
+			res.Value(no);
+			if (!result || no != value * 2) {
+				errors++;
+			}
+		}
+	}
+	::printf("errors %d\n", errors);
+}
+
+void test2(UnixDomainSocketServer &server, std::vector<NotifyReceiver *> &notifyReceivers)
+{
+	::printf("\ntest2 notify all the clients (10 messages)\n");
+
+	for (int i = 0; i < 10; i++) {
+		ByteBuffer notify;
+		notify.Append(i);
+		server.Notify(notify);
+	}
+	Thread::MilliSleep(200);
+	for (size_t i = 0; i < notifyReceivers.size(); i++) {
+		::printf("client%d notified %d\n", static_cast<int>(i), notifyReceivers[i]->m_count);
+	}
+}
+
+void test3(UnixDomainSocketServer &server, std::vector<UnixDomainSocketClient *> &clients)
+{
+	::printf("\ntest3 disconnect 1 client\n");
+
+	delete clients.back();
+	clients.pop_back();
+	Thread::MilliSleep(200);
+	::printf("connections %d\n", static_cast<int>(server.ConnectionCount()));
+}
+
+void test4(UnixDomainSocketServer &server)
+{
+	::printf("\ntest4 a client that does not read its notifications\n");
+
+	// Connects and never receives
+	UnixDomainSocket idle("/tmp/LightIPC_uds7", false, UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	idle.OpenSocket();
+	Thread::MilliSleep(100);
+	::printf("connections %d\n", static_cast<int>(server.ConnectionCount()));
+
+	// Its socket buffer fills up, after SetSendTimeout() it is disconnected
+	ByteBuffer notify;
+	notify.Append(std::string(64*1024, 'x'));
+	for (int i = 0; i < 100 && server.ConnectionCount() > 2; i++) {
+		server.Notify(notify);
+		Thread::MilliSleep(10);
+	}
+	::printf("connections %d\n", static_cast<int>(server.ConnectionCount()));
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocketServer server("/tmp/LightIPC_uds7", UnixDomainSocket::SOCKET_MODE_SEQPACKET);
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	// A client that does not read its notifications holds Notify() at most this long
+	server.SetSendTimeout(100);
+	server.Start(false); // non block
+
+	std::vector<UnixDomainSocketClient *> clients;
+	std::vector<NotifyReceiver *> notifyReceivers;
+	for (int i = 0; i < 3; i++) {
+		clients.push_back(new UnixDomainSocketClient("/tmp/LightIPC_uds7", UnixDomainSocket::SOCKET_MODE_SEQPACKET));
+		notifyReceivers.push_back(new NotifyReceiver());
+		clients.back()->SetNotifyReceiver(notifyReceivers.back());
+	}
+	test0(server, clients);
+	test1(clients);
+	test2(server, notifyReceivers);
+	test3(server, clients);
+	test4(server);
+
+	for (size_t i = 0; i < clients.size(); i++) {
+		delete clients[i];
+	}
+	for (size_t i = 0; i < notifyReceivers.size(); i++) {
+		delete notifyReceivers[i];
+	}
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+#include "UnixDomainSocket.h"
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+#include "Thread.h"
+
+using namespace LightIPC;
+
+class RequestReceiver : public IRequestReceiver
+{
+public:
+	void Received(ByteBuffer &request, ByteBuffer &response)
+	{
+		int no = 0;
+		request.Value(no);
+		response.Append(no * 2);
+	}
+};
+
+class NotifyReceiver : public INotifyReceiver
+{
+public:
+	NotifyReceiver() : m_count(0), m_errors(0) {}
+
+	void ReceiveNotify(ByteBuffer &update)
+	{
+		int no = 0;
+		update.Value(no);
+		// The messages of a batch arrive in order
+		if (no != m_count) {
+			m_errors++;
+		}
+		m_count++;
+	}
+
+	int m_count;
+	int m_errors;
+};
+
+class BatchSender : public IRunnable
+{
+public:
+	BatchSender(UnixDomainSocket &sender) : m_sender(sender) {}
+
+	void Run()
+	{
+		std::vector<ByteBuffer> headers(100);
+		std::vector<ByteBuffer> bodies(100);
+		std::vector<UnixDomainSocket::MessageBuffer> messages(100);
+		for (int i = 0; i < 100; i++) {
+			bodies[i].Append(i);
+			messages[i].header = &headers[i];
+			messages[i].body = &bodies[i];
+		}
+		m_result = m_sender.SendBatch(messages);
+	}
+
+	UnixDomainSocket &m_sender;
+	Result m_result;
+};
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 send 100 messages at once, receive them 16 at a time\n");
+
+	// SendBatch() blocks while the queue of the receiver is full (net.unix.max_dgram_qlen)
+	BatchSender batchSender(sender);
+	Thread t(&batchSender, NULL);
+	t.Start();
+
+	std::vector<ByteBuffer> outHeaders(16);
+	std::vector<ByteBuffer> outBodies(16);
+	std::vector<UnixDomainSocket::MessageBuffer> buffers(16);
+	for (int i = 0; i < 16; i++) {
+		buffers[i].header = &outHeaders[i];
+		buffers[i].body = &outBodies[i];
+	}
+	int received = 0;
+	int batches = 0;
+	int errors = 0;
+	while (received < 100) {
+		size_t count = 0;
+		Result res = receiver.ReceiveBatch(buffers, count);
+		if (!res) {
+			::printf("receive error # %s\n", res.ErrorMessage().c_str());
+			break;
+		}
+		for (size_t i = 0; i < count; i++) {
+			int no = 0;
+			outBodies[i].Value(no);
+			if (no != received) {
+				errors++;
+			}
+			received++;
+		}
+		batches++;
+	}
+	t.Join();
+	::printf("send:%s\n", (batchSender.m_result ? "ok" : batchSender.m_result.ErrorMessage().c_str()));
+	::printf("received %d in %d batches, errors %d\n", received, batches, errors);
+}
+
+void test1(UnixDomainSocketServer &server, NotifyReceiver &notifyReceiver)
+{
+	::printf("\ntest1 notify 100 messages at once\n");
+
+	std::vector<ByteBuffer> updates(100);
+	for (int i = 0; i < 100; i++) {
+		updates[i].Append(i);
+	}
+	Result res = server.Notify(updates);
+	::printf("notify:%s\n", (res ? "ok" : res.ErrorMessage().c_str()));
+	Thread::MilliSleep(200);
+	::printf("notified %d, errors %d\n", notifyReceiver.m_count, notifyReceiver.m_errors);
+}
+
+void test2(UnixDomainSocketClient &client)
+{
+	::printf("\ntest2 100 requests in flight, received by the server 32 at a time\n");
+
+	ResponseFuture futures[100];
+	for (int i = 0; i < 100; i++) {
+		ByteBuffer req;
+		req.Append(i);
+		client.AsyncSendReceive(req, futures[i]);
+	}
+	int errors = 0;
+	for (int i = 0; i < 100; i++) {
+		Result result = futures[i].Wait();
+		int no = 0;
+		futures[i].Response().Value(no);
+		if (!result || no != i * 2) {
+			errors++;
+		}
+	}
+	::printf("errors %d\n", errors);
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds8", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds8", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	test0(partner, owner);
+	partner.CloseSocket();
+	owner.CloseSocket();
+
+	UnixDomainSocketServer server("/tmp/LightIPC_uds8");
+	RequestReceiver receiver;
+	server.SetReceiver(&receiver);
+	server.SetReceiveBatchSize(32);
+	server.Start(false); // non block
+
+	UnixDomainSocketClient client("/tmp/LightIPC_uds8");
+	NotifyReceiver notifyReceiver;
+	client.SetNotifyReceiver(&notifyReceiver);
+	client.Ping();
+	test1(server, notifyReceiver);
+	test2(client);
+
+	server.Stop();
+	return 0;
+}
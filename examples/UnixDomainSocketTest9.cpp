@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include "UnixDomainSocket.h"
+
+using namespace LightIPC;
+
+void test0(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest0 body passed by descriptor, copied into a ByteBuffer\n");
+
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(std::string(1024*1024, 'x'));
+	Result res = sender.Send(header, body);
+	::printf("send:%s\n", (res ? "ok" : res.ErrorMessage().c_str()));
+
+	ByteBuffer outHeader;
+	ByteBuffer outBody;
+	res = receiver.Receive(outHeader, outBody);
+	::printf("receive:%s size:%zu same:%s\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, outBody.Size(), (outBody.Data() == body.Data() ? "true" : "false"));
+}
+
+void test1(UnixDomainSocket &sender, UnixDomainSocket &receiver)
+{
+	::printf("\ntest1 body passed by descriptor, read in place from the mapping\n");
+
+	ByteBuffer header;
+	ByteBuffer body;
+	body.Append(std::string(1024*1024, 'y'));
+	UnixDomainSocket::Frame frame = {1, 0, 101};
+	sender.Send(frame, header, body);
+
+	UnixDomainSocket::Frame outFrame;
+	ByteBuffer outHeader;
+	UnixDomainSocket::MappedBody outBody;
+	Result res = receiver.Receive(outFrame, outHeader, outBody);
+	::printf("receive:%s size:%zu mapped:%s same:%s\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, outBody.Size(), (outBody.IsMapped() ? "true" : "false")
+		, (outBody.Size() == body.Size() && ::memcmp(outBody.Data(), body.Data().data(), body.Size()) == 0 ? "true" : "false"));
+
+	// small body (under the threshold): copied into the MappedBody
+	ByteBuffer small;
+	small.Append(12345);
+	sender.Send(frame, header, small);
+	res = receiver.Receive(outFrame, outHeader, outBody);
+	::printf("receive:%s size:%zu mapped:%s\n", (res ? "ok" : res.ErrorMessage().c_str())
+		, outBody.Size(), (outBody.IsMapped() ? "true" : "false"));
+	outBody.Release();
+}
+
+int main(int argc, char *argv[]) {
+	UnixDomainSocket owner("/tmp/LightIPC_uds9", true);
+	UnixDomainSocket partner("/tmp/LightIPC_uds9", false);
+	Result res = owner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	res = partner.OpenSocket();
+	if (!res) {
+		::printf("err:%s\n", res.ErrorMessage().c_str());
+		return 1;
+	}
+	partner.SetDescriptorThreshold(64*1024);
+
+	test0(partner, owner);
+	test1(partner, owner);
+
+	partner.CloseSocket();
+	owner.CloseSocket();
+	return 0;
+}
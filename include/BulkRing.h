@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////
+/// @file	BulkRing.h
+/// @brief	Shared memory ring of message bodies
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_BULK_RING__
+#define __LIGHT_IPC_BULK_RING__
+
+#include <string>
+#include "ByteBuffer.h"
+#include "Result.h"
+#include "SharedMemory.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @brief	Rings of a bulk channel offered by the client to the server
+/// @note	Body of the request that opens the channel (UnixDomainSocketClient::EnableBulkChannel())
+///////////////////////////////////////////////////////////
+struct BulkChannelOffer
+{
+	/// Ring of the request bodies (written by the client)
+	char requestRing[64];
+
+	/// Ring of the response bodies (written by the server)
+	char responseRing[64];
+
+	/// Capacity of each ring
+	unsigned long long capacity;
+
+	/// Generation of the rings
+	unsigned int generation;
+
+	/// Bodies of this size or larger go through the rings
+	unsigned int threshold;
+};
+
+///////////////////////////////////////////////////////////
+/// @class BulkRing
+/// @brief	Ring buffer of message bodies in SharedMemory
+///
+/// - One process writes bodies into the ring, the other reads them.
+///   Only a small descriptor (offset, length, generation) is sent over the socket,
+///   the body itself is not copied through the kernel
+/// - Each body takes a contiguous area, the end of the ring is skipped when it does not fit
+/// - The reader releases the bodies in the order they were written (the order of the socket),
+///   releasing a body also releases the areas skipped before it
+/// - Write() fails when the ring is full, the caller sends the body over the socket instead
+/// - The generation tells the rings of successive channels apart, the descriptors
+///   of an older ring are rejected
+/// - Not thread safe, one thread writes and one thread reads
+///
+///////////////////////////////////////////////////////////
+class BulkRing {
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	/// @param[in]	name SharedMemory name
+	/// @param[in]	capacity Size of the bodies the ring holds
+	/// @param[in]	generation Generation of the ring
+	/// @param[in]	isOwner true: create the ring, false: open the ring created by the other process
+	/// @note		name Must start with'/' eg) "/bulk_ring1"
+	/// @note		Check IsOpend() after construction
+	///////////////////////////////////////////////////////////
+	BulkRing(const std::string &name, size_t capacity, unsigned int generation, bool isOwner);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~BulkRing();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the ring can be used
+	/// @return		true When the shared memory is mapped and its header is valid
+	///////////////////////////////////////////////////////////
+	bool IsOpend();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get name
+	/// @return		SharedMemory name
+	///////////////////////////////////////////////////////////
+	const std::string &Name() const;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the size of the bodies the ring holds
+	/// @return		Capacity
+	///////////////////////////////////////////////////////////
+	size_t Capacity() const;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the generation
+	/// @return		Generation
+	///////////////////////////////////////////////////////////
+	unsigned int Generation() const;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Write a body into the ring
+	/// @param[in]	body Body
+	/// @param[out]	outDescriptor Descriptor to send to the reader
+	/// @return		true When written, false when the ring has no room for it
+	///////////////////////////////////////////////////////////
+	bool Write(const ByteBuffer &body, ByteBuffer &outDescriptor);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Take back the last Write()
+	/// @note		Call when the descriptor could not be sent, before the next Write()
+	///////////////////////////////////////////////////////////
+	void Discard();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy a body out of the ring and release it
+	/// @param[in]	descriptor Descriptor received from the writer
+	/// @param[out]	outBody Body (may be the same buffer as descriptor)
+	/// @return		Result When the descriptor is invalid, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Read(const ByteBuffer &descriptor, ByteBuffer &outBody);
+
+private:
+	/// Header of the ring in the shared memory
+	struct Header;
+
+	/// Shared memory of the header and the bodies
+	SharedMemory *m_memory;
+
+	/// Header at the top of the shared memory
+	Header *m_header;
+
+	/// Bodies
+	char *m_data;
+
+	/// Size of m_data
+	size_t m_capacity;
+
+	/// Generation
+	unsigned int m_generation;
+
+	/// Writer: position of the next body (bytes written since the creation)
+	unsigned long long m_head;
+
+	/// Writer: m_head before the last Write()
+	unsigned long long m_lastHead;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	BulkRing(const BulkRing &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	BulkRing& operator=(const BulkRing &src);
+};
+}
+
+#endif
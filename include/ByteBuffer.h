@@ -79,6 +79,24 @@ public:
 	///////////////////////////////////////////////////////////
 	void Clear();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Replace the contents of the buffer
+	/// @param[in]	_data Data
+	/// @param[in]	_size Data size
+	/// @return		None
+	/// @note		The allocated memory is reused, it grows only when _size exceeds it
+	///////////////////////////////////////////////////////////
+	void Assign(const char *_data, size_t _size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Change the size of the buffer to fill it in place
+	/// @param[in]	_size New size
+	/// @return		Beginning of the buffer (_size bytes can be written)
+	/// @note		The allocated memory is reused, it grows only when _size exceeds it
+	/// @note		The pointer is valid until the buffer is changed
+	///////////////////////////////////////////////////////////
+	char *Resize(size_t _size);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Get buffer contents as a string
 	/// @return		Byte data
@@ -95,6 +113,14 @@ public:
 	///////////////////////////////////////////////////////////
 	ByteBuffer &Append(ByteBuffer &_data);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		ByteBuffer Add (const)
+	/// @param[in]	_data Data to write
+	/// @return		ByteBuffer
+	/// @note		Without it a const ByteBuffer matches Append(T) and its object bytes are written
+	///////////////////////////////////////////////////////////
+	ByteBuffer &Append(const ByteBuffer &_data);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Add a string (std::string)
 	/// @param[in]	_data Data to write
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////
+/// @file	Crc32c.h
+/// @brief	CRC32C (Castagnoli) checksum
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_CRC32C__
+#define __LIGHT_IPC_CRC32C__
+
+#include <cstddef>
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @class Crc32c
+/// @brief	CRC32C checksum (iSCSI polynomial 0x1EDC6F41)
+///
+///  - Computed with the SSE4.2 crc32 instruction when the CPU has it,
+///    8 bytes per instruction
+///  - Otherwise computed with tables (slicing-by-8)
+///  - Both give the same value, the choice is made once at run time
+///
+///////////////////////////////////////////////////////////
+class Crc32c {
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Compute the checksum of data
+	/// @param[in]	data Data
+	/// @param[in]	size Size of data
+	/// @return		Checksum
+	///////////////////////////////////////////////////////////
+	static unsigned int Compute(const void *data, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Continue a checksum with the following data
+	/// @param[in]	crc Checksum of the preceding data (0: no preceding data)
+	/// @param[in]	data Data
+	/// @param[in]	size Size of data
+	/// @return		Checksum of the preceding data and data
+	///////////////////////////////////////////////////////////
+	static unsigned int Extend(unsigned int crc, const void *data, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the SSE4.2 instruction is used
+	/// @return		true When the checksum is computed by the CPU instruction
+	///////////////////////////////////////////////////////////
+	static bool IsAccelerated();
+
+private:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	/// @note		Only static methods
+	///////////////////////////////////////////////////////////
+	Crc32c();
+};
+}
+
+#endif
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////
+/// @file	IoUring.h
+/// @brief	io_uring datagram reception and transmission
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_IO_URING__
+#define __LIGHT_IPC_IO_URING__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "Result.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @class IoUring
+/// @brief	Receives the datagrams of one socket, or sends datagrams, through io_uring
+///
+///  - One multishot recvmsg stays armed on the socket, the kernel writes each
+///    datagram into a buffer of a registered buffer ring (provided buffers)
+///    and posts a completion. No system call is needed while completions are waiting
+///  - Receive() returns the datagrams like recvmmsg, pointing into the buffers.
+///    The buffers are given back to the kernel by Release()
+///  - A datagram larger than a buffer is returned truncated (MSG_TRUNC, msg_len is its
+///    size). The multishot recvmsg is then canceled and armed again on a buffer ring
+///    rebuilt for that size, the buffers held meanwhile stay valid until released
+///  - A ring opened by OpenSend() sends instead: Send() submits the datagrams as
+///    linked sendmsg entries with one io_uring_enter, like sendmmsg
+///  - Used by UnixDomainSocket with IO_ENGINE_URING, the io_uring system calls are
+///    called directly (no liburing)
+///  - Not thread safe, one thread receives
+///
+///////////////////////////////////////////////////////////
+class IoUring {
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if io_uring and multishot reception can be used
+	/// @return		true When the kernel supports them
+	///////////////////////////////////////////////////////////
+	static bool IsSupported();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	///////////////////////////////////////////////////////////
+	IoUring();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~IoUring();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set up the ring and the buffers for a socket
+	/// @param[in]	socketFd Socket to receive from
+	/// @param[in]	datagramSize Maximum size of one datagram
+	/// @param[in]	controlSize Space of the control messages of one datagram
+	/// @param[in]	bufferCount Number of buffers (power of 2, at most 32768)
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The reception is armed by the first Receive(), the completions
+	/// 			are processed by the thread that receives
+	///////////////////////////////////////////////////////////
+	Result Open(int socketFd, size_t datagramSize, size_t controlSize, unsigned int bufferCount);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set up the ring for sending
+	/// @param[in]	entries Maximum number of datagrams of one Send()
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result OpenSend(unsigned int entries);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Release the ring and the buffers
+	///////////////////////////////////////////////////////////
+	void Close();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the ring is set up
+	/// @return		true After Open() succeeded
+	///////////////////////////////////////////////////////////
+	bool IsOpend();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Take the received datagrams
+	/// @param[out]	msgs Datagrams (msg_len, msg_flags, msg_iov and msg_control are set)
+	/// @param[out]	iov One iovec per datagram, set to the data in the buffer
+	/// 			(shorter than msg_len when MSG_TRUNC is set)
+	/// @param[out]	outBufferIds Buffer of each datagram, pass them to Release()
+	/// @param[in]	maxCount Maximum number of datagrams
+	/// @param[in]	isBlock Wait for the first datagram (poll on the ring, a cancellation point)
+	/// @return		Number of datagrams (0 when none and isBlock is false), -1 on error (errno)
+	/// @note		msg_len 0 without a buffer is the end of a connection
+	/// 			(outBufferIds is -1 for it)
+	///////////////////////////////////////////////////////////
+	int Receive(mmsghdr *msgs, iovec *iov, int *outBufferIds, size_t maxCount, bool isBlock);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Give the buffers of received datagrams back to the kernel
+	/// @param[in]	bufferIds Buffers returned by Receive() (-1 is ignored)
+	/// @param[in]	count Number of buffers
+	///////////////////////////////////////////////////////////
+	void Release(const int *bufferIds, size_t count);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send datagrams in order
+	/// @param[in]	socketFd Socket to send from
+	/// @param[in,out]	msgs Datagrams (msg_len is set to the bytes sent)
+	/// @param[in]	count Number of datagrams (at most the entries of OpenSend() are sent)
+	/// @return		Number of datagrams sent, -1 when the first one failed (errno)
+	/// @note		Waits for the completions, not for room in the socket: a datagram that
+	/// 			finds it full fails with EAGAIN. The ones after a failed datagram are not sent
+	///////////////////////////////////////////////////////////
+	int Send(int socketFd, mmsghdr *msgs, size_t count);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the largest datagram the buffers receive without truncation
+	/// @note		Grows after a truncated datagram once the buffer ring is rebuilt
+	///////////////////////////////////////////////////////////
+	size_t DatagramSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of system calls made by the reception or the transmission
+	/// @note		io_uring_enter and waiting (poll), not the datagrams taken without them
+	///////////////////////////////////////////////////////////
+	unsigned long SyscallCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set a file descriptor that interrupts the wait of Receive()
+	/// @param[in]	wakeupFd File descriptor (eventfd), -1: none
+	/// @note		While it is readable, a blocking Receive() without datagrams returns -1 (ECANCELED)
+	///////////////////////////////////////////////////////////
+	void SetWakeupFd(int wakeupFd);
+
+private:
+	/// Ring file descriptor
+	int m_ringFd;
+
+	/// Socket to receive from
+	int m_socketFd;
+
+	/// Submission and completion rings (one mapping)
+	void *m_ring;
+
+	/// Size of m_ring
+	size_t m_ringSize;
+
+	/// Submission queue entries
+	void *m_sqes;
+
+	/// Size of m_sqes
+	size_t m_sqesSize;
+
+	/// Number of submission queue entries
+	unsigned int m_sqEntries;
+
+	/// Submission queue head, tail, mask and index array
+	unsigned int *m_sqHead;
+	unsigned int *m_sqTail;
+	unsigned int m_sqMask;
+	unsigned int *m_sqArray;
+
+	/// Completion queue head, tail, mask and entries
+	unsigned int *m_cqHead;
+	unsigned int *m_cqTail;
+	unsigned int m_cqMask;
+	void *m_cqes;
+
+	/// Registered buffer ring
+	void *m_bufferRing;
+
+	/// Size of m_bufferRing
+	size_t m_bufferRingSize;
+
+	/// Number of buffers
+	unsigned int m_bufferCount;
+
+	/// Buffer tail (entries given to the kernel)
+	unsigned short m_bufferTail;
+
+	/// Buffers returned by Receive() and not released yet
+	unsigned int m_heldCount;
+
+	/// Buffer group of the registered buffer ring
+	unsigned short m_bufferGroup;
+
+	/// ID of the first buffer (0 or m_bufferCount, switched by each rebuild)
+	unsigned int m_bufferBase;
+
+	/// Buffers of the ring before the rebuild, held by the caller
+	char *m_retiredBuffers;
+
+	/// Size of one buffer of m_retiredBuffers
+	size_t m_retiredSize;
+
+	/// Buffers of m_retiredBuffers not released yet
+	unsigned int m_retiredCount;
+
+	/// Buffers
+	char *m_buffers;
+
+	/// Size of one buffer
+	size_t m_bufferSize;
+
+	/// Largest datagram of one buffer
+	size_t m_datagramSize;
+
+	/// Datagram size of the next buffer ring (larger than m_datagramSize: rebuild it)
+	size_t m_requestedSize;
+
+	/// Space of the control messages requested per datagram
+	size_t m_controlSize;
+
+	/// Template of the multishot recvmsg (name and control lengths)
+	msghdr m_msg;
+
+	/// The multishot recvmsg is armed
+	bool m_isArmed;
+
+	/// The multishot recvmsg is being canceled
+	bool m_isCanceling;
+
+	/// Error of the reception waiting to be returned (errno, 0: none)
+	int m_error;
+
+	/// System calls made by the reception
+	unsigned long m_syscallCount;
+
+	/// Interrupts the wait of Receive() (-1: none)
+	int m_wakeupFd;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Create the ring and map its queues
+	/// @param[in]	entries Number of submission queue entries
+	/// @param[in]	completionEntries Number of completion queue entries
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result setupRing(unsigned int entries, unsigned int completionEntries);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set up the buffer ring, or rebuild it while the reception is not armed
+	/// @param[in]	datagramSize Largest datagram of one buffer
+	/// @return		true When set up, false on error (errno, the previous buffers are kept)
+	///////////////////////////////////////////////////////////
+	bool setBuffers(size_t datagramSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Submit the multishot recvmsg
+	/// @return		true When submitted
+	///////////////////////////////////////////////////////////
+	bool arm();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if no datagram is left in the completion ring
+	/// @return		true When none (the other completions in front are dropped)
+	///////////////////////////////////////////////////////////
+	bool isReceiveDrained();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Submit the cancellation of the multishot recvmsg
+	/// @note		Its last completion ends it (m_isArmed is cleared then)
+	///////////////////////////////////////////////////////////
+	void cancel();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Give a buffer to the kernel
+	/// @param[in]	bufferId Buffer
+	///////////////////////////////////////////////////////////
+	void provide(unsigned short bufferId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	IoUring(const IoUring &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	IoUring& operator=(const IoUring &src);
+};
+}
+
+#endif
@@ -192,9 +192,22 @@ public:
 	/// @return		Result When it fails, the error content is set to Error
 	/// @note		When the message queue is empty, block until a newly added message is available
 	/// @note		A message with a message size of 0 is also possible
+	/// @note		Only the bytes of the message are copied into outMessage, its memory is reused
+	/// 			(no allocation once it has held a message of MaxMessageSize())
 	///////////////////////////////////////////////////////////
 	Result Receive(ByteBuffer &outMessage);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive a message from the message queue into a buffer
+	/// @param[out]	buffer Buffer
+	/// @param[in]	bufferSize Size of buffer >= MaxMessageSize()
+	/// @param[out]	outSize message size
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is empty, block until a newly added message is available
+	/// @note		The kernel copies the message straight into buffer (no other copy)
+	///////////////////////////////////////////////////////////
+	Result Receive(char *buffer, size_t bufferSize, size_t &outSize);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Receive message from message queue with timeout
 	/// @param[out]	message message
@@ -203,9 +216,21 @@ public:
 	/// @note		When the message queue is empty, an error will occur if the message cannot be obtained after waiting for the specified time.
 	/// @note		millisec If is 0, block until it can be obtained
 	/// @note		A message with a message size of 0 is also possible
+	/// @note		Only the bytes of the message are copied into outMessage (emptied on error), its memory is reused
 	///////////////////////////////////////////////////////////
 	Result TimedReceive(ByteBuffer &outMessage, unsigned long millisec);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive message from message queue into a buffer with timeout
+	/// @param[out]	buffer Buffer
+	/// @param[in]	bufferSize Size of buffer >= MaxMessageSize()
+	/// @param[out]	outSize message size
+	/// @param[in]	millisec millisecond
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		millisec If is 0, block until it can be obtained
+	///////////////////////////////////////////////////////////
+	Result TimedReceive(char *buffer, size_t bufferSize, size_t &outSize, unsigned long millisec);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Receive all messages stored in the message queue
 	/// @param[out]	outMessages Message list
@@ -215,12 +240,40 @@ public:
 	///////////////////////////////////////////////////////////
 	Result Receive(std::vector<ByteBuffer> &outMessages);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Send messages to the message queue in order
+	/// @param[in]	messages Messages
+	/// @param[in]	millisec millisecond (for the whole batch)
+	/// @param[out]	outCount Number of messages sent
+	/// @return		Result When a message can not be sent, the error content is set to Error
+	/// 			(the messages before it have been sent)
+	/// @note		millisec If is 0, block until all the messages are sent
+	///////////////////////////////////////////////////////////
+	Result SendBatch(const std::vector<ByteBuffer> &messages, unsigned long millisec, size_t &outCount);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive up to maxCount messages from the message queue
+	/// @param[in,out]	ioMessages Messages (the buffers are reused, see the note)
+	/// @param[in]	maxCount Maximum number of messages to receive
+	/// @param[in]	millisec millisecond to wait for the first message
+	/// @param[out]	outCount Number of messages received (ioMessages[0] to ioMessages[outCount - 1])
+	/// @return		Result When no message arrives within millisec or it fails, the error content is set to Error
+	/// @note		Waits only for the first message, then takes the messages already in the queue
+	/// @note		millisec If is 0, block until the first message arrives
+	/// @note		ioMessages is grown to maxCount when smaller and never shrunk,
+	/// 			the messages are copied into its ByteBuffers so that their memory
+	/// 			is reused from one batch to the next (keep the vector between calls)
+	///////////////////////////////////////////////////////////
+	Result ReceiveBatch(std::vector<ByteBuffer> &ioMessages, size_t maxCount, unsigned long millisec, size_t &outCount);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		INotifyMessage Set the interface
 	/// @param[in]	notification Handler to be notified
 	/// @note		Since the message queue is an empty queue (size 0)
 	///             Note that we only notify you when new messages arrive
 	/// @note		NULL Does not notify when set to
+	/// @note		A new thread is created for each notification,
+	/// 			MessageQueueReactor notifies on one thread instead
 	///////////////////////////////////////////////////////////
 	void SetNotifyMessage(INotifyMessage *notification);
 
@@ -232,6 +285,14 @@ public:
 	///////////////////////////////////////////////////////////
 	INotifyMessage *NotifyMessage();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the descriptor of the message queue
+	/// @return		Descriptor (-1: not opened)
+	/// @note		Readable (poll/epoll) while messages are in the message queue,
+	/// 			MessageQueueReactor watches many message queues with it
+	///////////////////////////////////////////////////////////
+	int Descriptor();
+
 private:
 	/// Name
 	std::string m_name;
@@ -270,6 +331,14 @@ private:
 	///////////////////////////////////////////////////////////
 	void Init(long maxMessageCount, long maxMessageSize);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive a message into a ByteBuffer
+	/// @param[out]	outMessage message (emptied on error)
+	/// @param[in]	timeout Absolute CLOCK_REALTIME time, NULL: block
+	/// @return		Message size, -1: error (errno)
+	///////////////////////////////////////////////////////////
+	ssize_t receiveMessage(ByteBuffer &outMessage, const struct timespec *timeout);
+
 };
 }
 
@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////
+/// @file	MessageQueueReactor.h
+/// @brief	Message arrival notification of many message queues on one thread
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_MESSAGE_QUEUE_REACTOR__
+#define __LIGHT_IPC_MESSAGE_QUEUE_REACTOR__
+
+#include <map>
+#include "MessageQueue.h"
+#include "Mutex.h"
+#include "Result.h"
+#include "Thread.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @class MessageQueueReactor
+/// @brief	Watches message queues with epoll and calls their INotifyMessage on one dispatcher thread
+///
+/// - Replaces MessageQueue::SetNotifyMessage() (mq_notify with SIGEV_THREAD creates
+///   a thread for each notification and has to be registered again every time)
+/// - INotifyMessage::FirstMessageArrived() is called while messages are in the queue
+///   (level triggered): receive them in the handler, it is called again for the messages left
+/// - The handlers of all the queues are called one at a time on the dispatcher thread,
+///   finish them promptly
+/// - Add() and Remove() can be called at any time, also from a handler
+///
+///   ex) MessageQueueReactor reactor;
+///       reactor.Add(&mq1, &handler1);
+///       reactor.Add(&mq2, &handler2);
+///       reactor.Start();
+///
+///////////////////////////////////////////////////////////
+class MessageQueueReactor : public IRunnable
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	///////////////////////////////////////////////////////////
+	MessageQueueReactor();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	/// @note		Stops the dispatcher thread
+	///////////////////////////////////////////////////////////
+	virtual ~MessageQueueReactor();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Watch a message queue
+	/// @param[in]	mq Message queue (must live until Remove() or the destructor)
+	/// @param[in]	notification Handler called when messages are in mq
+	/// @return		Result When the message queue is not opened or already watched, the error content is set to Error
+	/// @note		Do not use MessageQueue::SetNotifyMessage() for mq at the same time
+	///////////////////////////////////////////////////////////
+	Result Add(MessageQueue *mq, INotifyMessage *notification);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Stop watching a message queue
+	/// @param[in]	mq Message queue
+	/// @return		Result When the message queue is not watched, the error content is set to Error
+	/// @note		The handler of mq is not called after this method returns
+	/// 			(it waits for the handler in progress unless called from a handler)
+	///////////////////////////////////////////////////////////
+	Result Remove(MessageQueue *mq);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Start the dispatcher thread
+	///////////////////////////////////////////////////////////
+	void Start();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Stop the dispatcher thread
+	/// @note		It is woken up through an eventfd, the handler in progress is finished first
+	/// @note		Do not call from a handler
+	///////////////////////////////////////////////////////////
+	void Stop();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		implements IRunnable::Run()
+	/// @note		Do not call this method
+	///////////////////////////////////////////////////////////
+	void Run();
+
+private:
+	///////////////////////////////////////////////////////////
+	/// @brief	Watched message queue
+	///////////////////////////////////////////////////////////
+	struct Entry
+	{
+		/// Message queue
+		MessageQueue *mq;
+
+		/// Handler
+		INotifyMessage *notification;
+	};
+
+	/// Largest number of events taken by one epoll_wait()
+	static const int MAX_EPOLL_EVENTS = 32;
+
+	/// epoll of the message queues and m_wakeupFd
+	int m_epollFd;
+
+	/// eventfd signaled by Stop()
+	int m_wakeupFd;
+
+	/// Watched message queues: descriptor -> entry (under m_mutex)
+	std::map<int, Entry> m_queues;
+
+	/// Descriptor of the queue whose handler is in progress, -1: none (under m_mutex)
+	int m_dispatchingFd;
+
+	/// Mutex of m_queues and m_dispatchingFd
+	Mutex m_mutex;
+
+	/// Dispatcher thread
+	Thread m_thread;
+
+	/// Thread ID of the dispatcher thread
+	unsigned long m_threadId;
+
+	/// Start() has been called (until Stop())
+	bool m_isStarted;
+
+	/// The dispatcher thread keeps running
+	bool m_isActive;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	MessageQueueReactor(const MessageQueueReactor &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	MessageQueueReactor& operator=(const MessageQueueReactor &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Call the handler of a queue
+	/// @param[in]	fd Descriptor of the queue
+	///////////////////////////////////////////////////////////
+	void dispatch(int fd);
+};
+}
+
+#endif
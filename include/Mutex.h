@@ -8,6 +8,7 @@
 #define __LIGHT_IPC_MUTEX__
 
 #include <pthread.h>
+#include <time.h>
 
 namespace LightIPC {
 ///////////////////////////////////////////////////////////
@@ -58,6 +59,15 @@ public:
 	///////////////////////////////////////////////////////////
 	void ConditionWait();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Wait for the calling thread using the condition variables held by this class until the deadline
+	/// @param[in]	deadline Absolute time to give up waiting (CLOCK_MONOTONIC)
+	/// @return		false When the deadline has passed
+	/// @note		It is necessary to acquire (Lock()) the lock of this class.
+	///				When getting up (when exiting Wait()), Mutex lock will be acquired.
+	///////////////////////////////////////////////////////////
+	bool ConditionTimedWait(const timespec &deadline);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Wake up (send a signal) a thread waiting on the condition variable held by this class
 	/// @param[in]	None
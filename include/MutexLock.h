@@ -48,6 +48,15 @@ public:
 	///////////////////////////////////////////////////////////
 	void Wait();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Calling thread waits for lock until the deadline
+	/// @param[in]	deadline Absolute time to give up waiting (CLOCK_MONOTONIC)
+	/// @return		false When the deadline has passed
+	/// @note		Mutex is temporarily unlocked while waiting
+	///				When getting up (when exiting TimedWait()), Mutex lock will be acquired.
+	///////////////////////////////////////////////////////////
+	bool TimedWait(const timespec &deadline);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Wake up one of the waiting threads
 	/// @param[in]	None
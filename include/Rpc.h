@@ -0,0 +1,435 @@
+///////////////////////////////////////////////////////////
+/// @file	Rpc.h
+/// @brief	Method ID dispatch over UNIX Domain socket
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_RPC__
+#define __LIGHT_IPC_RPC__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ByteBuffer.h"
+#include "Result.h"
+#include "UnixDomainSocketClient.h"
+#include "UnixDomainSocketServer.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @brief	Status at the top of an RPC response
+///////////////////////////////////////////////////////////
+enum RpcStatus {
+	RPC_STATUS_OK = 0,				///< The result follows
+	RPC_STATUS_UNKNOWN_METHOD,		///< No handler is registered for the method ID
+	RPC_STATUS_INVALID_ARGUMENTS,	///< The arguments could not be unmarshalled
+	RPC_STATUS_FAILED				///< The handler returned an error, its message follows
+};
+
+///////////////////////////////////////////////////////////
+/// @brief	Latency counters of a method
+///////////////////////////////////////////////////////////
+struct RpcMethodStats
+{
+	/// Number of calls
+	unsigned long calls;
+
+	/// Number of calls that did not return RPC_STATUS_OK
+	unsigned long errors;
+
+	/// Total processing time (nanoseconds)
+	unsigned long long totalNsec;
+
+	/// Longest processing time (nanoseconds)
+	unsigned long long maxNsec;
+};
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a std::string with bounds checks (ByteBuffer::Value() does not check)
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the length is negative or the buffer ends before the value
+///////////////////////////////////////////////////////////
+bool RpcValue(ByteBuffer &buffer, std::string &out);
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a ByteBuffer with bounds checks
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the length is negative or the buffer ends before the value
+///////////////////////////////////////////////////////////
+bool RpcValue(ByteBuffer &buffer, ByteBuffer &out);
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a size_t (marshalled as int) with bounds checks
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the buffer ends before the value
+///////////////////////////////////////////////////////////
+bool RpcValue(ByteBuffer &buffer, size_t &out);
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a primitive or POD structure with bounds checks
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the buffer ends before the value
+///////////////////////////////////////////////////////////
+template <class T>
+bool RpcValue(ByteBuffer &buffer, T &out)
+{
+	if (buffer.Size() < buffer.Position() || buffer.Size() - buffer.Position() < sizeof(out)) {
+		return false;
+	}
+	buffer.Value(out);
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a std::vector with bounds checks
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the count is negative or the buffer ends before an element
+///////////////////////////////////////////////////////////
+template <class T>
+bool RpcValue(ByteBuffer &buffer, std::vector<T> &out)
+{
+	int size = 0;
+	if (!RpcValue(buffer, size) || size < 0) {
+		return false;
+	}
+	for (int i = 0; i < size; i++) {
+		T value;
+		if (!RpcValue(buffer, value)) {
+			return false;
+		}
+		out.push_back(value);
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Get a std::map with bounds checks
+/// @param[in]	buffer Arguments or response
+/// @param[out]	out Value
+/// @return		false When the count is negative or the buffer ends before a key or a value
+///////////////////////////////////////////////////////////
+template <class K, class V>
+bool RpcValue(ByteBuffer &buffer, std::map<K,V> &out)
+{
+	int size = 0;
+	if (!RpcValue(buffer, size) || size < 0) {
+		return false;
+	}
+	for (int i = 0; i < size; i++) {
+		K key;
+		V val;
+		if (!RpcValue(buffer, key) || !RpcValue(buffer, val)) {
+			return false;
+		}
+		out.insert(std::make_pair(key, val));
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////
+/// @class	IRpcHandler
+/// @brief	Handler of a method registered to RpcDispatcher
+///
+/// - Implement it to handle the marshalled arguments directly,
+///   RpcFunction and RpcMemberFunction implement it for typed functions
+/// - Called from several worker threads at the same time with
+///   UnixDomainSocketServer::SetWorkerCount() > 0
+///
+///////////////////////////////////////////////////////////
+class IRpcHandler
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~IRpcHandler() {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Implement the method
+	/// @param[in]	args Arguments (read with RpcValue(), it checks the bounds)
+	/// @param[out]	outResult Result (empty at the call, written with ByteBuffer::Append())
+	/// @return		RpcStatus (RPC_STATUS_FAILED: write the error message with outResult.Append(std::string))
+	///////////////////////////////////////////////////////////
+	virtual RpcStatus Call(ByteBuffer &args, ByteBuffer &outResult) = 0;
+};
+
+///////////////////////////////////////////////////////////
+/// @class	RpcFunction
+/// @brief	IRpcHandler of a function Result function(const Arg &arg, Ret &outRet)
+///
+/// - Arg and Ret are types ByteBuffer can marshal (primitive, POD structure,
+///   std::string, std::vector, std::map)
+///
+///////////////////////////////////////////////////////////
+template <class Arg, class Ret>
+class RpcFunction : public IRpcHandler
+{
+public:
+	/// Function implementing the method
+	typedef Result (*Function)(const Arg &arg, Ret &outRet);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	/// @param[in]	function Function implementing the method
+	///////////////////////////////////////////////////////////
+	RpcFunction(Function function) : m_function(function) {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		implements IRpcHandler::Call()
+	///////////////////////////////////////////////////////////
+	RpcStatus Call(ByteBuffer &args, ByteBuffer &outResult)
+	{
+		Arg arg;
+		if (!RpcValue(args, arg)) {
+			return RPC_STATUS_INVALID_ARGUMENTS;
+		}
+		Ret ret;
+		Result result = m_function(arg, ret);
+		if (result.IsError()) {
+			outResult.Append(result.ErrorMessage());
+			return RPC_STATUS_FAILED;
+		}
+		outResult.Append(ret);
+		return RPC_STATUS_OK;
+	};
+
+private:
+	/// Function implementing the method
+	Function m_function;
+};
+
+///////////////////////////////////////////////////////////
+/// @class	RpcMemberFunction
+/// @brief	IRpcHandler of a member function Result T::function(const Arg &arg, Ret &outRet)
+///////////////////////////////////////////////////////////
+template <class T, class Arg, class Ret>
+class RpcMemberFunction : public IRpcHandler
+{
+public:
+	/// Member function implementing the method
+	typedef Result (T::*Function)(const Arg &arg, Ret &outRet);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	/// @param[in]	object Object the member function is called on
+	/// @param[in]	function Member function implementing the method
+	///////////////////////////////////////////////////////////
+	RpcMemberFunction(T *object, Function function) : m_object(object), m_function(function) {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		implements IRpcHandler::Call()
+	///////////////////////////////////////////////////////////
+	RpcStatus Call(ByteBuffer &args, ByteBuffer &outResult)
+	{
+		Arg arg;
+		if (!RpcValue(args, arg)) {
+			return RPC_STATUS_INVALID_ARGUMENTS;
+		}
+		Ret ret;
+		Result result = (m_object->*m_function)(arg, ret);
+		if (result.IsError()) {
+			outResult.Append(result.ErrorMessage());
+			return RPC_STATUS_FAILED;
+		}
+		outResult.Append(ret);
+		return RPC_STATUS_OK;
+	};
+
+private:
+	/// Object the member function is called on
+	T *m_object;
+
+	/// Member function implementing the method
+	Function m_function;
+};
+
+///////////////////////////////////////////////////////////
+/// @class	RpcDispatcher
+/// @brief	Dispatches the requests of UnixDomainSocketServer to the handlers by method ID
+///
+/// - Set it with UnixDomainSocketServer::SetReceiver()
+/// - The handlers are kept in a table indexed by the method ID (up to MAX_METHOD_ID)
+/// - The processing time of each method is counted (Stats())
+///
+///  [ Request ]
+///   +-------------------+-----------------------+
+///   | method ID (4 byte)| arguments (ByteBuffer)|
+///   +-------------------+-----------------------+
+///  [ Response ]
+///   +-------------------+---------------------------------------------+
+///   | RpcStatus (4 byte)| result (RPC_STATUS_OK) / message (FAILED)    |
+///   +-------------------+---------------------------------------------+
+///
+///////////////////////////////////////////////////////////
+class RpcDispatcher : public IRequestReceiver
+{
+public:
+	/// Largest method ID
+	static const unsigned int MAX_METHOD_ID = 4095;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	///////////////////////////////////////////////////////////
+	RpcDispatcher();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	/// @note		The handlers are not deleted
+	///////////////////////////////////////////////////////////
+	virtual ~RpcDispatcher();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Register the handler of a method
+	/// @param[in]	methodId Method ID (0 to MAX_METHOD_ID)
+	/// @param[in]	handler IRpcHandler (must live as long as the dispatcher)
+	/// @return		Result When the ID is out of range or already registered, the error content is set to Error
+	/// @note		Register before UnixDomainSocketServer::Start()
+	///////////////////////////////////////////////////////////
+	Result Register(unsigned int methodId, IRpcHandler *handler);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the latency counters of a method
+	/// @param[in]	methodId Method ID
+	/// @param[out]	outStats Counters
+	/// @return		Result When the method is not registered, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Stats(unsigned int methodId, RpcMethodStats &outStats);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Reset the latency counters of all methods
+	///////////////////////////////////////////////////////////
+	void ResetStats();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		implements IRequestReceiver::Received()
+	/// @note		Do not call this method
+	///////////////////////////////////////////////////////////
+	void Received(ByteBuffer &request, ByteBuffer &response);
+
+private:
+	///////////////////////////////////////////////////////////
+	/// @brief	Entry of the dispatch table
+	///////////////////////////////////////////////////////////
+	struct Method
+	{
+		/// Handler (NULL: not registered)
+		IRpcHandler *handler;
+
+		/// Latency counters (updated atomically)
+		RpcMethodStats stats;
+	};
+
+	/// Dispatch table indexed by the method ID
+	std::vector<Method> m_methods;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	RpcDispatcher(const RpcDispatcher &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	RpcDispatcher& operator=(const RpcDispatcher &src);
+};
+
+///////////////////////////////////////////////////////////
+/// @brief		Check the status of an RPC response and position it on the result
+/// @param[in]	methodId Method ID (for the error message)
+/// @param[in]	response Response received from RpcDispatcher
+/// @return		Result When the status is not RPC_STATUS_OK, the error content is set to Error
+///////////////////////////////////////////////////////////
+Result RpcResponseStatus(unsigned int methodId, ByteBuffer &response);
+
+///////////////////////////////////////////////////////////
+/// @class	RpcStub
+/// @brief	Client side of a method: marshals Arg, calls the server and unmarshals Ret
+///
+/// - Thread safe as UnixDomainSocketClient::SendReceive()
+///   ex) RpcStub<int, std::string> getName(&client, 10);
+///       std::string name;
+///       Result result = getName.Call(5, name);
+///
+///////////////////////////////////////////////////////////
+template <class Arg, class Ret>
+class RpcStub
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	/// @param[in]	client Client connected to the server of RpcDispatcher
+	/// @param[in]	methodId Method ID
+	///////////////////////////////////////////////////////////
+	RpcStub(UnixDomainSocketClient *client, unsigned int methodId) : m_client(client), m_methodId(methodId) {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Call the method
+	/// @param[in]	arg Arguments
+	/// @param[out]	outRet Result of the method
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Call(const Arg &arg, Ret &outRet)
+	{
+		ByteBuffer request;
+		ByteBuffer response;
+		request.Append(m_methodId);
+		request.Append(arg);
+		Result result = m_client->SendReceive(request, response);
+		if (result.IsError()) {
+			return result;
+		}
+		return unmarshal(response, outRet);
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Call the method within the timeout
+	/// @param[in]	arg Arguments
+	/// @param[out]	outRet Result of the method
+	/// @param[in]	msec Timeout (milliseconds)
+	/// @return		Result When it fails or times out, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result TimedCall(const Arg &arg, Ret &outRet, unsigned int msec)
+	{
+		ByteBuffer request;
+		ByteBuffer response;
+		request.Append(m_methodId);
+		request.Append(arg);
+		Result result = m_client->TimedSendReceive(request, response, msec);
+		if (result.IsError()) {
+			return result;
+		}
+		return unmarshal(response, outRet);
+	};
+
+private:
+	/// Client
+	UnixDomainSocketClient *m_client;
+
+	/// Method ID
+	unsigned int m_methodId;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Take the result out of the response
+	///////////////////////////////////////////////////////////
+	Result unmarshal(ByteBuffer &response, Ret &outRet)
+	{
+		Result result = RpcResponseStatus(m_methodId, response);
+		if (result.IsError()) {
+			return result;
+		}
+		if (!RpcValue(response, outRet)) {
+			return Result::CreateError("rpc error [method %u: %s]", m_methodId, "invalid result");
+		}
+		return result;
+	};
+};
+}
+
+#endif
@@ -57,7 +57,7 @@ public:
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Get shared memory area with specified type
-	/// @return		Template T pointer
+	/// @return		Template T pointer (NULL when the shared memory could not be created or opened)
 	/// @note		The size specified in the constructor >= sizeof (template T)
 	///////////////////////////////////////////////////////////
 	template<typename T> T *Data()
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////
+/// @file	ShmMessageQueue.h
+/// @brief	Shared memory message queue
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_SHM_MESSAGE_QUEUE__
+#define __LIGHT_IPC_SHM_MESSAGE_QUEUE__
+
+#include <string>
+#include <vector>
+#include "Result.h"
+#include "ByteBuffer.h"
+#include "SharedMemory.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @class ShmMessageQueue
+/// @brief	Message queue in SharedMemory (same API as MessageQueue)
+///
+/// - Ring of fixed size slots (maxMessageCount x maxMessageSize) in SharedMemory,
+///   a message is copied once into the ring and once out of it, no system call
+///   is made while the queue is neither empty nor full
+/// - Single producer / single consumer: one thread (of any process) sends
+///   and one thread receives, the head and the tail are updated lock free
+/// - The consumer sleeps on a futex only when the queue is empty,
+///   the producer only when the queue is full, the other side wakes it up
+///   only when it is sleeping
+/// - Not limited by fs.mqueue.msgsize_max / msg_max
+/// - No priority and no INotifyMessage
+///
+///  [ SharedMemory ]
+///   +------------------------------+--------------------------------+-----
+///   | header (geometry, tail, head)| slot 0: length (4 byte) + data | ...
+///   +------------------------------+--------------------------------+-----
+///
+///////////////////////////////////////////////////////////
+class ShmMessageQueue {
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if a message queue with the specified name exists
+	/// @return		Result
+	/// @note		name Must start with'/' eg) "/shmq1"
+	///////////////////////////////////////////////////////////
+	static Result Exist(const std::string &name);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Constructor
+	///
+	/// Use the created message queue as a reference
+	///
+	/// @param[in]	name name
+	/// @note		name Must start with'/' eg) "/shmq1"
+	/// @note		Exist() determines if the message queue exists
+	///////////////////////////////////////////////////////////
+	ShmMessageQueue(const std::string &name);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Constructor
+	///
+	/// Creating and using a new message queue
+	///
+	/// @param[in]	name name
+	/// @param[in]	maxMessageCount Maximum number of messages that can be registered in the message queue> 0
+	/// @param[in]	maxMessageSize Maximum message length> 0
+	/// @note		name Must start with'/' eg) "/shmq1"
+	/// @note		Create/delete message queue
+	///////////////////////////////////////////////////////////
+	ShmMessageQueue(const std::string &name, long maxMessageCount, long maxMessageSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~ShmMessageQueue();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get name
+	/// @return		name
+	///////////////////////////////////////////////////////////
+	const std::string &Name() const;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the maximum number of messages that can be registered in the message queue
+	/// @return		Maximum number of messages (-1: not opened)
+	///////////////////////////////////////////////////////////
+	long MaxMessageCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get maximum size of message that can be registered in message queue
+	/// @return		Message length (-1: not opened)
+	///////////////////////////////////////////////////////////
+	long MaxMessageSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of messages currently in the message queue
+	/// @return		Number of messages currently in the message queue (-1: not opened)
+	///////////////////////////////////////////////////////////
+	long CurrentMessageCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Clear messages in the message queue
+	/// @note		Call from the consumer
+	///////////////////////////////////////////////////////////
+	void Clear();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a message to the message queue
+	/// @param[in]	message message
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is full, block until there is space
+	/// @note		A message with a message size of 0 is also possible
+	///////////////////////////////////////////////////////////
+	Result Send(const ByteBuffer &message);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send message to Message Queue with timeout
+	/// @param[in]	message message
+	/// @param[in]	millisec millisecond
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		millisec If is 0, block until sending is possible
+	/// @note		If there is no space in the message queue after waiting for the specified time, an error occurs
+	/// @note		A message with a message size of 0 is also possible
+	///////////////////////////////////////////////////////////
+	Result TimedSend(const ByteBuffer &message, unsigned long millisec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive a message from the message queue
+	/// @param[out]	outMessage message
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is empty, block until a newly added message is available
+	///////////////////////////////////////////////////////////
+	Result Receive(ByteBuffer &outMessage);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive message from message queue with timeout
+	/// @param[out]	outMessage message
+	/// @param[in]	millisec millisecond
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is empty, an error will occur if the message cannot be obtained after waiting for the specified time.
+	/// @note		millisec If is 0, block until it can be obtained
+	///////////////////////////////////////////////////////////
+	Result TimedReceive(ByteBuffer &outMessage, unsigned long millisec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive all messages stored in the message queue
+	/// @param[out]	outMessages Message list
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		If there are no messages, returns with success and the outMessages size is 0.
+	///////////////////////////////////////////////////////////
+	Result Receive(std::vector<ByteBuffer> &outMessages);
+
+private:
+	/// Header of the queue in the shared memory
+	struct Header;
+
+	/// Name
+	std::string m_name;
+
+	/// Ownership
+	bool m_isOwner;
+
+	/// Shared memory of the header and the slots
+	SharedMemory *m_memory;
+
+	/// Header at the top of the shared memory (NULL: not opened)
+	Header *m_header;
+
+	/// Slots
+	char *m_slots;
+
+	/// Producer: head last read (the consumer has released the slots before it)
+	unsigned int m_cachedHead;
+
+	/// Consumer: tail last read (the producer has published the slots before it)
+	unsigned int m_cachedTail;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	ShmMessageQueue(const ShmMessageQueue &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	ShmMessageQueue& operator=(const ShmMessageQueue &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Initialize
+	/// @param[in]	maxMessageCount Maximum number of messages (0: open the created queue)
+	/// @param[in]	maxMessageSize Maximum message length
+	///////////////////////////////////////////////////////////
+	void Init(long maxMessageCount, long maxMessageSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get a slot
+	/// @param[in]	position Head or tail
+	/// @return		Top of the slot (length)
+	///////////////////////////////////////////////////////////
+	char *slot(unsigned int position);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the position after a message
+	/// @param[in]	position Head or tail
+	/// @return		Next position
+	///////////////////////////////////////////////////////////
+	unsigned int next(unsigned int position);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of messages between two positions
+	/// @param[in]	tail Tail
+	/// @param[in]	head Head
+	/// @return		Number of messages
+	///////////////////////////////////////////////////////////
+	unsigned int used(unsigned int tail, unsigned int head);
+};
+}
+
+#endif
@@ -0,0 +1,218 @@
+///////////////////////////////////////////////////////////
+/// @file	ShmMpmcQueue.h
+/// @brief	Shared memory multi-producer/multi-consumer message queue
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_SHM_MPMC_QUEUE__
+#define __LIGHT_IPC_SHM_MPMC_QUEUE__
+
+#include <string>
+#include <vector>
+#include "Result.h"
+#include "ByteBuffer.h"
+#include "SharedMemory.h"
+
+namespace LightIPC {
+///////////////////////////////////////////////////////////
+/// @class ShmMpmcQueue
+/// @brief	Bounded message queue in SharedMemory for many producers and consumers
+///
+/// - Any number of threads and processes send and receive at the same time
+///   (ShmMessageQueue is cheaper for one sender and one receiver)
+/// - Lock free: each slot carries a sequence number telling whether it is free
+///   for the sender or filled for the receiver of a given position, the senders
+///   and the receivers claim positions with a compare-and-swap (Vyukov's bounded queue),
+///   no kernel lock is taken
+/// - A slot holds a message of any size up to maxMessageSize
+/// - The receivers sleep on a futex only when the queue is empty,
+///   the senders only when it is full
+/// - A process that dies between claiming a position and filling/releasing
+///   its slot stalls the queue at that slot
+///
+///  [ SharedMemory ]
+///   +---------------------------------------------+-----------------------------------------------+-----
+///   | header (geometry, positions, wakeup events) | slot 0: sequence + length + data (64 aligned) | ...
+///   +---------------------------------------------+-----------------------------------------------+-----
+///
+///////////////////////////////////////////////////////////
+class ShmMpmcQueue {
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if a message queue with the specified name exists
+	/// @return		Result
+	/// @note		name Must start with'/' eg) "/mpmcq1"
+	///////////////////////////////////////////////////////////
+	static Result Exist(const std::string &name);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Constructor
+	///
+	/// Use the created message queue as a reference
+	///
+	/// @param[in]	name name
+	/// @note		name Must start with'/' eg) "/mpmcq1"
+	/// @note		Exist() determines if the message queue exists
+	///////////////////////////////////////////////////////////
+	ShmMpmcQueue(const std::string &name);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Constructor
+	///
+	/// Creating and using a new message queue
+	///
+	/// @param[in]	name name
+	/// @param[in]	maxMessageCount Maximum number of messages that can be registered in the message queue> 0
+	/// @param[in]	maxMessageSize Maximum message length> 0
+	/// @note		name Must start with'/' eg) "/mpmcq1"
+	/// @note		Create/delete message queue
+	///////////////////////////////////////////////////////////
+	ShmMpmcQueue(const std::string &name, long maxMessageCount, long maxMessageSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~ShmMpmcQueue();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get name
+	/// @return		name
+	///////////////////////////////////////////////////////////
+	const std::string &Name() const;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the maximum number of messages that can be registered in the message queue
+	/// @return		Maximum number of messages (-1: not opened)
+	///////////////////////////////////////////////////////////
+	long MaxMessageCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get maximum size of message that can be registered in message queue
+	/// @return		Message length (-1: not opened)
+	///////////////////////////////////////////////////////////
+	long MaxMessageSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of messages currently in the message queue
+	/// @return		Number of messages currently in the message queue (-1: not opened)
+	/// @note		Includes the messages being sent or received at the moment
+	///////////////////////////////////////////////////////////
+	long CurrentMessageCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Clear messages in the message queue
+	///////////////////////////////////////////////////////////
+	void Clear();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a message to the message queue
+	/// @param[in]	message message
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is full, block until there is space
+	/// @note		A message with a message size of 0 is also possible
+	///////////////////////////////////////////////////////////
+	Result Send(const ByteBuffer &message);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send message to Message Queue with timeout
+	/// @param[in]	message message
+	/// @param[in]	millisec millisecond
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		millisec If is 0, block until sending is possible
+	/// @note		If there is no space in the message queue after waiting for the specified time, an error occurs
+	/// @note		A message with a message size of 0 is also possible
+	///////////////////////////////////////////////////////////
+	Result TimedSend(const ByteBuffer &message, unsigned long millisec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive a message from the message queue
+	/// @param[out]	outMessage message
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is empty, block until a newly added message is available
+	///////////////////////////////////////////////////////////
+	Result Receive(ByteBuffer &outMessage);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive message from message queue with timeout
+	/// @param[out]	outMessage message
+	/// @param[in]	millisec millisecond
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		When the message queue is empty, an error will occur if the message cannot be obtained after waiting for the specified time.
+	/// @note		millisec If is 0, block until it can be obtained
+	///////////////////////////////////////////////////////////
+	Result TimedReceive(ByteBuffer &outMessage, unsigned long millisec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive all messages stored in the message queue
+	/// @param[out]	outMessages Message list
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		If there are no messages, returns with success and the outMessages size is 0.
+	/// @note		Other receivers may take some of the messages at the same time
+	///////////////////////////////////////////////////////////
+	Result Receive(std::vector<ByteBuffer> &outMessages);
+
+private:
+	/// Header of the queue in the shared memory
+	struct Header;
+
+	/// Slot of a message
+	struct Slot;
+
+	/// Name
+	std::string m_name;
+
+	/// Ownership
+	bool m_isOwner;
+
+	/// Shared memory of the header and the slots
+	SharedMemory *m_memory;
+
+	/// Header at the top of the shared memory (NULL: not opened)
+	Header *m_header;
+
+	/// Slots
+	char *m_slots;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	ShmMpmcQueue(const ShmMpmcQueue &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	ShmMpmcQueue& operator=(const ShmMpmcQueue &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Initialize
+	/// @param[in]	maxMessageCount Maximum number of messages (0: open the created queue)
+	/// @param[in]	maxMessageSize Maximum message length
+	///////////////////////////////////////////////////////////
+	void Init(long maxMessageCount, long maxMessageSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the slot of a position
+	/// @param[in]	position Position of a sender or a receiver
+	/// @return		Slot
+	///////////////////////////////////////////////////////////
+	Slot *slot(unsigned long long position);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Put a message into the queue without waiting
+	/// @param[in]	message message (not larger than maxMessageSize)
+	/// @return		false When the queue is full
+	///////////////////////////////////////////////////////////
+	bool tryEnqueue(const ByteBuffer &message);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Take a message out of the queue without waiting
+	/// @param[out]	outMessage message
+	/// @return		false When the queue is empty
+	///////////////////////////////////////////////////////////
+	bool tryDequeue(ByteBuffer &outMessage);
+};
+}
+
+#endif
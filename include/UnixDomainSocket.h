@@ -8,13 +8,17 @@
 #define __LIGHT_IPC_UNIX_DOMAIN_SOCKET__
 
 #include <string>
+#include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <time.h>
 #include "ByteBuffer.h"
 #include "Result.h"
 
 namespace LightIPC {
+class IoUring;
+
 ///////////////////////////////////////////////////////////
 /// @class UnixDomainSocket
 /// @brief	UNIX Use datagrams with domain sockets
@@ -26,33 +30,280 @@ namespace LightIPC {
 ///  - The order of data does not get out of order
 ///  - Connection error occurs when there is no connection destination
 /// 
+///  [ Socket mode ]
+///   SOCKET_MODE_DATAGRAM (default)
+///     ${path}.tx and ${path}.rx are bound, one owner talks to one partner
+///   SOCKET_MODE_SEQPACKET
+///     The owner listens on ${path} and accepts connections (SOCK_SEQPACKET),
+///     the partner connects to ${path}. One owner talks to many partners
+/// 
+///  [ Address type ]
+///   ADDRESS_FILESYSTEM (default)
+///     The names are socket files, stale files are unlinked by the owner
+///   ADDRESS_ABSTRACT
+///     The names are in the Linux abstract namespace (sun_path starts with NUL),
+///     no file is created and the name is released when the socket is closed.
+///     path is only a name and does not need a directory
+/// 
+///  [ Framing ]
+///   FRAMING_DATAGRAM (default)
+///     Frame Header, Header and Body are sent as one datagram (sendmsg)
+///     and received with one recvmsg. Messages larger than the maximum
+///     datagram size of the socket fall back to fragmented transmission.
+///   FRAMING_FRAGMENTED
+///     Frame Header, Header and Body are sent as separate datagrams
+///     and Body is divided by 1024 byte. An empty Header is not sent after a
+///     Frame Header. A message sent without Frame starts with the 8 byte
+///     Protocol Header instead, always followed by Header (compatible with older peers,
+///     SOCKET_MODE_SEQPACKET always sends a Frame Header)
+///   The receiver accepts both framings regardless of the setting
+///   The reception buffer holds a datagram as large as SO_RCVBUF of the socket (at least
+///   MaxDatagramSize()). A larger datagram fails as truncated and the buffer grows to its
+///   size for the next one (io_uring: the buffer ring is rebuilt for its size)
+/// 
+///  [ Frame ]
+///   The Frame Header is fixed and aligned, it is read with one copy. Besides the
+///   sizes it carries the Frame of the application (type, flags and correlation ID),
+///   a message that needs nothing else is sent with an empty Header.
+///   Send()/Receive() without Frame send zero fields and ignore the received ones
+/// 
+///  [ Descriptor passing ]
+///   With SetDescriptorThreshold(), a body of the threshold size or larger is written
+///   to a sealed memfd and the descriptor is passed with SCM_RIGHTS. Only the
+///   Frame Header and the header go through the socket, the receiver maps the memfd
+///   and does not need to read the body datagram by datagram.
+///   The sender copies the body into the memfd. Receive() copies it out of the mapping
+///   into the body ByteBuffer (the mapping is released before Receive() returns),
+///   Receive() into a MappedBody keeps the mapping and the body is read in place
+/// 
+///  [ Checksum ]
+///   With SetChecksum(), a CRC32C (Crc32c) of the Frame Header, Header and Body is
+///   sent in the Frame Header. A message carrying one is verified by the receiver
+///   regardless of its setting, a mismatch fails that message only.
+///   A datagram that can not start a message (the rest of a message whose datagrams
+///   were lost) is discarded and the reception continues with the next message
+///   (ResyncCount()). A fragmented message that meets the start of the next message
+///   fails, the next message is received as usual
+/// 
+///  [ Socket buffers ]
+///   SetSendBufferSize()/SetReceiveBufferSize() set SO_SNDBUF/SO_RCVBUF of the sockets
+///   (also of the connections accepted afterwards), SendQueueSize()/ReceiveQueueSize()
+///   tell the occupancy (SIOCOUTQ/SIOCINQ). For UNIX domain datagrams the bytes in flight
+///   are bounded by SO_SNDBUF of the sender, the receive queue by the number of
+///   datagrams (net.unix.max_dgram_qlen).
+///   With SetBufferAutotune(), SO_SNDBUF of the socket that sends grows up to the
+///   specified size: a new peak message (or batch) size is checked at once, the backlog
+///   (SIOCOUTQ) every 64 messages. The buffer is made twice the backlog plus the peak.
+///   MaxDatagramSize() is not raised, the partner receives with buffers of its own size
+///   The reception buffers hold a datagram as large as SO_RCVBUF of the socket: give the
+///   receiver a SetReceiveBufferSize() not smaller than SetSendBufferSize() of its partner
+/// 
+///  [ Busy poll ]
+///   With SetBusyPoll(), the reception retries without blocking (MSG_DONTWAIT) for
+///   the specified time before it blocks. A message arriving meanwhile is taken
+///   without the wakeup latency of a sleeping thread, at the cost of a busy CPU
+/// 
+///  [ I/O engine ]
+///   IO_ENGINE_SOCKET (default)
+///     The messages are received with recvmsg/recvmmsg
+///   IO_ENGINE_URING
+///     The messages are received through io_uring (IoUring): one multishot recvmsg
+///     stays armed and the kernel fills registered buffers, a busy receiver takes
+///     the datagrams from the completion ring without system calls.
+///     The buffers hold datagrams of SetUringDatagramSize() (default 64 KB), a larger
+///     datagram is lost as truncated and the buffers are rebuilt for its size: give
+///     it the MaxDatagramSize() of the partner when it sends large datagrams.
+///     SendBatch() submits its datagrams as linked sendmsg with one io_uring_enter
+///     on a second ring, Send() uses sendmsg.
+///     Used for the receiving socket (not for the connections accepted by a
+///     SOCKET_MODE_SEQPACKET owner), falls back to IO_ENGINE_SOCKET when io_uring is
+///     unavailable (Engine() tells the engine in use)
+/// 
+///  [ Batch ]
+///   SendBatch() sends several messages with one sendmmsg and ReceiveBatch()
+///   receives the pending messages with one recvmmsg. The wire format is the same,
+///   a batch can be received by Receive() and the other way round
+/// 
 ///  [ Send/Receive message data structure]
 ///               Top                                            Bottom
 ///               0                                                     n
 ///               +-----------------+-----------------+-----------------+
-///   Category    | Protocol Header |     Header      |      Body       |
+///   Category    |  Frame Header   |     Header      |      Body       |
 ///               +-----------------+-----------------+-----------------+
-///   Data Type   |    ------       |   ByteBuffer    |   ByteBuffer    |
+///   Data Type   |     Frame       |   ByteBuffer    |   ByteBuffer    |
 ///               +-----------------+-----------------+-----------------+
-///   Owner       |    Framework    |   Application   |   Application   |   
+///   Owner       | Framework/Appl. |   Application   |   Application   |   
 ///               +-----------------+-----------------+-----------------+
 ///   Data Length |  Fixed Length   | Variable Length | Variable Length |
-///               |    8 byte       |   < 512 byte    | n byte < limit  |
+///               |     24 byte     |   < 512 byte    | n byte < limit  |
 ///               +-----------------+-----------------+-----------------+
+///   ( Protocol Header of 8 byte instead of Frame Header: fragmented message without Frame )
+/// 
+///  [ Frame Header ]
+///               0        4        5        6        7        8
+///               +--------+--------+--------+--------+--------+
+///               |hexspeak|version |control |  type  | flags  |
+///               +--------+--------+--------+--------+--------+
+///               8                 12                16                20                24
+///               +-----------------+-----------------+-----------------+-----------------+
+///               |  correlationId  |    body size    |   header size   |    checksum     |
+///               +-----------------+-----------------+-----------------+-----------------+
 ///
 ///////////////////////////////////////////////////////////
 class UnixDomainSocket
 {
 public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Message framing on the wire
+	///////////////////////////////////////////////////////////
+	enum FramingMode {
+		FRAMING_FRAGMENTED = 0,	///< One datagram per part, body divided by 1024 byte
+		FRAMING_DATAGRAM		///< One datagram per message if it fits
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Socket type and addressing
+	///////////////////////////////////////////////////////////
+	enum SocketMode {
+		SOCKET_MODE_DATAGRAM = 0,	///< SOCK_DGRAM pair ${path}.tx/${path}.rx (one-to-one)
+		SOCKET_MODE_SEQPACKET		///< SOCK_SEQPACKET listening on ${path} (one-to-many)
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Namespace of the socket addresses
+	///////////////////////////////////////////////////////////
+	enum AddressType {
+		ADDRESS_FILESYSTEM = 0,	///< Socket files
+		ADDRESS_ABSTRACT		///< Linux abstract namespace
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		How the messages are received
+	///////////////////////////////////////////////////////////
+	enum IoEngine {
+		IO_ENGINE_SOCKET = 0,	///< recvmsg/recvmmsg
+		IO_ENGINE_URING			///< io_uring multishot recvmsg with registered buffers
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Fields of the Frame Header set by the application
+	///////////////////////////////////////////////////////////
+	struct Frame
+	{
+		/// Message type
+		unsigned char type;
+
+		/// Flags of the message type
+		unsigned char flags;
+
+		/// Correlates a response with its request
+		unsigned int correlationId;
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Received body that is read in place when it was passed by descriptor
+	/// @note		A body passed in a memfd stays mapped until Release(), the next reception
+	///				into this MappedBody or the destructor, the other bodies are copied into it
+	///////////////////////////////////////////////////////////
+	class MappedBody
+	{
+	public:
+		///////////////////////////////////////////////////////////
+		/// @brief		Constructor (empty body)
+		///////////////////////////////////////////////////////////
+		MappedBody();
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Destructor (the mapping is released)
+		///////////////////////////////////////////////////////////
+		~MappedBody();
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Get the body data
+		/// @note		Valid until the body is released
+		///////////////////////////////////////////////////////////
+		const char *Data() const;
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Get the body size
+		///////////////////////////////////////////////////////////
+		size_t Size() const;
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Check if the body is mapped from a memfd
+		///////////////////////////////////////////////////////////
+		bool IsMapped() const;
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Release the body (unmap the memfd)
+		///////////////////////////////////////////////////////////
+		void Release();
+
+	private:
+		friend class UnixDomainSocket;
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Take a mapping of size bytes (released by this MappedBody)
+		///////////////////////////////////////////////////////////
+		void assign(void *mapping, size_t size);
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Copy constructor
+		/// @note		Copy prohibited
+		///////////////////////////////////////////////////////////
+		MappedBody(const MappedBody &src);
+
+		///////////////////////////////////////////////////////////
+		/// @brief		Assignment operator
+		/// @note		Substitution prohibited
+		///////////////////////////////////////////////////////////
+		MappedBody &operator=(const MappedBody &src);
+
+		/// Mapping of the memfd (NULL: the body is in m_body)
+		void *m_mapping;
+
+		/// Size of m_mapping
+		size_t m_mappingSize;
+
+		/// Body that was not passed by descriptor
+		ByteBuffer m_body;
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Buffers of one message sent or received by a batch
+	///////////////////////////////////////////////////////////
+	struct MessageBuffer
+	{
+		/// Frame (NULL: zero fields are sent, the received ones are ignored)
+		Frame *frame;
+
+		/// Header data
+		ByteBuffer *header;
+
+		/// Body data
+		ByteBuffer *body;
+
+		/// Reception only: a body passed by descriptor is mapped here instead of copied
+		/// into body (NULL: copied), body is then left empty
+		MappedBody *mapped;
+
+		MessageBuffer() : frame(NULL), header(NULL), body(NULL), mapped(NULL) {}
+	};
+
 	///////////////////////////////////////////////////////////
 	/// @brief		constructor
 	/// @param[in]	path The file path representing the socket
 	/// @param[in]	isOwner Ownership
-	/// @note		path Must be a file-creatable path
+	/// @param[in]	mode SocketMode
+	/// @param[in]	addressType AddressType
+	/// @param[in]	engine IoEngine
+	/// @note		path Must be a file-creatable path (ADDRESS_FILESYSTEM)
 	/// @note		1 One-to-one communication same path and isOwner is true and false
 	/// 			Establish a communication connection with (not meant to be ownership)
+	/// @note		SOCKET_MODE_SEQPACKET The owner listens, the others connect to the owner
 	///////////////////////////////////////////////////////////
-	UnixDomainSocket(const std::string &path, bool isOwner);
+	UnixDomainSocket(const std::string &path, bool isOwner, SocketMode mode = SOCKET_MODE_DATAGRAM
+		, AddressType addressType = ADDRESS_FILESYSTEM, IoEngine engine = IO_ENGINE_SOCKET);
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Destructor
@@ -82,18 +333,76 @@ public:
 	/// @param[in]	body  Body data
 	/// @return		Result When it fails, the error content is set to Error
 	/// @note		header The contents of body are set by the user
+	/// @note		SOCKET_MODE_SEQPACKET Only the connecting side can use this method
 	///////////////////////////////////////////////////////////
 	Result Send(const ByteBuffer &header, const ByteBuffer &body);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Send data with a Frame to the other party
+	/// @param[in]	frame Frame
+	/// @param[in]	header Header data (may be empty)
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		SOCKET_MODE_SEQPACKET Only the connecting side can use this method
+	///////////////////////////////////////////////////////////
+	Result Send(const Frame &frame, const ByteBuffer &header, const ByteBuffer &body);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Receive data from the other party
 	/// @param[out]	header Header data
 	/// @param[out]	body  Body data
 	/// @return		Result When it fails, the error content is set to Error
 	/// @note		The connection partner receives the header and body sent ().
+	/// @note		SOCKET_MODE_SEQPACKET When the partner closes the connection, the socket is no longer opened
+	/// @note		outHeader and outBody are filled in place, reusing the same buffers
+	/// 			for every reception does not allocate memory once they are large enough
 	///////////////////////////////////////////////////////////
 	Result Receive(ByteBuffer &outHeader, ByteBuffer &outBody);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive data and its Frame from the other party
+	/// @param[out]	outFrame Frame (zero when the message was sent without Frame)
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		SOCKET_MODE_SEQPACKET When the partner closes the connection, the socket is no longer opened
+	/// @note		A message that fails after its Frame Header was decoded still sets outFrame,
+	/// 			otherwise outFrame is not changed
+	///////////////////////////////////////////////////////////
+	Result Receive(Frame &outFrame, ByteBuffer &outHeader, ByteBuffer &outBody);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive data and its Frame, a body passed by descriptor is not copied
+	/// @param[out]	outFrame Frame (zero when the message was sent without Frame)
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data, mapped from the memfd when the body was passed by descriptor
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The previous body of outBody is released first
+	/// @note		SOCKET_MODE_SEQPACKET When the partner closes the connection, the socket is no longer opened
+	///////////////////////////////////////////////////////////
+	Result Receive(Frame &outFrame, ByteBuffer &outHeader, MappedBody &outBody);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send several messages to the other party
+	/// @param[in]	messages Messages to send in order
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Messages that fit a datagram are sent with one sendmmsg (io_uring: one
+	/// 			io_uring_enter) per 64 messages, the others are fragmented in between
+	/// @note		When it fails, the messages before the failed one have been sent
+	///////////////////////////////////////////////////////////
+	Result SendBatch(const std::vector<MessageBuffer> &messages);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive the pending messages from the other party
+	/// @param[in]	buffers Buffers filled in order (the number of buffers is the maximum count)
+	/// @param[out]	outCount Number of messages received
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Blocks until one message arrives, then takes the messages already waiting
+	/// @note		When a message fails, the error of the first one is returned and outCount
+	/// 			messages are the others of the batch (a socket error: the ones before it)
+	///////////////////////////////////////////////////////////
+	Result ReceiveBatch(const std::vector<MessageBuffer> &buffers, size_t &outCount);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Specify the maximum send/receive data size
 	/// @param[in]	limit Maximum send/receive data size
@@ -107,6 +416,287 @@ public:
 	///////////////////////////////////////////////////////////
 	unsigned int LimitSize();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the framing used by Send()
+	/// @param[in]	mode FramingMode
+	/// @note		default:FRAMING_DATAGRAM
+	///////////////////////////////////////////////////////////
+	void SetFramingMode(FramingMode mode);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the framing used by Send()
+	///////////////////////////////////////////////////////////
+	FramingMode Framing();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the maximum size of one datagram
+	/// @note		Derived from SO_SNDBUF when the socket is opened (0 before open)
+	/// @note		Larger messages are fragmented
+	///////////////////////////////////////////////////////////
+	size_t MaxDatagramSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify how long a send waits for room on a non-blocking connection
+	/// @param[in]	msec Wait time in milliseconds
+	/// @note		default:500
+	/// @note		Applies to the connections accepted by AcceptConnection(), the other
+	///				sockets block until the partner receives
+	///////////////////////////////////////////////////////////
+	void SetSendTimeout(unsigned int msec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the body size passed by a memfd descriptor
+	/// @param[in]	size Bodies of this size or larger are passed with SCM_RIGHTS
+	/// @note		0: Disabled (default)
+	/// @note		Used with FRAMING_DATAGRAM, the receiver accepts it regardless of the setting
+	/// @note		The body is copied once on each side (into and out of the memfd)
+	///////////////////////////////////////////////////////////
+	void SetDescriptorThreshold(size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the body size passed by a memfd descriptor
+	/// @note		0 Represents disabled
+	///////////////////////////////////////////////////////////
+	size_t DescriptorThreshold();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the time to spin before the reception blocks
+	/// @param[in]	microseconds Busy poll time
+	/// @note		0: Disabled (default), block at once
+	/// @note		The CPU is busy while spinning, it pays off only when the partner
+	/// 			runs on another CPU (the spin delays a partner sharing the same CPU)
+	///////////////////////////////////////////////////////////
+	void SetBusyPoll(unsigned int microseconds);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the time to spin before the reception blocks
+	/// @note		0 Represents disabled
+	///////////////////////////////////////////////////////////
+	unsigned int BusyPoll();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of receptions the busy poll took a message
+	///////////////////////////////////////////////////////////
+	unsigned long BusyPollHits();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of receptions that blocked after the busy poll
+	///////////////////////////////////////////////////////////
+	unsigned long BusyPollMisses();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify whether a checksum is sent with each message
+	/// @param[in]	isEnabled true: CRC32C of the message in the Frame Header
+	/// @note		default:false, the receiver verifies it regardless of the setting
+	///////////////////////////////////////////////////////////
+	void SetChecksum(bool isEnabled);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check whether a checksum is sent with each message
+	///////////////////////////////////////////////////////////
+	bool IsChecksum();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of datagrams discarded to find the start of a message
+	///////////////////////////////////////////////////////////
+	unsigned long ResyncCount();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the send buffer size of the sockets (SO_SNDBUF)
+	/// @param[in]	size Buffer size (0: the system default)
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Applied when the socket is opened if it is not open yet
+	/// @note		Beyond net.core.wmem_max, SO_SNDBUFFORCE is tried (CAP_NET_ADMIN)
+	///////////////////////////////////////////////////////////
+	Result SetSendBufferSize(size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the send buffer size of the socket
+	/// @note		The value of the kernel (twice the requested size), 0 before open
+	///////////////////////////////////////////////////////////
+	size_t SendBufferSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the receive buffer size of the sockets (SO_RCVBUF)
+	/// @param[in]	size Buffer size (0: the system default)
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Applied when the socket is opened if it is not open yet
+	/// @note		Beyond net.core.rmem_max, SO_RCVBUFFORCE is tried (CAP_NET_ADMIN)
+	///////////////////////////////////////////////////////////
+	Result SetReceiveBufferSize(size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the receive buffer size of the socket
+	/// @note		The value of the kernel (twice the requested size), 0 before open
+	///////////////////////////////////////////////////////////
+	size_t ReceiveBufferSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Let the send buffer grow with the traffic
+	/// @param[in]	maxSize Upper limit of the send buffer size
+	/// @note		0: Disabled (default)
+	///////////////////////////////////////////////////////////
+	void SetBufferAutotune(size_t maxSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the upper limit of the send buffer autotuning
+	/// @note		0 Represents disabled
+	///////////////////////////////////////////////////////////
+	size_t BufferAutotune();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the bytes sent and not received by the partner yet (SIOCOUTQ)
+	/// @note		0 When the socket is not open
+	///////////////////////////////////////////////////////////
+	size_t SendQueueSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the bytes waiting to be received (SIOCINQ)
+	/// @note		SOCKET_MODE_DATAGRAM: the size of the next datagram only
+	/// @note		0 When the socket is not open
+	///////////////////////////////////////////////////////////
+	size_t ReceiveQueueSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the socket mode
+	///////////////////////////////////////////////////////////
+	SocketMode Mode();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the namespace of the socket addresses
+	///////////////////////////////////////////////////////////
+	AddressType Address();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the I/O engine in use
+	/// @note		IO_ENGINE_SOCKET when io_uring was requested but is unavailable
+	///////////////////////////////////////////////////////////
+	IoEngine Engine();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Specify the datagram size of the io_uring reception buffers
+	/// @param[in]	size Largest datagram received without truncation
+	/// @note		default:65536, applied by OpenSocket() (IO_ENGINE_URING)
+	/// @note		Memory: about 128 times the size. A larger datagram is lost as truncated
+	/// 			once, then the buffers grow to its size
+	///////////////////////////////////////////////////////////
+	void SetUringDatagramSize(size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the datagram size of the io_uring reception buffers
+	/// @note		The size in use after OpenSocket(), grown by truncated datagrams
+	///////////////////////////////////////////////////////////
+	size_t UringDatagramSize();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Wake up the threads blocked in Receive()/ReceiveBatch()
+	/// @note		They return an error (ECANCELED) instead of waiting,
+	/// 			and so does every reception that would wait until ClearWakeup()
+	/// @note		Messages already waiting in the socket are still received
+	///////////////////////////////////////////////////////////
+	void Wakeup();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Let the receptions wait again after Wakeup()
+	///////////////////////////////////////////////////////////
+	void ClearWakeup();
+
+protected:
+	///////////////////////////////////////////////////////////
+	/// @brief		Send data over an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[in]	header Header data
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Send(int socketFd, const ByteBuffer &header, const ByteBuffer &body);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send data with a Frame over an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[in]	frame Frame
+	/// @param[in]	header Header data (may be empty)
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Send(int socketFd, const Frame &frame, const ByteBuffer &header, const ByteBuffer &body);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive data from an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @param[out]	outIsClosed True when the partner closed the connection
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Receive(int socketFd, ByteBuffer &outHeader, ByteBuffer &outBody, bool &outIsClosed);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive data and its Frame from an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[out]	outFrame Frame (zero when the message was sent without Frame)
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @param[out]	outIsClosed True when the partner closed the connection
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Receive(int socketFd, Frame &outFrame, ByteBuffer &outHeader, ByteBuffer &outBody, bool &outIsClosed);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send several messages over an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[in]	messages Messages to send in order
+	/// @param[out]	outIsTimedOut True when it failed because the partner left no room
+	/// 			for SetSendTimeout() (the rest of a message may be unsent)
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result SendBatch(int socketFd, const std::vector<MessageBuffer> &messages, bool &outIsTimedOut);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive the pending messages from an accepted connection
+	/// @param[in]	socketFd Connection returned by AcceptConnection()
+	/// @param[in]	buffers Buffers filled in order (the number of buffers is the maximum count)
+	/// @param[out]	outCount Number of messages received
+	/// @param[out]	outIsClosed True when the partner closed the connection (after outCount messages)
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result ReceiveBatch(int socketFd, const std::vector<MessageBuffer> &buffers, size_t &outCount, bool &outIsClosed);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Accept a connection (SOCKET_MODE_SEQPACKET owner)
+	/// @return		Socket file descriptor of the connection, -1 on failure
+	/// @note		The caller closes the returned descriptor
+	/// @note		The connection is non-blocking: a send to it waits for room at most
+	///				SetSendTimeout() and then fails with ETIMEDOUT
+	///////////////////////////////////////////////////////////
+	int AcceptConnection();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the socket file descriptor for reception
+	/// @return		Socket file descriptor (listening socket of SOCKET_MODE_SEQPACKET owner)
+	///////////////////////////////////////////////////////////
+	int ReceiveSocketFd();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the event file descriptor signaled by Wakeup()
+	/// @return		eventfd (readable while woken up), -1 when it could not be created
+	/// @note		Watch it with the sockets when waiting outside Receive()
+	///////////////////////////////////////////////////////////
+	int WakeupFd();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the busy poll time has not passed yet
+	/// @param[in]	start Time the busy poll started (CLOCK_MONOTONIC)
+	/// @return		true While spinning is allowed
+	///////////////////////////////////////////////////////////
+	bool IsBusyPollTime(const timespec &start);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Count the result of a busy poll
+	/// @param[in]	isHit True when it found a message, false when it blocks afterwards
+	///////////////////////////////////////////////////////////
+	void CountBusyPoll(bool isHit);
+
 private:
 	/// File Path
 	std::string m_path;
@@ -114,6 +704,12 @@ private:
 	/// Data transmission/reception file path switching flag
 	bool m_isOwner;
 
+	/// Socket mode
+	SocketMode m_socketMode;
+
+	/// Namespace of the socket addresses
+	AddressType m_addressType;
+
 	/// Socket file descriptor for sending
 	int m_txSocketFd;
 
@@ -131,6 +727,307 @@ private:
 
 	/// Maximum send/receive data size
 	unsigned int m_limitSize;
+
+	/// Framing used by Send()
+	FramingMode m_framingMode;
+
+	/// Maximum size of one datagram
+	size_t m_maxDatagramSize;
+
+	/// Maximum size of one received datagram (grows only)
+	size_t m_maxReceiveSize;
+
+	/// Buffer for receiving one datagram (grows only)
+	char *m_receiveBuffer;
+
+	/// Size of m_receiveBuffer
+	size_t m_receiveBufferSize;
+
+	/// Wait time of a send on a non-blocking connection (msec)
+	unsigned int m_sendTimeout;
+
+	/// The last waitWritable() timed out
+	bool m_isSendTimedOut;
+
+	/// Datagrams received by recvmmsg (ReceiveBatch, grows only)
+	char *m_batchBuffer;
+
+	/// Size of m_batchBuffer
+	size_t m_batchBufferSize;
+
+	/// Body size passed by a memfd descriptor (0: disabled)
+	size_t m_descriptorThreshold;
+
+	/// Busy poll time in microseconds (0: disabled)
+	unsigned int m_busyPollTime;
+
+	/// Busy polls that found a message
+	unsigned long m_busyPollHits;
+
+	/// Busy polls that blocked afterwards
+	unsigned long m_busyPollMisses;
+
+	/// Send a checksum with each message
+	bool m_isChecksum;
+
+	/// Datagrams discarded to find the start of a message
+	unsigned long m_resyncCount;
+
+	/// Start of a message met while receiving a fragmented one, received next
+	char *m_heldDatagram;
+
+	/// Size of the datagram in m_heldDatagram (0: none)
+	size_t m_heldSize;
+
+	/// Size of m_heldDatagram (grows only)
+	size_t m_heldBufferSize;
+
+	/// Socket m_heldDatagram was received from
+	int m_heldSocketFd;
+
+	/// Requested SO_SNDBUF (0: system default)
+	size_t m_sendBufferSize;
+
+	/// Requested SO_RCVBUF (0: system default)
+	size_t m_socketReceiveBufferSize;
+
+	/// Upper limit of the send buffer autotuning (0: disabled)
+	size_t m_autotuneLimit;
+
+	/// Largest message or batch sent
+	size_t m_peakSendSize;
+
+	/// Messages sent since the last backlog check
+	unsigned int m_autotuneCount;
+
+	/// Requested I/O engine
+	IoEngine m_ioEngine;
+
+	/// io_uring reception of m_rxSocketFd (NULL: IO_ENGINE_SOCKET)
+	IoUring *m_uring;
+
+	/// io_uring transmission of m_txSocketFd (NULL: IO_ENGINE_SOCKET)
+	IoUring *m_sendUring;
+
+	/// Datagram size of the io_uring reception buffers
+	size_t m_uringDatagramSize;
+
+	/// Buffers of Receive() through io_uring (batch of one)
+	std::vector<MessageBuffer> m_singleBuffer;
+
+	/// eventfd signaled by Wakeup()
+	int m_wakeupFd;
+
+	/// Datagrams of a batch not decoded yet
+	struct ReceivedDatagrams;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Wait until the socket is readable
+	/// @param[in]	socketFd Socket file descriptor
+	/// @return		false When woken up by Wakeup() (errno ECANCELED) or on error
+	///////////////////////////////////////////////////////////
+	bool waitReadable(int socketFd);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Open SOCKET_MODE_DATAGRAM sockets
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result openDatagramSocket();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Open SOCKET_MODE_SEQPACKET socket (listen or connect)
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result openSeqpacketSocket();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Apply the requested buffer sizes to a socket
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	isSend Apply the send buffer size
+	/// @param[in]	isReceive Apply the receive buffer size
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result applyBufferSizes(int socketFd, bool isSend, bool isReceive);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Grow the send buffer for the next transmission (autotuning)
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	size Bytes of the message or batch to send
+	///////////////////////////////////////////////////////////
+	void autotune(int socketFd, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set up io_uring for the receiving socket (IO_ENGINE_URING)
+	///////////////////////////////////////////////////////////
+	void openEngine();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send datagrams like sendmmsg
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in,out]	msgs Datagrams (msg_len is set)
+	/// @param[in]	count Number of datagrams
+	/// @return		Number of datagrams sent, -1 on error (errno)
+	/// @note		Through io_uring for m_txSocketFd with IO_ENGINE_URING
+	///////////////////////////////////////////////////////////
+	int sendDatagrams(int socketFd, mmsghdr *msgs, size_t count);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive datagrams like recvmmsg (MSG_WAITFORONE)
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in,out]	msgs Datagrams (filled by io_uring, or buffers given to recvmmsg)
+	/// @param[out]	iov iovec of the datagrams received by io_uring
+	/// @param[out]	outBufferIds io_uring buffers to release, -1 for recvmmsg
+	/// @param[in]	maxCount Maximum number of datagrams
+	/// @return		Number of datagrams, -1 on error (errno)
+	///////////////////////////////////////////////////////////
+	int receiveDatagrams(int socketFd, mmsghdr *msgs, iovec *iov, int *outBufferIds, size_t maxCount);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a message
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	address Destination (NULL for a connected socket)
+	/// @param[in]	frame Frame (NULL: zero fields)
+	/// @param[in]	header Header data
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendMessage(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the message divided into datagrams
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	address Destination (NULL for a connected socket)
+	/// @param[in]	frame Frame (NULL: zero fields)
+	/// @param[in]	header Header data
+	/// @param[in]	body  Body data
+	/// @param[in]	transmitSize Maximum size of one body datagram
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendFragmented(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body, size_t transmitSize);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the message with the body in a memfd (SCM_RIGHTS)
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	address Destination (NULL for a connected socket)
+	/// @param[in]	frame Frame (NULL: zero fields)
+	/// @param[in]	header Header data
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendDescriptor(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send several messages
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	address Destination (NULL for a connected socket)
+	/// @param[in]	messages Messages to send in order
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendBatch(int socketFd, const sockaddr_un *address, const std::vector<MessageBuffer> &messages);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check that a message can be sent
+	/// @param[in]	header Header data
+	/// @param[in]	body  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result checkMessage(const ByteBuffer &header, const ByteBuffer &body);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive a message
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[out]	outFrame Frame (NULL: not needed)
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @param[out]	outMapped Body passed by descriptor, mapped (NULL: copied into outBody)
+	/// @param[out]	outIsClosed True when the partner closed the connection
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result receiveMessage(int socketFd, Frame *outFrame, ByteBuffer &outHeader, ByteBuffer &outBody, MappedBody *outMapped, bool &outIsClosed);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive the pending messages
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	buffers Buffers filled in order
+	/// @param[out]	outCount Number of messages received
+	/// @param[out]	outIsClosed True when the partner closed the connection
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result receiveBatch(int socketFd, const std::vector<MessageBuffer> &buffers, size_t &outCount, bool &outIsClosed);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Read the next datagram of a fragmented message
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	pending Datagrams already received by a batch (NULL: read the socket)
+	/// @param[out]	buffer Destination
+	/// @param[in]	size Size of buffer (the rest of the datagram is discarded)
+	/// @return		Received size, -1 on error
+	///////////////////////////////////////////////////////////
+	ssize_t readDatagram(int socketFd, ReceivedDatagrams *pending, char *buffer, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive the message starting with the held datagram
+	/// @param[in]	socketFd Socket file descriptor the datagram was received from
+	/// @param[out]	outFrame Frame (NULL: not needed)
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result receiveHeld(int socketFd, Frame *outFrame, ByteBuffer &outHeader, ByteBuffer &outBody);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Take a datagram of a fragmented message that starts the next message
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	pending Datagrams already received by a batch (NULL: read the socket)
+	/// @param[in]	isPending The datagram was taken from pending
+	/// @param[in]	data Datagram
+	/// @param[in]	len Size of the datagram
+	/// @return		true When the datagram starts a message, it is received next
+	///////////////////////////////////////////////////////////
+	bool holdMessageStart(int socketFd, ReceivedDatagrams *pending, bool isPending, const char *data, ssize_t len);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Count a datagram discarded to find the start of a message
+	///////////////////////////////////////////////////////////
+	void countResync();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Receive header and body of a fragmented message
+	/// @param[in]	socketFd Socket file descriptor
+	/// @param[in]	pending Datagrams already received by a batch (NULL: read the socket)
+	/// @param[in]	isHeaderSent The header is sent as a datagram before the body
+	/// @param[in]	size Body size announced by the protocol header
+	/// @param[out]	outHeader Header data
+	/// @param[out]	outBody  Body data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result receiveFragmented(int socketFd, ReceivedDatagrams *pending, bool isHeaderSent, unsigned int size, ByteBuffer &outHeader, ByteBuffer &outBody);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Raise the maximum size of one received datagram
+	/// @param[in]	size Datagram size without the FrameHeader
+	/// @note		The reception buffer grows at the next reception
+	///////////////////////////////////////////////////////////
+	void growReceiveSize(size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Wait until the socket has room to send (at most m_sendTimeout)
+	/// @param[in]	socketFd Socket file descriptor
+	/// @return		false When the time is over (errno ETIMEDOUT, m_isSendTimedOut) or on error
+	///////////////////////////////////////////////////////////
+	bool waitWritable(int socketFd);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	UnixDomainSocket(const UnixDomainSocket &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	UnixDomainSocket& operator=(const UnixDomainSocket &src);
 };
 }
 
@@ -7,7 +7,9 @@
 #ifndef __LIGHT_IPC_UNIX_DOMAIN_SOCKET_CLIENT__
 #define __LIGHT_IPC_UNIX_DOMAIN_SOCKET_CLIENT__
 
+#include <map>
 #include "UnixDomainSocket.h"
+#include "BulkRing.h"
 #include "Mutex.h"
 #include "Thread.h"
 
@@ -19,6 +21,8 @@ namespace LightIPC {
 /// - Called when a notification message is received from the server
 /// - Implement this interface to implement the process when a notification message is received
 /// - The processing when received should be finished promptly
+/// - The notifications coalesced by UnixDomainSocketServer::QueueNotify() are unpacked,
+///   ReceiveNotify() is called for each of them in order
 ///
 ///////////////////////////////////////////////////////////
 class INotifyReceiver
@@ -38,6 +42,223 @@ public:
 	virtual void ReceiveNotify(ByteBuffer &update) = 0;
 };
 
+///////////////////////////////////////////////////////////
+/// @class	IResponseReceiver
+/// @brief	Response receiving interface
+/// 
+/// - Called when the response to UnixDomainSocketClient::AsyncSendReceive() arrives
+/// - Called on the response thread of the client
+/// - The processing when received should be finished promptly
+///
+///////////////////////////////////////////////////////////
+class IResponseReceiver
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~IResponseReceiver() {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Implement response reception process
+	/// @param[in]	requestId Request ID returned by AsyncSendReceive()
+	/// @param[in]	result Result When it fails, the error content is set to Error
+	/// @param[in]	response received data (empty on error)
+	///////////////////////////////////////////////////////////
+	virtual void ReceiveResponse(unsigned int requestId, const Result &result, ByteBuffer &response) = 0;
+};
+
+class UnixDomainSocketClient;
+
+///////////////////////////////////////////////////////////
+/// @class	ResponseFuture
+/// @brief	Response of a request that is sent asynchronously
+/// 
+/// - Pass to UnixDomainSocketClient::AsyncSendReceive(), it returns immediately
+/// - IsReady() checks the arrival without blocking, Wait() blocks until the arrival,
+///   TimedWait() blocks until the arrival or the timeout
+/// - Cancel() gives up the request, the response that arrives later is discarded
+/// - Can be reused for the next request after the response arrived
+/// - When destroyed before the arrival, the request is abandoned and the response is discarded
+///
+///////////////////////////////////////////////////////////
+class ResponseFuture
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	///////////////////////////////////////////////////////////
+	ResponseFuture();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~ResponseFuture();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the request ID
+	/// @return		Request ID (0 before AsyncSendReceive())
+	///////////////////////////////////////////////////////////
+	unsigned int RequestId();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the response has arrived (or the request failed)
+	/// @return		true When Wait() does not block
+	///////////////////////////////////////////////////////////
+	bool IsReady();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Wait until the response arrives
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result Wait();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Wait until the response arrives or the timeout
+	/// @param[in]	msec Timeout (milliseconds)
+	/// @return		Result When it fails or times out, the error content is set to Error
+	/// @note		The request is still in progress after a timeout (wait again or Cancel())
+	///////////////////////////////////////////////////////////
+	Result TimedWait(unsigned int msec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Cancel the request in progress
+	/// @return		Result Error when no request is in progress (the response has already arrived)
+	/// @note		Wait() returns the cancel error, the response that arrives later is discarded
+	///////////////////////////////////////////////////////////
+	Result Cancel();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get received data
+	/// @return		received data
+	/// @note		Valid after IsReady() returns true
+	///////////////////////////////////////////////////////////
+	ByteBuffer &Response();
+
+private:
+	friend class UnixDomainSocketClient;
+
+	/// Mutex to wait for the response
+	Mutex m_mutex;
+
+	/// Client the request was sent by
+	UnixDomainSocketClient *m_client;
+
+	/// Request ID
+	unsigned int m_requestId;
+
+	/// Response arrival status
+	bool m_isReady;
+
+	/// Received error information
+	Result m_result;
+
+	/// Received body information
+	ByteBuffer m_response;
+
+	/// Where received data is stored (m_response or the caller's buffer)
+	ByteBuffer *m_output;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set the result and wake up the waiting threads
+	/// @param[in]	result Result
+	/// @param[in]	response received data (NULL on error)
+	///////////////////////////////////////////////////////////
+	void complete(const Result &result, ByteBuffer *response);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	ResponseFuture(const ResponseFuture &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	ResponseFuture& operator=(const ResponseFuture &src);
+};
+
+///////////////////////////////////////////////////////////
+/// @class	StreamWriter
+/// @brief	Sends a large request body in chunks
+///
+/// - Opened by UnixDomainSocketClient::OpenStream()
+/// - Each Write() is sent as it is, the server hands it to IStreamReceiver as it arrives,
+///   neither side holds the whole body
+/// - Close() ends the body and waits for the response of IStreamReceiver::StreamEnd()
+/// - Flow control: Write() blocks while the socket buffer of the server is full,
+///   the writer can not run ahead of the processing of the server
+/// - When destroyed while open, the stream is aborted
+///
+///////////////////////////////////////////////////////////
+class StreamWriter
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		constructor
+	///////////////////////////////////////////////////////////
+	StreamWriter();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~StreamWriter();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the stream is open
+	/// @return		true Between OpenStream() and Close()/Abort()
+	///////////////////////////////////////////////////////////
+	bool IsOpen();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a chunk of the body
+	/// @param[in]	chunk Transmission data (any size up to LimitSize())
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Blocks while the server is behind
+	///////////////////////////////////////////////////////////
+	Result Write(const ByteBuffer &chunk);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		End the body and receive the response
+	/// @param[out]	response received data
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The stream is closed even if it fails
+	///////////////////////////////////////////////////////////
+	Result Close(ByteBuffer &response);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Give up the stream
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The server is told to discard the received chunks (IStreamReceiver::StreamAborted())
+	///////////////////////////////////////////////////////////
+	Result Abort();
+
+private:
+	friend class UnixDomainSocketClient;
+
+	/// Client the stream was opened by (NULL when closed)
+	UnixDomainSocketClient *m_client;
+
+	/// Stream ID (request ID of the stream)
+	unsigned int m_streamId;
+
+	/// Response of the stream
+	ResponseFuture m_future;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Copy constructor
+	/// @note		Copy prohibited
+	///////////////////////////////////////////////////////////
+	StreamWriter(const StreamWriter &src);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Assignment operator
+	/// @note		Substitution prohibited
+	///////////////////////////////////////////////////////////
+	StreamWriter& operator=(const StreamWriter &src);
+};
+
 
 ///////////////////////////////////////////////////////////
 /// @class	UnixDomainSocketClient
@@ -47,6 +268,19 @@ public:
 /// - IRunnable is implemented because the receiving process is internally threaded.
 /// - Send a request to the connection partner (server), receive a response, and perform some processing
 /// - Implement INotifyReceiver to receive notification from the other party (server)
+/// - Each request carries a request ID (correlation ID) in the Frame and the server returns it with the response.
+///   Several threads can call SendReceive() at the same time, the requests are pipelined
+///   and each response is handed to the thread waiting for it, regardless of the order of arrival
+/// - AsyncSendReceive() returns without waiting, the response is delivered to ResponseFuture
+///   or IResponseReceiver by the response thread
+/// - SOCKET_MODE_SEQPACKET connects to a server shared by many clients.
+///   When the server closes the connection, the pending requests fail and the client becomes inactive
+/// - SetBusyPoll() makes the response thread spin before it sleeps, the response is handed over
+///   without the wakeup latency of the response thread
+/// - OpenStream() sends a large body in chunks through StreamWriter
+/// - EnableBulkChannel() passes the large request and response bodies through rings in
+///   shared memory (BulkRing), only a small descriptor goes over the socket.
+///   Small bodies and bodies that do not fit in the ring keep using the socket
 ///
 ///////////////////////////////////////////////////////////
 class UnixDomainSocketClient : public UnixDomainSocket, public IRunnable
@@ -55,9 +289,13 @@ public:
 	///////////////////////////////////////////////////////////
 	/// @brief		constructor
 	/// @param[in]	path The file path representing the socket
+	/// @param[in]	mode SocketMode (same as the server)
+	/// @param[in]	addressType AddressType (same as the server)
+	/// @param[in]	engine IoEngine (IO_ENGINE_URING: the responses and notifications)
 	/// @note		path Needs to set the same path as the communication partner (server)
 	///////////////////////////////////////////////////////////
-	UnixDomainSocketClient(const std::string &path);
+	UnixDomainSocketClient(const std::string &path, SocketMode mode = SOCKET_MODE_DATAGRAM
+		, AddressType addressType = ADDRESS_FILESYSTEM, IoEngine engine = IO_ENGINE_SOCKET);
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Destructor
@@ -77,9 +315,77 @@ public:
 	/// @param[out]	response received data
 	/// @return		Result When it fails, the error content is set to Error
 	/// @note		Wait until you receive the response
+	/// @note		Thread safe, other threads can send requests while waiting
 	///////////////////////////////////////////////////////////
 	Result SendReceive(ByteBuffer &request, ByteBuffer &response);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a request to the other party (server) and receive a response within the timeout
+	/// @param[in]	request Transmission data
+	/// @param[out]	response received data
+	/// @param[in]	msec Timeout (milliseconds)
+	/// @return		Result When it fails or times out, the error content is set to Error
+	/// @note		After the timeout the request is canceled, the late response is discarded
+	/// @note		Thread safe, other threads can send requests while waiting
+	///////////////////////////////////////////////////////////
+	Result TimedSendReceive(ByteBuffer &request, ByteBuffer &response, unsigned int msec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a request to the other party (server) without waiting for the response
+	/// @param[in]	request Transmission data
+	/// @param[out]	outResponse Handle the response is delivered to
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		outResponse Must live until the response arrives or be destroyed to abandon the request
+	///////////////////////////////////////////////////////////
+	Result AsyncSendReceive(ByteBuffer &request, ResponseFuture &outResponse);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a request to the other party (server) without waiting for the response
+	/// @param[in]	request Transmission data
+	/// @param[in]	receiver IResponseReceiver called when the response arrives
+	/// @param[out]	outRequestId Request ID passed to IResponseReceiver::ReceiveResponse()
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		receiver Is not called when sending fails
+	///////////////////////////////////////////////////////////
+	Result AsyncSendReceive(ByteBuffer &request, IResponseReceiver *receiver, unsigned int &outRequestId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Cancel a request in progress
+	/// @param[in]	requestId Request ID of AsyncSendReceive()
+	/// @return		Result Error when no request is in progress (the response has already arrived)
+	/// @note		IResponseReceiver::ReceiveResponse() or ResponseFuture is completed with the cancel error,
+	/// 			the response that arrives later is discarded
+	///////////////////////////////////////////////////////////
+	Result CancelRequest(unsigned int requestId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Open a stream to send a request body in chunks
+	/// @param[out]	outWriter StreamWriter to write the chunks with
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The server receives the chunks with IStreamReceiver
+	/// @note		outWriter Must not be open
+	///////////////////////////////////////////////////////////
+	Result OpenStream(StreamWriter &outWriter);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Pass the large bodies through shared memory
+	/// @param[in]	threshold Bodies of this size or larger go through the rings
+	/// @param[in]	capacity Size of the ring of each direction
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Creates a ring for the requests and a ring for the responses
+	/// 			and has the server open them (the server applies the same threshold)
+	/// @note		Call once, before the requests that should use it
+	/// @note		SendReceive() and AsyncSendReceive() requests use it, not the streams
+	/// @note		A request whose body the server can not read from the ring fails with the server's error
+	///////////////////////////////////////////////////////////
+	Result EnableBulkChannel(size_t threshold, size_t capacity);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Check if the bulk channel is enabled
+	/// @return		true After EnableBulkChannel() succeeded
+	///////////////////////////////////////////////////////////
+	bool IsBulkChannel();
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Send a ping to the connection partner (server)
 	/// @param[in]	None
@@ -95,6 +401,22 @@ public:
 	void Run();
 
 private:
+	friend class ResponseFuture;
+	friend class StreamWriter;
+
+	///////////////////////////////////////////////////////////
+	/// @brief	Request waiting for the response
+	/// @note	Either handle or receiver is set
+	///////////////////////////////////////////////////////////
+	struct PendingRequest
+	{
+		/// Handle of AsyncSendReceive()/SendReceive()
+		ResponseFuture *handle;
+
+		/// IResponseReceiver of AsyncSendReceive()
+		IResponseReceiver *receiver;
+	};
+
 	/// Mutex to synchronize sending process
 	Mutex m_mutex;
 
@@ -107,20 +429,32 @@ private:
 	/// Activated state
 	bool m_isActive;
 
-	/// Mutex for reception
+	/// Mutex for the pending requests
 	Mutex m_responseMutex;
 
-	/// Received data arrival status
-	bool m_responseArrived;
+	/// Request ID to be assigned next (0 and the pending IDs are skipped)
+	unsigned int m_nextRequestId;
 
-	/// Received error information
-	Result m_isResponseError;
+	/// Requests waiting for the response (key:request ID)
+	std::map<unsigned int, PendingRequest> m_pendingRequests;
 
-	/// Receive header information
-	ByteBuffer m_responseHeader;
+	/// Notification unpacked from a batch (response thread only)
+	ByteBuffer m_notifyUpdate;
 
-	/// Received body information
-	ByteBuffer m_response;
+	/// Header of the requests (empty, the Frame carries the type and the request ID)
+	ByteBuffer m_noHeader;
+
+	/// Ring of the request bodies (under m_mutex, NULL: bulk channel disabled)
+	BulkRing *m_bulkRequestRing;
+
+	/// Ring of the response bodies (under m_responseMutex, read by the response thread)
+	BulkRing *m_bulkResponseRing;
+
+	/// Bodies of this size or larger go through the rings
+	size_t m_bulkThreshold;
+
+	/// Descriptor of the request body in m_bulkRequestRing (under m_mutex)
+	ByteBuffer m_bulkDescriptor;
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Start response data service
@@ -145,6 +479,70 @@ private:
 	/// @note
 	///////////////////////////////////////////////////////////
 	Result privateSendReceive(ByteBuffer &request, ByteBuffer &response, unsigned int requestType);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Register the request as pending and send it
+	/// @param[in]	request Transmission data
+	/// @param[in]	requestType Transmission data type
+	/// @param[in]	pending Where the response is delivered
+	/// @param[out]	outRequestId Request ID
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendRequest(ByteBuffer &request, unsigned int requestType, const PendingRequest &pending, unsigned int &outRequestId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the request to a ResponseFuture
+	/// @param[in]	request Transmission data
+	/// @param[in]	requestType Transmission data type
+	/// @param[out]	outResponse Handle the response is delivered to
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendFutureRequest(ByteBuffer &request, unsigned int requestType, ResponseFuture &outResponse);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send a chunk of an open stream
+	/// @param[in]	streamId Stream ID
+	/// @param[in]	flags Stream flags (end, abort)
+	/// @param[in]	chunk Transmission data
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result sendStream(unsigned int streamId, unsigned int flags, const ByteBuffer &chunk);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Hand the response to the request waiting for it
+	/// @param[in]	requestId Request ID returned by the server
+	/// @param[in]	response Received data
+	/// @note		Responses to unknown request ID are discarded
+	///////////////////////////////////////////////////////////
+	void completeRequest(unsigned int requestId, ByteBuffer &response);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Finish the pending request with an error
+	/// @param[in]	requestId Request ID
+	/// @param[in]	result Error information
+	/// @return		false When the request is not pending
+	///////////////////////////////////////////////////////////
+	bool failRequest(unsigned int requestId, const Result &result);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Finish all pending requests with an error
+	/// @param[in]	result Error information
+	///////////////////////////////////////////////////////////
+	void failPendingRequests(const Result &result);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Hand the notifications of a batch to INotifyReceiver
+	/// @param[in]	batch Received data (count, then each notification with its size)
+	/// @note		A malformed batch is discarded from the broken notification
+	///////////////////////////////////////////////////////////
+	void receiveNotifyBatch(ByteBuffer &batch);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Abandon the pending request
+	/// @param[in]	requestId Request ID
+	/// @note		Called when ResponseFuture is destroyed before the arrival
+	///////////////////////////////////////////////////////////
+	void abandonRequest(unsigned int requestId);
 };
 }
 
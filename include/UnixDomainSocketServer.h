@@ -7,7 +7,12 @@
 #ifndef __LIGHT_IPC_UNIX_DOMAIN_SOCKET_SERVER__
 #define __LIGHT_IPC_UNIX_DOMAIN_SOCKET_SERVER__
 
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
 #include "UnixDomainSocket.h"
+#include "BulkRing.h"
 #include "Mutex.h"
 #include "Thread.h"
 
@@ -38,6 +43,8 @@ public:
 	/// @param[out]	response Response data
 	/// @note		Wait for next reception until sending response
 	/// @note		Return appropriate response data according to the received data
+	/// @note		With UnixDomainSocketServer::SetWorkerCount() > 0 it is called
+	/// 			from several worker threads at the same time and must be thread safe
 	///////////////////////////////////////////////////////////
 	virtual void Received(ByteBuffer &request, ByteBuffer &response) = 0;
 
@@ -56,6 +63,54 @@ public:
 	virtual void ResponseError(const Result &result) {};
 };
 
+///////////////////////////////////////////////////////////
+/// @class	IStreamReceiver
+/// @brief	Stream receiving interface
+/// 
+/// - Called when the chunks of a stream (StreamWriter of the client) are received
+/// - Each chunk is handed over as it arrives, the whole body is never buffered
+/// - Called on the reception thread in the order of arrival, also with worker threads.
+///   The client can not send faster than this processing (flow control by the socket buffer)
+/// - The response is made by StreamEnd() and returned to StreamWriter::Close()
+///
+///////////////////////////////////////////////////////////
+class IStreamReceiver
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Destructor
+	///////////////////////////////////////////////////////////
+	virtual ~IStreamReceiver() {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Called when a stream is opened
+	/// @param[in]	streamId Stream ID (unique in the server)
+	/// @note		Default does nothing
+	///////////////////////////////////////////////////////////
+	virtual void StreamBegin(unsigned long streamId) {};
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Implement chunk reception process
+	/// @param[in]	streamId Stream ID
+	/// @param[in]	chunk received data (reused after this call)
+	///////////////////////////////////////////////////////////
+	virtual void StreamReceived(unsigned long streamId, ByteBuffer &chunk) = 0;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Implement the end of the stream
+	/// @param[in]	streamId Stream ID
+	/// @param[out]	response Response data
+	///////////////////////////////////////////////////////////
+	virtual void StreamEnd(unsigned long streamId, ByteBuffer &response) = 0;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Called when the client aborts the stream or disconnects
+	/// @param[in]	streamId Stream ID
+	/// @note		Default does nothing
+	///////////////////////////////////////////////////////////
+	virtual void StreamAborted(unsigned long streamId) {};
+};
+
 ///////////////////////////////////////////////////////////
 /// @class	UnixDomainSocketServer
 /// @brief	UNIX Domain socket server
@@ -65,17 +120,47 @@ public:
 /// - Receives a request from the connection partner (client), performs some processing,
 ///   Implement IRequestReceiver to send response
 /// - Call Notify() if you want to send a message to the other party (client).
+/// - SetWorkerCount() Dispatches requests to a pool of worker threads.
+///   The reception thread only receives and queues the requests, the workers call
+///   IRequestReceiver::Received() in parallel and send the responses
+/// - SOCKET_MODE_SEQPACKET serves many clients: the reception thread accepts the connections
+///   and waits for the requests of all of them with epoll. Each response is returned to the
+///   connection the request came from, Notify() and Ping() are sent to every connection
+///   The connections are non-blocking: a client whose socket buffer stays full for
+///   SetSendTimeout() is disconnected instead of stopping the others
+/// - The reception thread takes the waiting requests with one recvmmsg (SetReceiveBatchSize()),
+///   the responses that are ready together are sent with one sendmmsg
+/// - SetBusyPoll() makes the reception thread spin before it sleeps (epoll_wait or recvmmsg)
+/// - SetStreamReceiver() receives the bodies sent in chunks (UnixDomainSocketClient::OpenStream())
+/// - QueueNotify() coalesces the notifications: the queued updates are sent as one message
+///   when SetNotifyCoalescing() size or delay is reached, the client unpacks them
+/// - The rings of UnixDomainSocketClient::EnableBulkChannel() are opened per connection:
+///   the large request bodies are read from shared memory and the large responses are written
+///   there, IRequestReceiver sees the bodies as usual
 ///
 ///////////////////////////////////////////////////////////
 class UnixDomainSocketServer : public UnixDomainSocket, public IRunnable
 {
 public:
+	///////////////////////////////////////////////////////////
+	/// @brief		Order of the responses sent by the worker threads
+	///////////////////////////////////////////////////////////
+	enum ResponseOrder {
+		RESPONSE_ORDER_COMPLETION = 0,	///< Send as soon as processed (client matches them by request ID)
+		RESPONSE_ORDER_REQUEST			///< Send in the order the requests of each client were received
+	};
+
 	///////////////////////////////////////////////////////////
 	/// @brief		constructor
 	/// @param[in]	path The file path representing the socket
+	/// @param[in]	mode SocketMode
+	/// @param[in]	addressType AddressType (same as the client)
+	/// @param[in]	engine IoEngine (IO_ENGINE_URING: the datagrams of SOCKET_MODE_DATAGRAM)
 	/// @note		path Needs to set the same path as the communication partner (client)
+	/// @note		SOCKET_MODE_SEQPACKET Any number of clients can connect to path
 	///////////////////////////////////////////////////////////
-	UnixDomainSocketServer(const std::string &path);
+	UnixDomainSocketServer(const std::string &path, SocketMode mode = SOCKET_MODE_DATAGRAM
+		, AddressType addressType = ADDRESS_FILESYSTEM, IoEngine engine = IO_ENGINE_SOCKET);
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Destructor
@@ -89,6 +174,38 @@ public:
 	///////////////////////////////////////////////////////////
 	void SetReceiver(IRequestReceiver *receiver);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		IStreamReceiver To set
+	/// @param[in]	receiver IStreamReceiver
+	/// @note		Without it the chunks are discarded and the response of the stream is empty
+	/// @note		Call before Start()
+	///////////////////////////////////////////////////////////
+	void SetStreamReceiver(IStreamReceiver *receiver);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set the number of worker threads that process requests
+	/// @param[in]	count Number of worker threads
+	/// @note		0: Process on the reception thread (default)
+	/// @note		Call before Start()
+	///////////////////////////////////////////////////////////
+	void SetWorkerCount(unsigned int count);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set the order of the responses sent by the worker threads
+	/// @param[in]	order ResponseOrder
+	/// @note		default:RESPONSE_ORDER_COMPLETION
+	/// @note		Call before Start()
+	///////////////////////////////////////////////////////////
+	void SetResponseOrder(ResponseOrder order);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Set the number of requests received at once
+	/// @param[in]	count Maximum number of requests per recvmmsg (1 to 64)
+	/// @note		default:16
+	/// @note		Call before Start()
+	///////////////////////////////////////////////////////////
+	void SetReceiveBatchSize(unsigned int count);
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Start request reception process from the connection partner (client)
 	/// @param[in]	isBlock Stop() True if you want to block with this method until is called
@@ -98,7 +215,8 @@ public:
 
 	///////////////////////////////////////////////////////////
 	/// @brief		Stop the request reception process from the connection partner (client)
-	/// @note		
+	/// @note		The reception thread is woken up through an eventfd (not canceled),
+	/// 			the requests it has received and the queued requests are processed before the threads stop
 	///////////////////////////////////////////////////////////
 	void Stop();
 
@@ -107,9 +225,60 @@ public:
 	/// @param[in]	update Message to notify
 	/// @return		Result When it fails, the error content is set to Error
 	/// @note		There is no response because it is a one-way message transmission
+	/// @note		SOCKET_MODE_SEQPACKET Sent to all connected clients,
+	/// 			the error of the first failed connection is returned
 	///////////////////////////////////////////////////////////
 	Result Notify(ByteBuffer &update);
 
+	///////////////////////////////////////////////////////////
+	/// @brief		Notify the other party (client) of several messages at once
+	/// @param[in]	updates Messages to notify in order
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Sent with one sendmmsg (per connection)
+	///////////////////////////////////////////////////////////
+	Result Notify(std::vector<ByteBuffer> &updates);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Enable the coalescing of QueueNotify()
+	/// @param[in]	maxBytes The queued updates are sent when their size reaches this (0: disabled)
+	/// @param[in]	delayUsec The queued updates are sent at the latest this long after the first one
+	/// 			(microseconds, 0: only by size or FlushNotify())
+	/// @note		default:disabled (QueueNotify() sends immediately)
+	/// @note		Call before Start(), the delay is kept by a thread started by Start()
+	///////////////////////////////////////////////////////////
+	void SetNotifyCoalescing(size_t maxBytes, unsigned int delayUsec);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Queue a message to notify to the other party (client)
+	/// @param[in]	update Message to notify (copied)
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The client receives the messages in the queued order,
+	/// 			each by INotifyReceiver::ReceiveNotify()
+	/// @note		Sending errors of the delayed flush are reported to IRequestReceiver::ResponseError()
+	///////////////////////////////////////////////////////////
+	Result QueueNotify(ByteBuffer &update);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Queue a message to notify, replacing the queued message of the same key
+	/// @param[in]	key Key of the value (latest value wins)
+	/// @param[in]	update Message to notify (copied)
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		The replaced message keeps its place in the queue
+	///////////////////////////////////////////////////////////
+	Result QueueNotify(unsigned int key, ByteBuffer &update);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the queued messages now
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result FlushNotify();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get the number of connected clients
+	/// @return		Number of connections (SOCKET_MODE_SEQPACKET), 0 otherwise
+	///////////////////////////////////////////////////////////
+	size_t ConnectionCount();
+
 	///////////////////////////////////////////////////////////
 	/// @brief		Send a ping to the connection partner (client)
 	/// @param[in]	None
@@ -124,18 +293,367 @@ public:
 	///////////////////////////////////////////////////////////
 	void Run();
 
+	///////////////////////////////////////////////////////////
+	/// @brief		implements IRunnable::Cleanup()
+	/// @note		Do not call this method
+	///////////////////////////////////////////////////////////
+	void Cleanup();
+
 private:
-	/// Mutex to synchronize sending process
+	///////////////////////////////////////////////////////////
+	/// @brief	Received request and its response
+	///////////////////////////////////////////////////////////
+	struct Request
+	{
+		/// Reception order in the connection
+		unsigned long sequence;
+
+		/// Connection the request came from (SOCKET_MODE_SEQPACKET)
+		int socketFd;
+
+		/// Identifies the connection even if socketFd is reused
+		unsigned long connectionId;
+
+		/// Frame: request type, request ID and flags (returned with the response)
+		Frame frame;
+
+		/// Header (returned with the response)
+		ByteBuffer header;
+
+		/// Received data
+		ByteBuffer request;
+
+		/// Response data
+		ByteBuffer response;
+
+		/// Descriptor of the response in the bulk channel
+		ByteBuffer bulk;
+
+		/// Not processed, response is the error message
+		bool isFailed;
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief	Order of the requests of a connection
+	///////////////////////////////////////////////////////////
+	struct ResponseSequence
+	{
+		/// Reception order of the next request (reception thread only)
+		unsigned long nextRequest;
+
+		/// Reception order of the next response to send (RESPONSE_ORDER_REQUEST)
+		unsigned long nextResponse;
+
+		/// Processed requests waiting for the preceding responses (RESPONSE_ORDER_REQUEST)
+		std::map<unsigned long, Request *> completed;
+
+		ResponseSequence() : nextRequest(0), nextResponse(0) {}
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @brief	Rings of a bulk channel opened by a client
+	///////////////////////////////////////////////////////////
+	struct BulkChannel
+	{
+		/// Ring of the request bodies (read by the reception thread)
+		BulkRing *requestRing;
+
+		/// Ring of the response bodies (written under m_mutex)
+		BulkRing *responseRing;
+
+		/// Bodies of this size or larger go through the rings
+		size_t threshold;
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @class	RequestWorker
+	/// @brief	Worker thread processing queued requests
+	///////////////////////////////////////////////////////////
+	class RequestWorker : public IRunnable
+	{
+	public:
+		RequestWorker(UnixDomainSocketServer *server) : m_server(server) {};
+		void Run() { m_server->processQueue(); };
+	private:
+		UnixDomainSocketServer *m_server;
+	};
+
+	///////////////////////////////////////////////////////////
+	/// @class	NotifyFlusher
+	/// @brief	Thread sending the queued notifications at their deadline
+	///////////////////////////////////////////////////////////
+	class NotifyFlusher : public IRunnable
+	{
+	public:
+		NotifyFlusher(UnixDomainSocketServer *server) : m_server(server) {};
+		void Run() { m_server->flushNotifyQueue(); };
+	private:
+		UnixDomainSocketServer *m_server;
+	};
+
+	/// Mutex to synchronize sending process (and m_connections, m_bulkChannels)
 	Mutex m_mutex;
 
+	/// epoll of the listening socket and the connections (SOCKET_MODE_SEQPACKET)
+	int m_epollFd;
+
+	/// Connections: socket file descriptor -> connection ID
+	std::map<int, unsigned long> m_connections;
+
+	/// ID of the next accepted connection
+	unsigned long m_nextConnectionId;
+
 	/// Reception processing Thread
 	Thread m_receiveThread;
 
 	/// IRequestReceiver
 	IRequestReceiver *m_requestReceiver;
 
+	/// IStreamReceiver
+	IStreamReceiver *m_streamReceiver;
+
+	/// Open streams: (connection ID, request ID) -> stream ID (reception thread only)
+	std::map<std::pair<unsigned long, unsigned int>, unsigned long> m_streams;
+
+	/// ID of the next stream
+	unsigned long m_nextStreamId;
+
+	/// Bulk channels: connection ID -> rings (under m_mutex, removed by the reception thread)
+	std::map<unsigned long, BulkChannel> m_bulkChannels;
+
 	/// Activated state
 	bool m_isActive;
+
+	/// Start() has been called (until Stop())
+	bool m_isStarted;
+
+	/// Number of worker threads
+	unsigned int m_workerCount;
+
+	/// Order of the responses
+	ResponseOrder m_responseOrder;
+
+	/// Worker threads
+	std::vector<Thread *> m_workerThreads;
+
+	/// IRunnable of the worker threads
+	RequestWorker m_worker;
+
+	/// Mutex for the request queue
+	Mutex m_queueMutex;
+
+	/// Requests waiting for a worker thread
+	std::deque<Request *> m_requestQueue;
+
+	/// Request objects for reuse
+	std::vector<Request *> m_freeRequests;
+
+	/// Number of requests received at once
+	unsigned int m_receiveBatchSize;
+
+	/// Requests being received by the reception thread
+	std::vector<Request *> m_receivingRequests;
+
+	/// Buffers of m_receivingRequests
+	std::vector<MessageBuffer> m_receiveBuffers;
+
+	/// Processed requests waiting to be sent
+	std::vector<Request *> m_responseQueue;
+
+	/// Requests being sent (under m_mutex)
+	std::vector<Request *> m_sendingRequests;
+
+	/// Buffers of the messages being sent (under m_mutex)
+	std::vector<MessageBuffer> m_sendBuffers;
+
+	/// Header of the messages sent by the server (empty, the Frame carries the type)
+	ByteBuffer m_noHeader;
+
+	/// Worker threads accept requests
+	bool m_isWorking;
+
+	/// Order of the requests of each connection: connection ID -> sequences
+	/// (under m_mutex, removed when the connection closes)
+	std::map<unsigned long, ResponseSequence> m_responseSequences;
+
+	/// Responses released in order by flushResponses() (under m_mutex)
+	std::vector<Request *> m_orderedRequests;
+
+	/// Mutex for the queued notifications (locked after m_mutex)
+	Mutex m_notifyMutex;
+
+	/// Size of the queued notifications that sends them (0: coalescing disabled)
+	size_t m_notifyMaxBytes;
+
+	/// Delay of the first queued notification (microseconds)
+	unsigned int m_notifyDelay;
+
+	/// Queued notifications (the first m_notifyCount, reused)
+	std::vector<ByteBuffer> m_notifyUpdates;
+
+	/// Number of queued notifications
+	size_t m_notifyCount;
+
+	/// Size of the queued notifications
+	size_t m_notifyBytes;
+
+	/// Queued notifications by key: key -> index of m_notifyUpdates
+	std::map<unsigned int, size_t> m_notifyKeys;
+
+	/// When the queued notifications must be sent (CLOCK_MONOTONIC)
+	timespec m_notifyDeadline;
+
+	/// The flush thread is running
+	bool m_isNotifying;
+
+	/// Flush thread
+	Thread m_notifyThread;
+
+	/// IRunnable of the flush thread
+	NotifyFlusher m_notifyFlusher;
+
+	/// Message of the queued notifications being sent (under m_mutex)
+	ByteBuffer m_notifyBatch;
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Reception loop of SOCKET_MODE_SEQPACKET (epoll reactor)
+	///////////////////////////////////////////////////////////
+	void runReactor();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Accept a connection and watch it
+	///////////////////////////////////////////////////////////
+	void acceptConnection();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Stop watching a connection and close it
+	/// @param[in]	socketFd Connection
+	///////////////////////////////////////////////////////////
+	void closeConnection(int socketFd);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Close all connections
+	///////////////////////////////////////////////////////////
+	void closeConnections();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Prepare m_receivingRequests and m_receiveBuffers for a batch
+	///////////////////////////////////////////////////////////
+	void prepareReceive();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Process the received requests or queue them for the worker threads
+	/// @param[in]	count Number of received requests (front of m_receivingRequests)
+	/// @param[in]	socketFd Connection the requests came from (-1: SOCKET_MODE_DATAGRAM)
+	///////////////////////////////////////////////////////////
+	void dispatchRequests(size_t count, int socketFd);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Hand a stream chunk to IStreamReceiver
+	/// @param[in]	request Received chunk
+	/// @return		true The stream ended and request holds the response to send
+	///////////////////////////////////////////////////////////
+	bool handleStream(Request *request);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Abort the open streams of a connection
+	/// @param[in]	connectionId Connection ID
+	///////////////////////////////////////////////////////////
+	void abortStreams(unsigned long connectionId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Open the rings offered by a client
+	/// @param[in]	request Request with the BulkChannelOffer, the response is set (empty: opened)
+	///////////////////////////////////////////////////////////
+	void openBulkChannel(Request *request);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Replace the body descriptor of a request with the body in the bulk channel
+	/// @param[in]	request Received request
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result readBulkBody(Request *request);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Close the bulk channel of a connection
+	/// @param[in]	connectionId Connection ID
+	/// @note		Lock m_mutex before calling
+	///////////////////////////////////////////////////////////
+	void closeBulkChannel(unsigned long connectionId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Forget the order of the requests of a connection
+	/// @param[in]	connectionId Connection ID
+	/// @note		The responses held back for the order are discarded
+	/// @note		Lock m_mutex before calling
+	///////////////////////////////////////////////////////////
+	void dropResponseSequence(unsigned long connectionId);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send messages to the client or to all connected clients
+	/// @param[in]	messages Messages to send
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		Lock m_mutex before calling
+	///////////////////////////////////////////////////////////
+	Result broadcast(const std::vector<MessageBuffer> &messages);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send messages to one connection
+	/// @param[in]	socketFd Socket file descriptor of the connection
+	/// @param[in]	messages Messages to send
+	/// @return		Result When it fails, the error content is set to Error
+	/// @note		A client that does not make room within SetSendTimeout() is shut down,
+	///				the reception thread closes the connection
+	/// @note		Lock m_mutex before calling
+	///////////////////////////////////////////////////////////
+	Result sendToConnection(int socketFd, const std::vector<MessageBuffer> &messages);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Queue a notification
+	/// @param[in]	isKeyed Replace the queued notification of key
+	/// @param[in]	key Key of the value
+	/// @param[in]	update Message to notify
+	/// @return		Result When it fails, the error content is set to Error
+	///////////////////////////////////////////////////////////
+	Result queueNotify(bool isKeyed, unsigned int key, ByteBuffer &update);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Flush thread loop
+	///////////////////////////////////////////////////////////
+	void flushNotifyQueue();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Worker thread loop
+	///////////////////////////////////////////////////////////
+	void processQueue();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Call IRequestReceiver to make the response
+	/// @param[in]	request Received request
+	///////////////////////////////////////////////////////////
+	void processRequest(Request *request);
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the responses waiting in m_responseQueue
+	/// @note		The requests are released by this method
+	///////////////////////////////////////////////////////////
+	void flushResponses();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Send the responses of m_sendingRequests
+	/// @note		Lock m_mutex before calling
+	///////////////////////////////////////////////////////////
+	void sendResponses();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Get a Request object
+	///////////////////////////////////////////////////////////
+	Request *allocateRequest();
+
+	///////////////////////////////////////////////////////////
+	/// @brief		Return a Request object for reuse
+	///////////////////////////////////////////////////////////
+	void releaseRequest(Request *request);
 };
 }
 
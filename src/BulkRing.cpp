@@ -0,0 +1,162 @@
+#include "BulkRing.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+namespace LightIPC {
+
+// "BULK"
+static const unsigned int RING_MAGIC = 0x4b4c5542;
+
+// The bodies start on their own cache line after the header
+static const size_t DATA_OFFSET = 64;
+
+// Header at the top of the shared memory (initialized by the owner)
+struct BulkRing::Header
+{
+	unsigned int magic;
+	unsigned int generation;
+	unsigned long long capacity;
+
+	/// Released by the reader: end of the last body read (bytes since the creation)
+	unsigned long long tail;
+};
+
+// Descriptor sent over the socket in place of the body
+struct BulkDescriptor
+{
+	unsigned long long offset;
+	unsigned int length;
+	unsigned int generation;
+};
+
+BulkRing::BulkRing(const std::string &name, size_t capacity, unsigned int generation, bool isOwner)
+	: m_memory(NULL)
+	, m_header(NULL)
+	, m_data(NULL)
+	, m_capacity(capacity)
+	, m_generation(generation)
+	, m_head(0)
+	, m_lastHead(0)
+{
+	// The length of a descriptor is 32 bits
+	if (capacity == 0 || capacity > UINT_MAX) {
+		std::fprintf(stderr, "bulk ring creation error [invalid capacity %lu]\n", static_cast<unsigned long>(capacity));
+		return;
+	}
+
+	m_memory = new SharedMemory(name, DATA_OFFSET + capacity, isOwner);
+	Header *header = m_memory->Data<Header>();
+	if (header == NULL) {
+		return;
+	}
+
+	if (isOwner) {
+		header->magic = RING_MAGIC;
+		header->generation = generation;
+		header->capacity = capacity;
+		__atomic_store_n(&header->tail, 0ULL, __ATOMIC_RELEASE);
+	}
+	else if (header->magic != RING_MAGIC || header->generation != generation || header->capacity != capacity) {
+		std::fprintf(stderr, "bulk ring open error [%s does not match]\n", name.c_str());
+		return;
+	}
+	m_header = header;
+	m_data = m_memory->Data<char>() + DATA_OFFSET;
+	m_head = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+	m_lastHead = m_head;
+}
+
+BulkRing::~BulkRing()
+{
+	delete m_memory;
+}
+
+bool BulkRing::IsOpend()
+{
+	return m_header != NULL;
+}
+
+const std::string &BulkRing::Name() const
+{
+	return m_memory->Name();
+}
+
+size_t BulkRing::Capacity() const
+{
+	return m_capacity;
+}
+
+unsigned int BulkRing::Generation() const
+{
+	return m_generation;
+}
+
+bool BulkRing::Write(const ByteBuffer &body, ByteBuffer &outDescriptor)
+{
+	size_t size = body.Size();
+	if (m_header == NULL || size == 0 || size > m_capacity) {
+		return false;
+	}
+
+	// A body does not wrap around, skip the end of the ring when it does not fit
+	unsigned long long offset = m_head;
+	size_t position = static_cast<size_t>(offset % m_capacity);
+	if (position + size > m_capacity) {
+		offset += m_capacity - position;
+		position = 0;
+	}
+	unsigned long long tail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+	if (offset + size - tail > m_capacity) {
+		return false;
+	}
+
+	::memcpy(m_data + position, body.Data().data(), size);
+	m_lastHead = m_head;
+	m_head = offset + size;
+
+	// Sending the descriptor over the socket publishes the body to the reader
+	BulkDescriptor descriptor;
+	descriptor.offset = offset;
+	descriptor.length = static_cast<unsigned int>(size);
+	descriptor.generation = m_generation;
+	outDescriptor.Assign(reinterpret_cast<const char *>(&descriptor), sizeof(descriptor));
+	return true;
+}
+
+void BulkRing::Discard()
+{
+	m_head = m_lastHead;
+}
+
+Result BulkRing::Read(const ByteBuffer &descriptor, ByteBuffer &outBody)
+{
+	if (m_header == NULL) {
+		return Result::CreateError("bulk ring error [%s]", "not opened");
+	}
+	BulkDescriptor value;
+	if (descriptor.Size() != sizeof(value)) {
+		return Result::CreateError("bulk ring error [descriptor size %lu]", static_cast<unsigned long>(descriptor.Size()));
+	}
+	::memcpy(&value, descriptor.Data().data(), sizeof(value));
+
+	if (value.generation != m_generation) {
+		return Result::CreateError("bulk ring error [generation %u, expected %u]", value.generation, m_generation);
+	}
+	// The body must lie in the ring and must not have been released yet
+	unsigned long long tail = __atomic_load_n(&m_header->tail, __ATOMIC_RELAXED);
+	unsigned long long end = value.offset + value.length;
+	size_t position = static_cast<size_t>(value.offset % m_capacity);
+	if (value.length == 0 || position + value.length > m_capacity || value.offset < tail || end - tail > m_capacity) {
+		return Result::CreateError("bulk ring error [invalid descriptor %llu+%u]", value.offset, value.length);
+	}
+
+	outBody.Assign(m_data + position, value.length);
+
+	// The writer may reuse the area (and the areas skipped before it) from now on
+	__atomic_store_n(&m_header->tail, end, __ATOMIC_RELEASE);
+	return Result::CreateSuccess();
+}
+
+}
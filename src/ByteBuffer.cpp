@@ -82,6 +82,32 @@ void ByteBuffer::Clear()
 	m_position = 0;
 }
 
+///////////////////////////////////////////////////////////
+/// @brief		Replace the contents of the buffer
+/// @param[in]	_data Data
+/// @param[in]	_size Data size
+/// @return		None
+/// @note
+///////////////////////////////////////////////////////////
+void ByteBuffer::Assign(const char *_data, size_t _size)
+{
+	m_buffer.assign(_data, _size);
+	m_position = 0;
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Change the size of the buffer to fill it in place
+/// @param[in]	_size New size
+/// @return		Beginning of the buffer
+/// @note
+///////////////////////////////////////////////////////////
+char *ByteBuffer::Resize(size_t _size)
+{
+	m_buffer.resize(_size);
+	m_position = 0;
+	return _size ? &m_buffer[0] : NULL;
+}
+
 ///////////////////////////////////////////////////////////
 /// @brief		Get buffer contents as a string
 /// @return		Byte data
@@ -103,6 +129,17 @@ ByteBuffer &ByteBuffer::Append(ByteBuffer &_data)
 	return Append(_data.Data());
 }
 
+///////////////////////////////////////////////////////////
+/// @brief		ByteBuffer Add (const)
+/// @param[in]	_data Data to write
+/// @return		ByteBuffer
+/// @note
+///////////////////////////////////////////////////////////
+ByteBuffer &ByteBuffer::Append(const ByteBuffer &_data)
+{
+	return Append(_data.Data());
+}
+
 ///////////////////////////////////////////////////////////
 /// @brief		Add a string (std::string)
 /// @param[in]	_data Data to write
@@ -0,0 +1,112 @@
+#include "Crc32c.h"
+
+#include <stdint.h>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace LightIPC {
+
+// Reflected 0x1EDC6F41
+static const uint32_t POLYNOMIAL = 0x82F63B78;
+
+// Tables of the slicing-by-8 computation
+struct Crc32cTable
+{
+	uint32_t entries[8][256];
+
+	Crc32cTable()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+			}
+			entries[0][i] = crc;
+		}
+		for (uint32_t i = 0; i < 256; i++) {
+			for (int slice = 1; slice < 8; slice++) {
+				uint32_t crc = entries[slice - 1][i];
+				entries[slice][i] = (crc >> 8) ^ entries[0][crc & 0xff];
+			}
+		}
+	}
+};
+
+static uint32_t extendTable(uint32_t crc, const unsigned char *data, size_t size)
+{
+	// Built once by the first caller
+	static const Crc32cTable table;
+	const uint32_t (*t)[256] = table.entries;
+
+	while (size >= 8) {
+		uint32_t low = 0;
+		uint32_t high = 0;
+		::memcpy(&low, data, sizeof(low));
+		::memcpy(&high, data + 4, sizeof(high));
+		low ^= crc;
+		crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+			^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+	while (size > 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+		data++;
+		size--;
+	}
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t extendHardware(uint32_t crc, const unsigned char *data, size_t size)
+{
+	uint64_t crc64 = crc;
+	while (size >= 8) {
+		uint64_t value = 0;
+		::memcpy(&value, data, sizeof(value));
+		crc64 = _mm_crc32_u64(crc64, value);
+		data += 8;
+		size -= 8;
+	}
+	crc = static_cast<uint32_t>(crc64);
+	while (size > 0) {
+		crc = _mm_crc32_u8(crc, *data);
+		data++;
+		size--;
+	}
+	return crc;
+}
+#endif
+
+unsigned int Crc32c::Compute(const void *data, size_t size)
+{
+	return Extend(0, data, size);
+}
+
+unsigned int Crc32c::Extend(unsigned int crc, const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	uint32_t value = ~static_cast<uint32_t>(crc);
+#if defined(__x86_64__)
+	if (IsAccelerated()) {
+		return ~extendHardware(value, bytes, size);
+	}
+#endif
+	return ~extendTable(value, bytes, size);
+}
+
+bool Crc32c::IsAccelerated()
+{
+#if defined(__x86_64__)
+	static const bool isSupported = __builtin_cpu_supports("sse4.2");
+	return isSupported;
+#else
+	return false;
+#endif
+}
+
+}
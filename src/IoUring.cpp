@@ -0,0 +1,637 @@
+#include "IoUring.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+namespace LightIPC {
+
+// Buffer group of the registered buffer ring (a rebuilt ring takes the other one)
+static const unsigned short BUFFER_GROUP = 0;
+
+// user_data of the multishot recvmsg and of its cancellation
+static const unsigned long long RECEIVE_REQUEST = 1;
+static const unsigned long long CANCEL_REQUEST = 2;
+
+// Submission queue entries (one request at a time)
+static const unsigned int SUBMISSION_ENTRIES = 4;
+
+// Time to wait for the multishot recvmsg to end when closing (milliseconds)
+static const int CANCEL_TIMEOUT = 100;
+
+static int ioUringSetup(unsigned int entries, io_uring_params *params)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int ringFd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+static int ioUringRegister(int ringFd, unsigned int opcode, void *arg, unsigned int count)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+}
+
+bool IoUring::IsSupported()
+{
+	// Multishot recvmsg came with Linux 6.0, together with IORING_SETUP_SINGLE_ISSUER
+	io_uring_params params;
+	::memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_SINGLE_ISSUER;
+	int ringFd = ioUringSetup(1, &params);
+	if (ringFd == -1) {
+		return false;
+	}
+	::close(ringFd);
+	return (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+}
+
+IoUring::IoUring()
+	: m_ringFd(-1)
+	, m_socketFd(-1)
+	, m_ring(MAP_FAILED)
+	, m_ringSize(0)
+	, m_sqes(MAP_FAILED)
+	, m_sqesSize(0)
+	, m_sqEntries(0)
+	, m_sqHead(NULL)
+	, m_sqTail(NULL)
+	, m_sqMask(0)
+	, m_sqArray(NULL)
+	, m_cqHead(NULL)
+	, m_cqTail(NULL)
+	, m_cqMask(0)
+	, m_cqes(NULL)
+	, m_bufferRing(MAP_FAILED)
+	, m_bufferRingSize(0)
+	, m_bufferCount(0)
+	, m_bufferTail(0)
+	, m_heldCount(0)
+	, m_bufferGroup(BUFFER_GROUP)
+	, m_bufferBase(0)
+	, m_retiredBuffers(static_cast<char *>(MAP_FAILED))
+	, m_retiredSize(0)
+	, m_retiredCount(0)
+	, m_buffers(static_cast<char *>(MAP_FAILED))
+	, m_bufferSize(0)
+	, m_datagramSize(0)
+	, m_requestedSize(0)
+	, m_controlSize(0)
+	, m_isArmed(false)
+	, m_isCanceling(false)
+	, m_error(0)
+	, m_syscallCount(0)
+	, m_wakeupFd(-1)
+{
+	::memset(&m_msg, 0, sizeof(m_msg));
+}
+
+IoUring::~IoUring()
+{
+	Close();
+}
+
+Result IoUring::Open(int socketFd, size_t datagramSize, size_t controlSize, unsigned int bufferCount)
+{
+	if (IsOpend()) {
+		return Result::CreateSuccess();
+	}
+	if (bufferCount == 0 || bufferCount > 32768 || (bufferCount & (bufferCount - 1)) != 0) {
+		return Result::CreateError("io_uring open error [%s:%u]", "invalid buffer count", bufferCount);
+	}
+
+	// Every datagram posts a completion, leave room for a full buffer ring
+	Result result = setupRing(SUBMISSION_ENTRIES, bufferCount * 2);
+	if (result.IsError()) {
+		return result;
+	}
+
+	m_bufferCount = bufferCount;
+	m_controlSize = controlSize;
+	m_bufferRingSize = bufferCount * sizeof(io_uring_buf);
+	m_heldCount = 0;
+	if (!setBuffers(datagramSize)) {
+		result = Result::CreateError("io_uring register error [%s]", ::strerror(errno));
+		Close();
+		return result;
+	}
+	m_requestedSize = datagramSize;
+
+	// The kernel reads the name and control lengths of each datagram from here
+	::memset(&m_msg, 0, sizeof(m_msg));
+	m_msg.msg_namelen = 0;
+	m_msg.msg_controllen = controlSize;
+
+	m_socketFd = socketFd;
+	m_isArmed = false;
+	m_isCanceling = false;
+	m_error = 0;
+	return Result::CreateSuccess();
+}
+
+Result IoUring::OpenSend(unsigned int entries)
+{
+	if (IsOpend()) {
+		return Result::CreateSuccess();
+	}
+	if (entries == 0) {
+		return Result::CreateError("io_uring open error [%s:%u]", "invalid entry count", entries);
+	}
+
+	// One completion per datagram
+	return setupRing(entries, entries * 2);
+}
+
+Result IoUring::setupRing(unsigned int entries, unsigned int completionEntries)
+{
+	if (!IsSupported()) {
+		return Result::CreateError("io_uring open error [%s]", "not supported");
+	}
+
+	io_uring_params params;
+	::memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = completionEntries;
+	m_ringFd = ioUringSetup(entries, &params);
+	if (m_ringFd == -1) {
+		return Result::CreateError("io_uring open error [%s]", ::strerror(errno));
+	}
+
+	// Submission and completion rings share one mapping (IORING_FEAT_SINGLE_MMAP)
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	m_ringSize = (sqSize > cqSize ? sqSize : cqSize);
+	m_ring = ::mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+	m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	m_sqes = ::mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+	if (m_ring == MAP_FAILED || m_sqes == MAP_FAILED) {
+		Result result = Result::CreateError("io_uring open error [%s]", ::strerror(errno));
+		Close();
+		return result;
+	}
+
+	char *ring = static_cast<char *>(m_ring);
+	m_sqEntries = params.sq_entries;
+	m_sqHead = reinterpret_cast<unsigned int *>(ring + params.sq_off.head);
+	m_sqTail = reinterpret_cast<unsigned int *>(ring + params.sq_off.tail);
+	m_sqMask = *reinterpret_cast<unsigned int *>(ring + params.sq_off.ring_mask);
+	m_sqArray = reinterpret_cast<unsigned int *>(ring + params.sq_off.array);
+	m_cqHead = reinterpret_cast<unsigned int *>(ring + params.cq_off.head);
+	m_cqTail = reinterpret_cast<unsigned int *>(ring + params.cq_off.tail);
+	m_cqMask = *reinterpret_cast<unsigned int *>(ring + params.cq_off.ring_mask);
+	m_cqes = ring + params.cq_off.cqes;
+	return Result::CreateSuccess();
+}
+
+void IoUring::Close()
+{
+	if (m_ringFd != -1) {
+		if (m_isArmed) {
+			// The kernel must not write the buffers any more when they are unmapped
+			cancel();
+
+			while (m_isArmed) {
+				unsigned int head = *m_cqHead;
+				unsigned int tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+				if (head == tail) {
+					pollfd fd;
+					fd.fd = m_ringFd;
+					fd.events = POLLIN;
+					fd.revents = 0;
+					if (::poll(&fd, 1, CANCEL_TIMEOUT) <= 0) {
+						break;
+					}
+					continue;
+				}
+				for (; head != tail; head++) {
+					const io_uring_cqe *cqe = static_cast<const io_uring_cqe *>(m_cqes) + (head & m_cqMask);
+					if (cqe->user_data == RECEIVE_REQUEST && !(cqe->flags & IORING_CQE_F_MORE)) {
+						m_isArmed = false;
+					}
+				}
+				__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+			}
+		}
+		::close(m_ringFd);
+		m_ringFd = -1;
+	}
+	if (m_ring != MAP_FAILED) {
+		::munmap(m_ring, m_ringSize);
+		m_ring = MAP_FAILED;
+	}
+	if (m_sqes != MAP_FAILED) {
+		::munmap(m_sqes, m_sqesSize);
+		m_sqes = MAP_FAILED;
+	}
+	if (m_bufferRing != MAP_FAILED) {
+		::munmap(m_bufferRing, m_bufferRingSize);
+		m_bufferRing = MAP_FAILED;
+	}
+	if (m_buffers != MAP_FAILED) {
+		::munmap(m_buffers, m_bufferSize * m_bufferCount);
+		m_buffers = static_cast<char *>(MAP_FAILED);
+	}
+	if (m_retiredBuffers != MAP_FAILED) {
+		::munmap(m_retiredBuffers, m_retiredSize * m_bufferCount);
+		m_retiredBuffers = static_cast<char *>(MAP_FAILED);
+	}
+	m_retiredCount = 0;
+	m_bufferGroup = BUFFER_GROUP;
+	m_bufferBase = 0;
+	m_socketFd = -1;
+	m_sqEntries = 0;
+	m_datagramSize = 0;
+	m_requestedSize = 0;
+	m_isArmed = false;
+	m_isCanceling = false;
+}
+
+bool IoUring::IsOpend()
+{
+	return m_ringFd != -1;
+}
+
+// Reception procedure
+// 1. Arm the multishot recvmsg (again when it ended, on a rebuilt buffer ring after a truncation)
+// 2. Take the completions waiting in the completion ring, no system call
+// 3. None: poll the ring until a completion is posted
+int IoUring::Receive(mmsghdr *msgs, iovec *iov, int *outBufferIds, size_t maxCount, bool isBlock)
+{
+	if (!IsOpend()) {
+		errno = EBADF;
+		return -1;
+	}
+
+	while (true) {
+		if (m_requestedSize > m_datagramSize && m_retiredCount == 0 && m_isArmed && !m_isCanceling) {
+			// Armed again on the small buffers while the ones before were held, end it to rebuild them
+			cancel();
+		}
+		if (!m_isArmed && m_error == 0) {
+			// Rebuilt once the completions on the buffers in place are taken
+			if (m_requestedSize > m_datagramSize && m_retiredCount == 0 && isReceiveDrained()
+			 && !setBuffers(m_requestedSize)) {
+				// Go on with the buffers in place, larger datagrams stay truncated
+				m_requestedSize = m_datagramSize;
+			}
+			if (!arm()) {
+				return -1;
+			}
+		}
+
+		size_t count = 0;
+		unsigned int head = *m_cqHead;
+		unsigned int tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail && count < maxCount && m_error == 0; head++) {
+			const io_uring_cqe *cqe = static_cast<const io_uring_cqe *>(m_cqes) + (head & m_cqMask);
+			if (cqe->user_data != RECEIVE_REQUEST) {
+				continue;
+			}
+			if (!(cqe->flags & IORING_CQE_F_MORE)) {
+				// Ended (error, no buffer left, canceled or end of connection), armed again by the next call
+				m_isArmed = false;
+				m_isCanceling = false;
+			}
+			if (cqe->res < 0) {
+				// No buffer left: armed again once the buffers are released
+				if (cqe->res != -ECANCELED && (cqe->res != -ENOBUFS || m_heldCount == m_bufferCount)) {
+					m_error = -cqe->res;
+				}
+				continue;
+			}
+
+			mmsghdr &msg = msgs[count];
+			::memset(&msg, 0, sizeof(msg));
+			msg.msg_hdr.msg_iov = &iov[count];
+			msg.msg_hdr.msg_iovlen = 1;
+			if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+				// Nothing received: the partner closed the connection
+				iov[count].iov_base = NULL;
+				iov[count].iov_len = 0;
+				outBufferIds[count] = -1;
+				count++;
+				continue;
+			}
+
+			unsigned short bufferId = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			char *buffer = m_buffers + m_bufferSize * (bufferId - m_bufferBase);
+			const io_uring_recvmsg_out *out = reinterpret_cast<const io_uring_recvmsg_out *>(buffer);
+			size_t offset = sizeof(io_uring_recvmsg_out) + m_msg.msg_namelen + m_msg.msg_controllen;
+			size_t len = (static_cast<size_t>(cqe->res) > offset ? static_cast<size_t>(cqe->res) - offset : 0);
+			iov[count].iov_base = buffer + offset;
+			iov[count].iov_len = len;
+			msg.msg_len = static_cast<unsigned int>(len);
+			if (out->flags & MSG_TRUNC) {
+				// payloadlen is the size of the datagram (MSG_TRUNC), the buffers are made to hold it
+				msg.msg_len = out->payloadlen;
+				if (out->payloadlen > m_requestedSize) {
+					m_requestedSize = out->payloadlen;
+				}
+			}
+			msg.msg_hdr.msg_flags = static_cast<int>(out->flags);
+			msg.msg_hdr.msg_control = buffer + sizeof(io_uring_recvmsg_out) + m_msg.msg_namelen;
+			msg.msg_hdr.msg_controllen = out->controllen;
+			outBufferIds[count] = bufferId;
+			m_heldCount++;
+			count++;
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		if (m_requestedSize > m_datagramSize && m_retiredCount == 0 && m_isArmed && !m_isCanceling) {
+			// A datagram was truncated, stop taking datagrams into the small buffers
+			cancel();
+		}
+
+		if (count > 0) {
+			return static_cast<int>(count);
+		}
+		if (m_error != 0) {
+			errno = m_error;
+			m_error = 0;
+			return -1;
+		}
+		if (!m_isArmed) {
+			continue;
+		}
+		if (!isBlock) {
+			return 0;
+		}
+
+		pollfd fds[2];
+		fds[0].fd = m_ringFd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = m_wakeupFd; // ignored by poll when -1
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		m_syscallCount++;
+		if (::poll(fds, 2, -1) == -1 && errno != EINTR) {
+			return -1;
+		}
+		if (fds[1].revents & POLLIN) {
+			errno = ECANCELED;
+			return -1;
+		}
+	}
+}
+
+void IoUring::Release(const int *bufferIds, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (bufferIds[i] < 0) {
+			continue;
+		}
+		unsigned int bufferId = static_cast<unsigned int>(bufferIds[i]);
+		if (bufferId < m_bufferBase || m_bufferBase + m_bufferCount <= bufferId) {
+			// A buffer of the ring before the rebuild
+			if (--m_retiredCount == 0) {
+				::munmap(m_retiredBuffers, m_retiredSize * m_bufferCount);
+				m_retiredBuffers = static_cast<char *>(MAP_FAILED);
+			}
+			continue;
+		}
+		provide(static_cast<unsigned short>(bufferId));
+		m_heldCount--;
+	}
+}
+
+// Transmission procedure
+// 1. Queue one sendmsg per datagram, linked so that they run in order
+// 2. Submit them and wait for their completions with one io_uring_enter
+// 3. Count the datagrams sent before the first failure
+int IoUring::Send(int socketFd, mmsghdr *msgs, size_t count)
+{
+	if (!IsOpend()) {
+		errno = EBADF;
+		return -1;
+	}
+	if (count > m_sqEntries) {
+		count = m_sqEntries;
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	unsigned int tail = *m_sqTail;
+	for (size_t i = 0; i < count; i++) {
+		unsigned int index = (tail + static_cast<unsigned int>(i)) & m_sqMask;
+		io_uring_sqe *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+		::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = socketFd;
+		sqe->addr = reinterpret_cast<unsigned long>(&msgs[i].msg_hdr);
+		// MSG_DONTWAIT: io_uring would retry a datagram that found the socket full with
+		// the data already consumed from the iovec and send it empty
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+		sqe->user_data = i;
+		if (i + 1 < count) {
+			// A failure cancels the following datagrams
+			sqe->flags = IOSQE_IO_LINK;
+		}
+		m_sqArray[index] = index;
+	}
+	__atomic_store_n(m_sqTail, tail + static_cast<unsigned int>(count), __ATOMIC_RELEASE);
+
+	m_syscallCount++;
+	int submitted = ioUringEnter(m_ringFd, static_cast<unsigned int>(count), static_cast<unsigned int>(count), IORING_ENTER_GETEVENTS);
+	if (submitted <= 0) {
+		// Nothing submitted, take the entries back
+		int error = (submitted == 0 ? EAGAIN : errno);
+		__atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+		errno = error;
+		return -1;
+	}
+	if (static_cast<size_t>(submitted) < count) {
+		__atomic_store_n(m_sqTail, tail + static_cast<unsigned int>(submitted), __ATOMIC_RELEASE);
+	}
+
+	// The datagrams are in flight until they complete, wait for all of them
+	size_t completed = 0;
+	size_t sent = static_cast<size_t>(submitted);
+	int error = 0;
+	while (true) {
+		unsigned int head = *m_cqHead;
+		unsigned int cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+		for (; head != cqTail; head++) {
+			const io_uring_cqe *cqe = static_cast<const io_uring_cqe *>(m_cqes) + (head & m_cqMask);
+			size_t i = static_cast<size_t>(cqe->user_data);
+			if (cqe->res < 0) {
+				if (i < sent) {
+					sent = i;
+					error = -cqe->res;
+				}
+			} else {
+				msgs[i].msg_len = static_cast<unsigned int>(cqe->res);
+			}
+			completed++;
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		if (completed >= static_cast<size_t>(submitted)) {
+			break;
+		}
+		m_syscallCount++;
+		ioUringEnter(m_ringFd, 0, static_cast<unsigned int>(submitted - completed), IORING_ENTER_GETEVENTS);
+	}
+
+	if (sent == 0) {
+		errno = error;
+		return -1;
+	}
+	return static_cast<int>(sent);
+}
+
+size_t IoUring::DatagramSize()
+{
+	// Read by other threads
+	return __atomic_load_n(&m_datagramSize, __ATOMIC_RELAXED);
+}
+
+unsigned long IoUring::SyscallCount()
+{
+	return m_syscallCount;
+}
+
+void IoUring::SetWakeupFd(int wakeupFd)
+{
+	m_wakeupFd = wakeupFd;
+}
+
+bool IoUring::arm()
+{
+	unsigned int tail = *m_sqTail;
+	unsigned int index = tail & m_sqMask;
+	io_uring_sqe *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+	::memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = m_socketFd;
+	sqe->addr = reinterpret_cast<unsigned long>(&m_msg);
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = m_bufferGroup;
+	// MSG_TRUNC: payloadlen of a truncated datagram is its size
+	sqe->msg_flags = MSG_CMSG_CLOEXEC | MSG_TRUNC;
+	sqe->user_data = RECEIVE_REQUEST;
+	m_sqArray[index] = index;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	m_syscallCount++;
+	if (ioUringEnter(m_ringFd, 1, 0, 0) == -1) {
+		return false;
+	}
+	m_isArmed = true;
+	return true;
+}
+
+bool IoUring::isReceiveDrained()
+{
+	// The completion of the cancellation may be left behind the last datagram
+	unsigned int head = *m_cqHead;
+	unsigned int tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+	while (head != tail
+		&& (static_cast<const io_uring_cqe *>(m_cqes) + (head & m_cqMask))->user_data != RECEIVE_REQUEST) {
+		head++;
+	}
+	__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	return head == tail;
+}
+
+void IoUring::cancel()
+{
+	unsigned int tail = *m_sqTail;
+	unsigned int index = tail & m_sqMask;
+	io_uring_sqe *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+	::memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = RECEIVE_REQUEST;
+	sqe->user_data = CANCEL_REQUEST;
+	m_sqArray[index] = index;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	m_syscallCount++;
+	if (ioUringEnter(m_ringFd, 1, 0, 0) != -1) {
+		m_isCanceling = true;
+	}
+}
+
+// Buffer ring rebuild procedure
+// 1. Register the new ring in the other buffer group, the one in place is kept when it fails
+// 2. Unregister the ring in place, its buffers still held by the caller stay mapped until released
+// 3. Give the new buffers to the kernel, their IDs follow the IDs of the previous ring
+bool IoUring::setBuffers(size_t datagramSize)
+{
+	// Each buffer holds io_uring_recvmsg_out, the control messages and the datagram
+	size_t bufferSize = sizeof(io_uring_recvmsg_out) + m_controlSize + datagramSize;
+	char *buffers = static_cast<char *>(::mmap(NULL, bufferSize * m_bufferCount, PROT_READ | PROT_WRITE
+			, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	void *bufferRing = ::mmap(NULL, m_bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	bool isFirst = (m_bufferRing == MAP_FAILED);
+	unsigned short group = (isFirst ? BUFFER_GROUP : m_bufferGroup ^ 1);
+	io_uring_buf_reg reg;
+	::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<unsigned long>(bufferRing);
+	reg.ring_entries = m_bufferCount;
+	reg.bgid = group;
+	if (buffers == MAP_FAILED || bufferRing == MAP_FAILED
+	 || ioUringRegister(m_ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+		int error = errno;
+		if (buffers != MAP_FAILED) {
+			::munmap(buffers, bufferSize * m_bufferCount);
+		}
+		if (bufferRing != MAP_FAILED) {
+			::munmap(bufferRing, m_bufferRingSize);
+		}
+		errno = error;
+		return false;
+	}
+
+	if (!isFirst) {
+		::memset(&reg, 0, sizeof(reg));
+		reg.bgid = m_bufferGroup;
+		ioUringRegister(m_ringFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		::munmap(m_bufferRing, m_bufferRingSize);
+		if (m_heldCount > 0) {
+			m_retiredBuffers = m_buffers;
+			m_retiredSize = m_bufferSize;
+			m_retiredCount = m_heldCount;
+		} else {
+			::munmap(m_buffers, m_bufferSize * m_bufferCount);
+		}
+		m_bufferBase = m_bufferCount - m_bufferBase;
+	}
+	m_buffers = buffers;
+	m_bufferSize = bufferSize;
+	m_bufferRing = bufferRing;
+	m_bufferGroup = group;
+	m_heldCount = 0;
+	m_bufferTail = 0;
+	for (unsigned int i = 0; i < m_bufferCount; i++) {
+		provide(static_cast<unsigned short>(m_bufferBase + i));
+	}
+	__atomic_store_n(&m_datagramSize, datagramSize, __ATOMIC_RELAXED);
+	return true;
+}
+
+void IoUring::provide(unsigned short bufferId)
+{
+	// io_uring_buf_ring::bufs is not used: its flexible array wrapper is not empty in C++
+	// and moves the entries. The ring is an array of io_uring_buf, the tail overlays the
+	// reserved field of the first entry
+	io_uring_buf *ring = static_cast<io_uring_buf *>(m_bufferRing);
+	io_uring_buf *buffer = &ring[m_bufferTail & (m_bufferCount - 1)];
+	buffer->addr = reinterpret_cast<unsigned long>(m_buffers + m_bufferSize * (bufferId - m_bufferBase));
+	buffer->len = static_cast<unsigned int>(m_bufferSize);
+	buffer->bid = bufferId;
+	m_bufferTail++;
+	__atomic_store_n(&ring[0].resv, m_bufferTail, __ATOMIC_RELEASE);
+}
+
+}
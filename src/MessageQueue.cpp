@@ -1,4 +1,5 @@
 #include "MessageQueue.h"
+#include "TimedWait.h"
 
 #include <fcntl.h>
 #include <time.h>
@@ -27,7 +28,6 @@ struct timespec timeAdd(struct timespec t1, struct timespec t2)
 	return add;
 }
 
-
 /*
 Message Queue can be mounted on a file system
 Linux In, the message queue is created in the virtual file system
@@ -62,7 +62,7 @@ Result MessageQueue::Exist(const std::string &name)
 MessageQueue::MessageQueue(const std::string &name)
 	: m_name(name)
 	, m_isOwner(false)
-	, m_messageQueue()
+	, m_messageQueue(-1)
 	, m_attribute()
 	, m_notification(NULL)
 {
@@ -72,7 +72,7 @@ MessageQueue::MessageQueue(const std::string &name)
 MessageQueue::MessageQueue(const std::string &name, long maxMessageCount, long maxMessageSize)
 	: m_name(name)
 	, m_isOwner(true)
-	, m_messageQueue()
+	, m_messageQueue(-1)
 	, m_attribute()
 	, m_notification(NULL)
 {
@@ -243,31 +243,70 @@ Result MessageQueue::TimedReceive(ByteBuffer &outMessage, unsigned long millisec
 	}
 
 	ssize_t receiveSize = 0;
-	size_t buf_len = static_cast<size_t>(len);
-	char buf[buf_len]; // C99 OK if above
-	unsigned int priority = 0;
 	if (millisec == 0) {
-		receiveSize = ::mq_receive(m_messageQueue, buf, buf_len, &priority);
+		receiveSize = receiveMessage(outMessage, NULL);
 	} else {
-		struct timespec now;
-		::clock_gettime(CLOCK_REALTIME, &now);
-		long time = millisec*MILLION;
-		long sec  = time/BILLION;
-		long nsec = time%BILLION;
-		struct timespec usertime = {sec, nsec};
-		struct timespec timeout = timeAdd(now, usertime);
-		receiveSize = ::mq_timedreceive(m_messageQueue, buf, buf_len, &priority, &timeout);
+		struct timespec timeout = deadlineAfter(millisec, CLOCK_REALTIME);
+		receiveSize = receiveMessage(outMessage, &timeout);
 	}
 
 	if (receiveSize == -1) {
 		return Result::CreateError("message queue receive error [%s]",std::strerror(errno));
 	}
 
-	outMessage = ByteBuffer(buf, static_cast<size_t>(receiveSize));
+	return Result::CreateSuccess();
+}
 
+Result MessageQueue::Receive(char *buffer, size_t bufferSize, size_t &outSize)
+{
+	return TimedReceive(buffer, bufferSize, outSize, 0UL);
+}
+
+Result MessageQueue::TimedReceive(char *buffer, size_t bufferSize, size_t &outSize, unsigned long millisec)
+{
+	outSize = 0;
+	if (m_messageQueue == -1) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	ssize_t receiveSize = 0;
+	if (millisec == 0) {
+		receiveSize = ::mq_receive(m_messageQueue, buffer, bufferSize, NULL);
+	} else {
+		struct timespec timeout = deadlineAfter(millisec, CLOCK_REALTIME);
+		receiveSize = ::mq_timedreceive(m_messageQueue, buffer, bufferSize, NULL, &timeout);
+	}
+
+	if (receiveSize == -1) {
+		return Result::CreateError("message queue receive error [%s]",std::strerror(errno));
+	}
+
+	outSize = static_cast<size_t>(receiveSize);
 	return Result::CreateSuccess();
 }
 
+// The kernel needs a buffer of the maximum size, sizing the ByteBuffer to it would zero-fill
+// the part after the previous message every time: receive on the stack and copy only the message
+ssize_t MessageQueue::receiveMessage(ByteBuffer &outMessage, const struct timespec *timeout)
+{
+	size_t buf_len = static_cast<size_t>(m_attribute.mq_msgsize);
+	char buf[buf_len]; // C99 OK if above
+	ssize_t receiveSize = 0;
+	if (timeout == NULL) {
+		receiveSize = ::mq_receive(m_messageQueue, buf, buf_len, NULL);
+	} else {
+		receiveSize = ::mq_timedreceive(m_messageQueue, buf, buf_len, NULL, timeout);
+	}
+
+	if (receiveSize == -1) {
+		outMessage.Clear();
+		return -1;
+	}
+
+	outMessage.Assign(buf, static_cast<size_t>(receiveSize));
+	return receiveSize;
+}
+
 Result MessageQueue::Receive(std::vector<ByteBuffer> &outMessages)
 {
 	outMessages.clear();
@@ -304,6 +343,83 @@ Result MessageQueue::Receive(std::vector<ByteBuffer> &outMessages)
 	return result;
 }
 
+Result MessageQueue::SendBatch(const std::vector<ByteBuffer> &messages, unsigned long millisec, size_t &outCount)
+{
+	outCount = 0;
+	if (m_messageQueue == -1) {
+		return Result::CreateError("message queue send error [%s]","queue not found");
+	}
+
+	// One deadline for the whole batch
+	struct timespec timeout = {0,0};
+	if (millisec != 0) {
+		timeout = deadlineAfter(millisec, CLOCK_REALTIME);
+	}
+	for (size_t i = 0; i < messages.size(); i++) {
+		const std::string &data = messages[i].Data();
+		int ret = 0;
+		if (millisec == 0) {
+			ret = ::mq_send(m_messageQueue, data.data(), data.size(), PRIORITY);
+		} else {
+			ret = ::mq_timedsend(m_messageQueue, data.data(), data.size(), PRIORITY, &timeout);
+		}
+		if (ret == -1) {
+			return Result::CreateError("message queue send error [%s:%lu sent]",std::strerror(errno), static_cast<unsigned long>(outCount));
+		}
+		outCount++;
+	}
+
+	return Result::CreateSuccess();
+}
+
+Result MessageQueue::ReceiveBatch(std::vector<ByteBuffer> &ioMessages, size_t maxCount, unsigned long millisec, size_t &outCount)
+{
+	outCount = 0;
+	if (m_messageQueue == -1) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	long len = MaxMessageSize();
+	if (len < 0) {
+		return Result::CreateError("message queue receive error [%s:%ld]","invalid message size", len);
+	}
+
+	if (maxCount == 0) {
+		return Result::CreateSuccess();
+	}
+	if (ioMessages.size() < maxCount) {
+		ioMessages.resize(maxCount);
+	}
+
+	// Each message is received into the ByteBuffer kept by the caller
+	ssize_t receiveSize = 0;
+	if (millisec == 0) {
+		receiveSize = receiveMessage(ioMessages[0], NULL);
+	} else {
+		struct timespec timeout = deadlineAfter(millisec, CLOCK_REALTIME);
+		receiveSize = receiveMessage(ioMessages[0], &timeout);
+	}
+	if (receiveSize == -1) {
+		return Result::CreateError("message queue receive error [%s]",std::strerror(errno));
+	}
+	outCount++;
+
+	// Take the messages already queued without waiting
+	while (outCount < maxCount) {
+		struct timespec timeout = {0,0};
+		receiveSize = receiveMessage(ioMessages[outCount], &timeout);
+		if (receiveSize == -1) {
+			if (errno == ETIMEDOUT) {
+				break;
+			}
+			return Result::CreateError("message queue receive error [%s:%lu received]",std::strerror(errno), static_cast<unsigned long>(outCount));
+		}
+		outCount++;
+	}
+
+	return Result::CreateSuccess();
+}
+
 static void signalNotifyFunction(sigval sv)
 {
 	MessageQueue *mq = static_cast<MessageQueue *>(sv.sival_ptr);
@@ -341,4 +457,10 @@ INotifyMessage *MessageQueue::NotifyMessage()
 	return m_notification;
 }
 
+int MessageQueue::Descriptor()
+{
+	// Linux: mqd_t is a file descriptor
+	return static_cast<int>(m_messageQueue);
+}
+
 }
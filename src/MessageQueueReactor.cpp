@@ -0,0 +1,184 @@
+#include "MessageQueueReactor.h"
+#include "MutexLock.h"
+
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+namespace LightIPC {
+
+MessageQueueReactor::MessageQueueReactor()
+	: m_epollFd(::epoll_create1(EPOLL_CLOEXEC))
+	, m_wakeupFd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+	, m_queues()
+	, m_dispatchingFd(-1)
+	, m_mutex()
+	, m_thread()
+	, m_threadId(0)
+	, m_isStarted(false)
+	, m_isActive(false)
+{
+	if (m_epollFd == -1 || m_wakeupFd == -1) {
+		std::fprintf(stderr, "message queue reactor creation error [%s]\n", std::strerror(errno));
+		return;
+	}
+	epoll_event event;
+	::memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = m_wakeupFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupFd, &event);
+}
+
+MessageQueueReactor::~MessageQueueReactor()
+{
+	Stop();
+	if (m_epollFd != -1) {
+		::close(m_epollFd);
+	}
+	if (m_wakeupFd != -1) {
+		::close(m_wakeupFd);
+	}
+}
+
+Result MessageQueueReactor::Add(MessageQueue *mq, INotifyMessage *notification)
+{
+	if (m_epollFd == -1) {
+		return Result::CreateError("message queue reactor error [%s]", "not opened");
+	}
+	if (mq == NULL || notification == NULL) {
+		return Result::CreateError("message queue reactor error [%s]", "no queue or handler");
+	}
+	int fd = mq->Descriptor();
+	if (fd == -1) {
+		return Result::CreateError("message queue reactor error [%s]", "queue not found");
+	}
+
+	MutexLock lock(&m_mutex);
+	if (m_queues.find(fd) != m_queues.end()) {
+		return Result::CreateError("message queue reactor error [%s: %s]", mq->Name().c_str(), "already watched");
+	}
+	// Level triggered: reported again while messages are left
+	epoll_event event;
+	::memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		return Result::CreateError("message queue reactor error [%s: %s]", mq->Name().c_str(), std::strerror(errno));
+	}
+	Entry entry;
+	entry.mq = mq;
+	entry.notification = notification;
+	m_queues[fd] = entry;
+	return Result::CreateSuccess();
+}
+
+Result MessageQueueReactor::Remove(MessageQueue *mq)
+{
+	if (mq == NULL) {
+		return Result::CreateError("message queue reactor error [%s]", "no queue");
+	}
+	int fd = mq->Descriptor();
+
+	MutexLock lock(&m_mutex);
+	std::map<int, Entry>::iterator it = m_queues.find(fd);
+	if (it == m_queues.end() || it->second.mq != mq) {
+		return Result::CreateError("message queue reactor error [%s: %s]", mq->Name().c_str(), "not watched");
+	}
+	m_queues.erase(it);
+	::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, NULL);
+
+	// The handler in progress may still use the queue (a handler removing itself does not wait)
+	if (m_isStarted && Thread::CurrentThreadId() != m_threadId) {
+		while (m_dispatchingFd == fd) {
+			lock.Wait();
+		}
+	}
+	return Result::CreateSuccess();
+}
+
+void MessageQueueReactor::Start()
+{
+	if (m_isStarted || m_epollFd == -1) {
+		return;
+	}
+	m_isStarted = true;
+	m_isActive = true;
+	m_thread.SetRunner(this, NULL);
+	m_thread.SetName("mqReactor");
+	m_thread.Start();
+}
+
+void MessageQueueReactor::Stop()
+{
+	// Stop() is also called by the destructor, the thread can be joined only once
+	if (!m_isStarted) {
+		return;
+	}
+	// Wake up the dispatcher thread blocked in epoll_wait()
+	m_isActive = false;
+	uint64_t value = 1;
+	if (::write(m_wakeupFd, &value, sizeof(value)) == -1) {
+		// Already signaled as far as the counter goes
+	}
+	m_thread.Join();
+	if (::read(m_wakeupFd, &value, sizeof(value)) == -1) {
+		// Not signaled
+	}
+	m_isStarted = false;
+}
+
+void MessageQueueReactor::Run()
+{
+	{
+		MutexLock lock(&m_mutex);
+		m_threadId = Thread::CurrentThreadId();
+	}
+
+	epoll_event events[MAX_EPOLL_EVENTS];
+	while (m_isActive) {
+		int count = ::epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, -1);
+		if (count == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::fprintf(stderr, "message queue reactor error [%s]\n", std::strerror(errno));
+			break;
+		}
+		for (int i = 0; i < count && m_isActive; i++) {
+			if (events[i].data.fd == m_wakeupFd) {
+				// Stop() cleared m_isActive
+				continue;
+			}
+			dispatch(events[i].data.fd);
+		}
+	}
+	m_isActive = false;
+}
+
+void MessageQueueReactor::dispatch(int fd)
+{
+	Entry entry;
+	{
+		MutexLock lock(&m_mutex);
+		// Removed after the event was taken
+		std::map<int, Entry>::iterator it = m_queues.find(fd);
+		if (it == m_queues.end()) {
+			return;
+		}
+		entry = it->second;
+		m_dispatchingFd = fd;
+	}
+
+	entry.notification->FirstMessageArrived(*entry.mq);
+
+	MutexLock lock(&m_mutex);
+	m_dispatchingFd = -1;
+	lock.Broadcast();
+}
+
+}
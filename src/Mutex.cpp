@@ -1,6 +1,7 @@
 #include "Mutex.h"
 
 #include <pthread.h>
+#include <cerrno>
 #include <cstdio>
 #include <cassert>
 #include "Thread.h"
@@ -10,7 +11,13 @@ namespace LightIPC {
 Mutex::Mutex()
 {
 	::pthread_mutex_init(&m_mutex, NULL);
-	::pthread_cond_init(&m_condition, NULL);
+
+	// Deadlines are not affected by changes of the system time
+	::pthread_condattr_t attr;
+	::pthread_condattr_init(&attr);
+	::pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	::pthread_cond_init(&m_condition, &attr);
+	::pthread_condattr_destroy(&attr);
 }
 
 Mutex::~Mutex()
@@ -34,6 +41,11 @@ void Mutex::ConditionWait()
 	::pthread_cond_wait(&m_condition, &m_mutex);
 }
 
+bool Mutex::ConditionTimedWait(const timespec &deadline)
+{
+	return ::pthread_cond_timedwait(&m_condition, &m_mutex, &deadline) != ETIMEDOUT;
+}
+
 void Mutex::ConditionSignal()
 {
 	::pthread_cond_signal(&m_condition);
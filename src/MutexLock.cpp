@@ -31,6 +31,11 @@ void MutexLock::Wait()
 	m_mutex->ConditionWait();
 }
 
+bool MutexLock::TimedWait(const timespec &deadline)
+{
+	return m_mutex->ConditionTimedWait(deadline);
+}
+
 void MutexLock::Signal()
 {
 	m_mutex->ConditionSignal();
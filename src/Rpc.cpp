@@ -0,0 +1,175 @@
+#include "Rpc.h"
+
+#include <time.h>
+
+#include <cstring>
+#include <string>
+
+namespace LightIPC {
+
+// Nanoseconds of CLOCK_MONOTONIC
+static unsigned long long monotonicNsec()
+{
+	timespec now;
+	::clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<unsigned long long>(now.tv_sec) * 1000000000ULL + static_cast<unsigned long long>(now.tv_nsec);
+}
+
+RpcDispatcher::RpcDispatcher()
+	: m_methods()
+{
+}
+
+RpcDispatcher::~RpcDispatcher()
+{
+}
+
+Result RpcDispatcher::Register(unsigned int methodId, IRpcHandler *handler)
+{
+	if (methodId > MAX_METHOD_ID) {
+		return Result::CreateError("rpc register error [method %u: %s]", methodId, "method ID out of range");
+	}
+	if (handler == NULL) {
+		return Result::CreateError("rpc register error [method %u: %s]", methodId, "no handler");
+	}
+	if (methodId >= m_methods.size()) {
+		Method empty;
+		::memset(&empty, 0, sizeof(empty));
+		m_methods.resize(methodId + 1, empty);
+	}
+	if (m_methods[methodId].handler != NULL) {
+		return Result::CreateError("rpc register error [method %u: %s]", methodId, "already registered");
+	}
+	m_methods[methodId].handler = handler;
+	return Result::CreateSuccess();
+}
+
+Result RpcDispatcher::Stats(unsigned int methodId, RpcMethodStats &outStats)
+{
+	if (methodId >= m_methods.size() || m_methods[methodId].handler == NULL) {
+		return Result::CreateError("rpc stats error [method %u: %s]", methodId, "not registered");
+	}
+	RpcMethodStats &stats = m_methods[methodId].stats;
+	outStats.calls = __atomic_load_n(&stats.calls, __ATOMIC_RELAXED);
+	outStats.errors = __atomic_load_n(&stats.errors, __ATOMIC_RELAXED);
+	outStats.totalNsec = __atomic_load_n(&stats.totalNsec, __ATOMIC_RELAXED);
+	outStats.maxNsec = __atomic_load_n(&stats.maxNsec, __ATOMIC_RELAXED);
+	return Result::CreateSuccess();
+}
+
+void RpcDispatcher::ResetStats()
+{
+	for (size_t i = 0; i < m_methods.size(); i++) {
+		RpcMethodStats &stats = m_methods[i].stats;
+		__atomic_store_n(&stats.calls, 0UL, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats.errors, 0UL, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats.totalNsec, 0ULL, __ATOMIC_RELAXED);
+		__atomic_store_n(&stats.maxNsec, 0ULL, __ATOMIC_RELAXED);
+	}
+}
+
+void RpcDispatcher::Received(ByteBuffer &request, ByteBuffer &response)
+{
+	response.Clear();
+	unsigned int methodId = 0;
+	if (request.Size() < sizeof(methodId)) {
+		response.Append(static_cast<int>(RPC_STATUS_INVALID_ARGUMENTS));
+		return;
+	}
+	request.SetPosition(0);
+	request.Value(methodId);
+	if (methodId >= m_methods.size() || m_methods[methodId].handler == NULL) {
+		response.Append(static_cast<int>(RPC_STATUS_UNKNOWN_METHOD));
+		return;
+	}
+
+	// The handler writes into its own buffer, it may Clear() it freely
+	Method &method = m_methods[methodId];
+	ByteBuffer result;
+	unsigned long long start = monotonicNsec();
+	RpcStatus status = method.handler->Call(request, result);
+	unsigned long long elapsed = monotonicNsec() - start;
+
+	int value = static_cast<int>(status);
+	const std::string &data = result.Data();
+	char *buffer = response.Resize(sizeof(value) + data.size());
+	::memcpy(buffer, &value, sizeof(value));
+	if (!data.empty()) {
+		::memcpy(buffer + sizeof(value), data.data(), data.size());
+	}
+
+	RpcMethodStats &stats = method.stats;
+	__atomic_add_fetch(&stats.calls, 1UL, __ATOMIC_RELAXED);
+	if (status != RPC_STATUS_OK) {
+		__atomic_add_fetch(&stats.errors, 1UL, __ATOMIC_RELAXED);
+	}
+	__atomic_add_fetch(&stats.totalNsec, elapsed, __ATOMIC_RELAXED);
+	unsigned long long max = __atomic_load_n(&stats.maxNsec, __ATOMIC_RELAXED);
+	while (elapsed > max
+		&& !__atomic_compare_exchange_n(&stats.maxNsec, &max, elapsed, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+bool RpcValue(ByteBuffer &buffer, std::string &out)
+{
+	int size = 0;
+	if (!RpcValue(buffer, size) || size < 0 || buffer.Size() - buffer.Position() < static_cast<size_t>(size)) {
+		return false;
+	}
+	unsigned int position = buffer.Position();
+	out.assign(buffer.Data().data() + position, size);
+	buffer.SetPosition(position + size);
+	return true;
+}
+
+bool RpcValue(ByteBuffer &buffer, ByteBuffer &out)
+{
+	int size = 0;
+	if (!RpcValue(buffer, size) || size < 0 || buffer.Size() - buffer.Position() < static_cast<size_t>(size)) {
+		return false;
+	}
+	unsigned int position = buffer.Position();
+	out.Assign(buffer.Data().data() + position, size);
+	buffer.SetPosition(position + size);
+	return true;
+}
+
+bool RpcValue(ByteBuffer &buffer, size_t &out)
+{
+	int value = 0;
+	if (!RpcValue(buffer, value)) {
+		return false;
+	}
+	out = value;
+	return true;
+}
+
+Result RpcResponseStatus(unsigned int methodId, ByteBuffer &response)
+{
+	int status = 0;
+	if (response.Size() < sizeof(status)) {
+		return Result::CreateError("rpc error [method %u: %s]", methodId, "invalid response");
+	}
+	response.SetPosition(0);
+	response.Value(status);
+	switch (status) {
+	case RPC_STATUS_OK:
+		return Result::CreateSuccess();
+	case RPC_STATUS_UNKNOWN_METHOD:
+		return Result::CreateError("rpc error [method %u: %s]", methodId, "unknown method");
+	case RPC_STATUS_INVALID_ARGUMENTS:
+		return Result::CreateError("rpc error [method %u: %s]", methodId, "invalid arguments");
+	case RPC_STATUS_FAILED:
+		{
+			std::string message;
+			if (!RpcValue(response, message)) {
+				message = "failed";
+			}
+			return Result::CreateError("rpc error [method %u: %s]", methodId, message.c_str());
+		}
+	default:
+		return Result::CreateError("rpc error [method %u: status %d]", methodId, status);
+	}
+}
+
+}
@@ -91,6 +91,15 @@ SharedMemory::SharedMemory(const std::string &name, size_t size, bool isOwner)
 		m_memoryMap = ::mmap(NULL, m_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
 		// close shared memory file discriptor
 		::close(fd);
+
+		if (m_memoryMap == MAP_FAILED) {
+			std::fprintf(stderr, "shared memory map error [%s]\n", std::strerror(errno));
+			m_memoryMap = NULL;
+			if (m_isOwner) {
+				::shm_unlink(named);
+			}
+			return;
+		}
 	}
 
 	// create/open named semaphore
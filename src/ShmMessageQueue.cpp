@@ -0,0 +1,331 @@
+#include "ShmMessageQueue.h"
+#include "TimedWait.h"
+
+#include <climits>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+namespace LightIPC {
+
+// "SHMQ"
+static const unsigned int QUEUE_MAGIC = 0x514d4853;
+
+// Header at the top of the shared memory (initialized by the owner).
+// The producer and the consumer words are on their own cache lines
+struct ShmMessageQueue::Header
+{
+	/// Set last by the owner when the geometry is written
+	unsigned int magic;
+	unsigned int maxCount;
+	unsigned int maxSize;
+	unsigned int slotSize;
+	char geometryPad[64 - 4 * sizeof(unsigned int)];
+
+	/// Written by the producer: position of the next message (0 to 2 * maxCount - 1)
+	unsigned int tail;
+	/// Set by the consumer while it sleeps on tail
+	unsigned int isConsumerWaiting;
+	char tailPad[64 - 2 * sizeof(unsigned int)];
+
+	/// Written by the consumer: position of the oldest message (0 to 2 * maxCount - 1)
+	unsigned int head;
+	/// Set by the producer while it sleeps on head
+	unsigned int isProducerWaiting;
+	char headPad[64 - 2 * sizeof(unsigned int)];
+};
+
+// Sleep while *word is value, the other side wakes it up when *isWaiting is set.
+// Returns 0, or ETIMEDOUT when the deadline (NULL: none) has passed
+static int waitWord(unsigned int *word, unsigned int *isWaiting, unsigned int value, const timespec *deadline)
+{
+	// The flag is set before the word is checked again (and by the futex),
+	// the other side updates the word before it checks the flag
+	__atomic_store_n(isWaiting, 1U, __ATOMIC_SEQ_CST);
+	int error = 0;
+	if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == value) {
+		error = futexWait(word, value, deadline);
+	}
+	__atomic_store_n(isWaiting, 0U, __ATOMIC_RELAXED);
+	return error;
+}
+
+// Wake up the other side when it sleeps on word (after the word is updated)
+static void wakeWord(unsigned int *word, unsigned int *isWaiting)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(isWaiting, __ATOMIC_RELAXED)) {
+		futexWake(word, 1);
+	}
+}
+
+Result ShmMessageQueue::Exist(const std::string &name)
+{
+	return SharedMemory::Exist(name);
+}
+
+ShmMessageQueue::ShmMessageQueue(const std::string &name)
+	: m_name(name)
+	, m_isOwner(false)
+	, m_memory(NULL)
+	, m_header(NULL)
+	, m_slots(NULL)
+	, m_cachedHead(0)
+	, m_cachedTail(0)
+{
+	Init(0, 0);
+}
+
+ShmMessageQueue::ShmMessageQueue(const std::string &name, long maxMessageCount, long maxMessageSize)
+	: m_name(name)
+	, m_isOwner(true)
+	, m_memory(NULL)
+	, m_header(NULL)
+	, m_slots(NULL)
+	, m_cachedHead(0)
+	, m_cachedTail(0)
+{
+	Init(maxMessageCount > 0 ? maxMessageCount : 10, maxMessageSize > 0 ? maxMessageSize : 8192);
+}
+
+void ShmMessageQueue::Init(long maxMessageCount, long maxMessageSize)
+{
+	unsigned int maxCount = 0;
+	unsigned int maxSize = 0;
+	if (m_isOwner) {
+		// The positions run up to twice the count
+		if (maxMessageCount > (1L << 30) || maxMessageSize > INT_MAX - 8) {
+			std::fprintf(stderr, "message queue creation error [%s]\n", "too large");
+			return;
+		}
+		maxCount = static_cast<unsigned int>(maxMessageCount);
+		maxSize = static_cast<unsigned int>(maxMessageSize);
+	} else {
+		// Read the geometry written by the owner
+		SharedMemory header(m_name, sizeof(Header), false);
+		Header *data = header.Data<Header>();
+		if (data == NULL) {
+			return;
+		}
+		if (__atomic_load_n(&data->magic, __ATOMIC_ACQUIRE) != QUEUE_MAGIC) {
+			std::fprintf(stderr, "message queue open error [%s is not a queue]\n", m_name.c_str());
+			return;
+		}
+		maxCount = data->maxCount;
+		maxSize = data->maxSize;
+	}
+
+	// Slot: length + data, 8 byte aligned
+	size_t slotSize = (sizeof(unsigned int) + maxSize + 7) & ~static_cast<size_t>(7);
+	m_memory = new SharedMemory(m_name, sizeof(Header) + slotSize * maxCount, m_isOwner);
+	Header *header = m_memory->Data<Header>();
+	if (header == NULL) {
+		return;
+	}
+
+	if (m_isOwner) {
+		header->maxCount = maxCount;
+		header->maxSize = maxSize;
+		header->slotSize = static_cast<unsigned int>(slotSize);
+		header->tail = 0;
+		header->isConsumerWaiting = 0;
+		header->head = 0;
+		header->isProducerWaiting = 0;
+		__atomic_store_n(&header->magic, QUEUE_MAGIC, __ATOMIC_RELEASE);
+	}
+	m_header = header;
+	m_slots = m_memory->Data<char>() + sizeof(Header);
+	m_cachedHead = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+	m_cachedTail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+}
+
+ShmMessageQueue::~ShmMessageQueue()
+{
+	delete m_memory;
+}
+
+const std::string &ShmMessageQueue::Name() const
+{
+	return m_name;
+}
+
+long ShmMessageQueue::MaxMessageCount()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	return static_cast<long>(m_header->maxCount);
+}
+
+long ShmMessageQueue::MaxMessageSize()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	return static_cast<long>(m_header->maxSize);
+}
+
+long ShmMessageQueue::CurrentMessageCount()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	unsigned int head = __atomic_load_n(&m_header->head, __ATOMIC_ACQUIRE);
+	unsigned int tail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+	return static_cast<long>(used(tail, head));
+}
+
+void ShmMessageQueue::Clear()
+{
+	if (m_header == NULL) {
+		return;
+	}
+
+	m_cachedTail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&m_header->head, m_cachedTail, __ATOMIC_RELEASE);
+	wakeWord(&m_header->head, &m_header->isProducerWaiting);
+}
+
+// The positions run over twice the slots so that a full queue (count slots apart)
+// is told apart from an empty one (same position)
+char *ShmMessageQueue::slot(unsigned int position)
+{
+	unsigned int index = (position >= m_header->maxCount ? position - m_header->maxCount : position);
+	return m_slots + static_cast<size_t>(index) * m_header->slotSize;
+}
+
+unsigned int ShmMessageQueue::next(unsigned int position)
+{
+	position++;
+	return (position == 2 * m_header->maxCount ? 0 : position);
+}
+
+unsigned int ShmMessageQueue::used(unsigned int tail, unsigned int head)
+{
+	return (tail >= head ? tail - head : tail + 2 * m_header->maxCount - head);
+}
+
+Result ShmMessageQueue::Send(const ByteBuffer &message)
+{
+	return TimedSend(message, 0UL);
+}
+
+Result ShmMessageQueue::TimedSend(const ByteBuffer &message, unsigned long millisec)
+{
+	if (m_header == NULL) {
+		return Result::CreateError("message queue send error [%s]","queue not found");
+	}
+
+	size_t size = message.Size();
+	if (size > m_header->maxSize) {
+		return Result::CreateError("message queue send error [%s]",std::strerror(EMSGSIZE));
+	}
+
+	// Only this side writes the tail
+	unsigned int tail = __atomic_load_n(&m_header->tail, __ATOMIC_RELAXED);
+	if (used(tail, m_cachedHead) >= m_header->maxCount) {
+		timespec deadline;
+		if (millisec > 0) {
+			deadline = deadlineAfter(millisec);
+		}
+		m_cachedHead = __atomic_load_n(&m_header->head, __ATOMIC_ACQUIRE);
+		while (used(tail, m_cachedHead) >= m_header->maxCount) {
+			// Full: sleep until the consumer moves the head
+			int error = waitWord(&m_header->head, &m_header->isProducerWaiting, m_cachedHead, (millisec > 0 ? &deadline : NULL));
+			m_cachedHead = __atomic_load_n(&m_header->head, __ATOMIC_ACQUIRE);
+			if (error != 0 && used(tail, m_cachedHead) >= m_header->maxCount) {
+				return Result::CreateError("message queue send error [%s]",std::strerror(error));
+			}
+		}
+	}
+
+	char *data = slot(tail);
+	unsigned int length = static_cast<unsigned int>(size);
+	::memcpy(data, &length, sizeof(length));
+	if (size > 0) {
+		::memcpy(data + sizeof(length), message.Data().data(), size);
+	}
+	__atomic_store_n(&m_header->tail, next(tail), __ATOMIC_RELEASE);
+	wakeWord(&m_header->tail, &m_header->isConsumerWaiting);
+
+	return Result::CreateSuccess();
+}
+
+Result ShmMessageQueue::Receive(ByteBuffer &outMessage)
+{
+	return TimedReceive(outMessage, 0UL);
+}
+
+Result ShmMessageQueue::TimedReceive(ByteBuffer &outMessage, unsigned long millisec)
+{
+	if (m_header == NULL) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	// Only this side writes the head
+	unsigned int head = __atomic_load_n(&m_header->head, __ATOMIC_RELAXED);
+	if (head == m_cachedTail) {
+		timespec deadline;
+		if (millisec > 0) {
+			deadline = deadlineAfter(millisec);
+		}
+		m_cachedTail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+		while (head == m_cachedTail) {
+			// Empty: sleep until the producer moves the tail
+			int error = waitWord(&m_header->tail, &m_header->isConsumerWaiting, m_cachedTail, (millisec > 0 ? &deadline : NULL));
+			m_cachedTail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+			if (error != 0 && head == m_cachedTail) {
+				return Result::CreateError("message queue receive error [%s]",std::strerror(error));
+			}
+		}
+	}
+
+	const char *data = slot(head);
+	unsigned int length = 0;
+	::memcpy(&length, data, sizeof(length));
+	if (length > m_header->maxSize) {
+		return Result::CreateError("message queue receive error [%s:%u]","invalid message size", length);
+	}
+	outMessage.Assign(data + sizeof(length), length);
+	__atomic_store_n(&m_header->head, next(head), __ATOMIC_RELEASE);
+	wakeWord(&m_header->head, &m_header->isProducerWaiting);
+
+	return Result::CreateSuccess();
+}
+
+Result ShmMessageQueue::Receive(std::vector<ByteBuffer> &outMessages)
+{
+	outMessages.clear();
+	if (m_header == NULL) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	unsigned int head = __atomic_load_n(&m_header->head, __ATOMIC_RELAXED);
+	m_cachedTail = __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE);
+	if (head == m_cachedTail) {
+		return Result::CreateSuccess();
+	}
+
+	outMessages.reserve(used(m_cachedTail, head));
+	for (; head != m_cachedTail; head = next(head)) {
+		const char *data = slot(head);
+		unsigned int length = 0;
+		::memcpy(&length, data, sizeof(length));
+		if (length > m_header->maxSize) {
+			outMessages.clear();
+			return Result::CreateError("message queue receive error [%s:%u]","invalid message size", length);
+		}
+		outMessages.push_back(ByteBuffer(data + sizeof(length), length));
+	}
+
+	// Release all the slots at once
+	__atomic_store_n(&m_header->head, head, __ATOMIC_RELEASE);
+	wakeWord(&m_header->head, &m_header->isProducerWaiting);
+
+	return Result::CreateSuccess();
+}
+
+}
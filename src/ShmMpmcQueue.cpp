@@ -0,0 +1,380 @@
+#include "ShmMpmcQueue.h"
+#include "TimedWait.h"
+
+#include <climits>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+namespace LightIPC {
+
+// "MPMC"
+static const unsigned int QUEUE_MAGIC = 0x434d504d;
+
+// The slots start on their own cache line after the header and are aligned on it
+static const size_t CACHE_LINE = 64;
+
+// Header at the top of the shared memory (initialized by the owner).
+// The words written by the senders, by the receivers and by the sleepers are on their own cache lines
+struct ShmMpmcQueue::Header
+{
+	/// Set last by the owner when the geometry is written
+	unsigned int magic;
+	unsigned int maxCount;
+	unsigned int maxSize;
+	unsigned int slotSize;
+	char geometryPad[CACHE_LINE - 4 * sizeof(unsigned int)];
+
+	/// Next position claimed by a sender
+	unsigned long long enqueuePosition;
+	char enqueuePad[CACHE_LINE - sizeof(unsigned long long)];
+
+	/// Next position claimed by a receiver
+	unsigned long long dequeuePosition;
+	char dequeuePad[CACHE_LINE - sizeof(unsigned long long)];
+
+	/// Futex word changed when a message is put while receivers sleep
+	unsigned int notEmptyEvent;
+	/// Number of receivers sleeping (or about to) on notEmptyEvent
+	unsigned int waitingReceivers;
+	char notEmptyPad[CACHE_LINE - 2 * sizeof(unsigned int)];
+
+	/// Futex word changed when a slot is freed while senders sleep
+	unsigned int notFullEvent;
+	/// Number of senders sleeping (or about to) on notFullEvent
+	unsigned int waitingSenders;
+	char notFullPad[CACHE_LINE - 2 * sizeof(unsigned int)];
+};
+
+// Slot of a message, followed by the data
+struct ShmMpmcQueue::Slot
+{
+	/// position: free for the sender of position,
+	/// position + 1: filled for the receiver of position,
+	/// position + maxCount: freed by the receiver of position
+	unsigned long long sequence;
+	unsigned int length;
+	unsigned int reserved;
+};
+
+// Wake up count sleepers of event when there are any (after the slots are updated)
+static void signalEvent(unsigned int *event, unsigned int *waiting, int count)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_RELAXED) > 0) {
+		__atomic_add_fetch(event, 1U, __ATOMIC_SEQ_CST);
+		futexWake(event, count);
+	}
+}
+
+Result ShmMpmcQueue::Exist(const std::string &name)
+{
+	return SharedMemory::Exist(name);
+}
+
+ShmMpmcQueue::ShmMpmcQueue(const std::string &name)
+	: m_name(name)
+	, m_isOwner(false)
+	, m_memory(NULL)
+	, m_header(NULL)
+	, m_slots(NULL)
+{
+	Init(0, 0);
+}
+
+ShmMpmcQueue::ShmMpmcQueue(const std::string &name, long maxMessageCount, long maxMessageSize)
+	: m_name(name)
+	, m_isOwner(true)
+	, m_memory(NULL)
+	, m_header(NULL)
+	, m_slots(NULL)
+{
+	Init(maxMessageCount > 0 ? maxMessageCount : 10, maxMessageSize > 0 ? maxMessageSize : 8192);
+}
+
+void ShmMpmcQueue::Init(long maxMessageCount, long maxMessageSize)
+{
+	unsigned int maxCount = 0;
+	unsigned int maxSize = 0;
+	if (m_isOwner) {
+		if (maxMessageCount > INT_MAX || maxMessageSize > INT_MAX - static_cast<long>(CACHE_LINE)) {
+			std::fprintf(stderr, "message queue creation error [%s]\n", "too large");
+			return;
+		}
+		maxCount = static_cast<unsigned int>(maxMessageCount);
+		maxSize = static_cast<unsigned int>(maxMessageSize);
+	} else {
+		// Read the geometry written by the owner
+		SharedMemory header(m_name, sizeof(Header), false);
+		Header *data = header.Data<Header>();
+		if (data == NULL) {
+			return;
+		}
+		if (__atomic_load_n(&data->magic, __ATOMIC_ACQUIRE) != QUEUE_MAGIC) {
+			std::fprintf(stderr, "message queue open error [%s is not a queue]\n", m_name.c_str());
+			return;
+		}
+		maxCount = data->maxCount;
+		maxSize = data->maxSize;
+	}
+
+	// Slot: sequence + length + data, cache line aligned so that neighbours do not share a line
+	size_t slotSize = (sizeof(Slot) + maxSize + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+	m_memory = new SharedMemory(m_name, sizeof(Header) + slotSize * maxCount, m_isOwner);
+	Header *header = m_memory->Data<Header>();
+	if (header == NULL) {
+		return;
+	}
+	m_slots = m_memory->Data<char>() + sizeof(Header);
+
+	if (m_isOwner) {
+		header->maxCount = maxCount;
+		header->maxSize = maxSize;
+		header->slotSize = static_cast<unsigned int>(slotSize);
+		header->enqueuePosition = 0;
+		header->dequeuePosition = 0;
+		header->notEmptyEvent = 0;
+		header->waitingReceivers = 0;
+		header->notFullEvent = 0;
+		header->waitingSenders = 0;
+		for (unsigned int i = 0; i < maxCount; i++) {
+			reinterpret_cast<Slot *>(m_slots + static_cast<size_t>(i) * slotSize)->sequence = i;
+		}
+		__atomic_store_n(&header->magic, QUEUE_MAGIC, __ATOMIC_RELEASE);
+	}
+	m_header = header;
+}
+
+ShmMpmcQueue::~ShmMpmcQueue()
+{
+	delete m_memory;
+}
+
+const std::string &ShmMpmcQueue::Name() const
+{
+	return m_name;
+}
+
+long ShmMpmcQueue::MaxMessageCount()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	return static_cast<long>(m_header->maxCount);
+}
+
+long ShmMpmcQueue::MaxMessageSize()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	return static_cast<long>(m_header->maxSize);
+}
+
+long ShmMpmcQueue::CurrentMessageCount()
+{
+	if (m_header == NULL) {
+		return -1;
+	}
+
+	// The receivers never pass the senders, read them in that order
+	unsigned long long dequeuePosition = __atomic_load_n(&m_header->dequeuePosition, __ATOMIC_ACQUIRE);
+	unsigned long long enqueuePosition = __atomic_load_n(&m_header->enqueuePosition, __ATOMIC_ACQUIRE);
+	return static_cast<long>(enqueuePosition - dequeuePosition);
+}
+
+void ShmMpmcQueue::Clear()
+{
+	if (m_header == NULL) {
+		return;
+	}
+
+	ByteBuffer message;
+	int count = 0;
+	for (unsigned int i = 0; i < m_header->maxCount && tryDequeue(message); i++) {
+		count++;
+	}
+	if (count > 0) {
+		signalEvent(&m_header->notFullEvent, &m_header->waitingSenders, count);
+	}
+}
+
+ShmMpmcQueue::Slot *ShmMpmcQueue::slot(unsigned long long position)
+{
+	size_t index = static_cast<size_t>(position % m_header->maxCount);
+	return reinterpret_cast<Slot *>(m_slots + index * m_header->slotSize);
+}
+
+bool ShmMpmcQueue::tryEnqueue(const ByteBuffer &message)
+{
+	unsigned long long position = __atomic_load_n(&m_header->enqueuePosition, __ATOMIC_RELAXED);
+	Slot *target = NULL;
+	while (true) {
+		target = slot(position);
+		unsigned long long sequence = __atomic_load_n(&target->sequence, __ATOMIC_ACQUIRE);
+		long long difference = static_cast<long long>(sequence - position);
+		if (difference == 0) {
+			// Free for this position, claim it (position is reloaded on failure)
+			if (__atomic_compare_exchange_n(&m_header->enqueuePosition, &position, position + 1
+				, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		}
+		else if (difference < 0) {
+			// Still holds the message of the previous round: full
+			return false;
+		}
+		else {
+			// Another sender claimed it
+			position = __atomic_load_n(&m_header->enqueuePosition, __ATOMIC_RELAXED);
+		}
+	}
+
+	size_t size = message.Size();
+	target->length = static_cast<unsigned int>(size);
+	if (size > 0) {
+		::memcpy(reinterpret_cast<char *>(target) + sizeof(Slot), message.Data().data(), size);
+	}
+	__atomic_store_n(&target->sequence, position + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool ShmMpmcQueue::tryDequeue(ByteBuffer &outMessage)
+{
+	unsigned long long position = __atomic_load_n(&m_header->dequeuePosition, __ATOMIC_RELAXED);
+	Slot *target = NULL;
+	while (true) {
+		target = slot(position);
+		unsigned long long sequence = __atomic_load_n(&target->sequence, __ATOMIC_ACQUIRE);
+		long long difference = static_cast<long long>(sequence - (position + 1));
+		if (difference == 0) {
+			// Filled for this position, claim it (position is reloaded on failure)
+			if (__atomic_compare_exchange_n(&m_header->dequeuePosition, &position, position + 1
+				, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		}
+		else if (difference < 0) {
+			// Not filled yet: empty (or a sender is still copying)
+			return false;
+		}
+		else {
+			// Another receiver claimed it
+			position = __atomic_load_n(&m_header->dequeuePosition, __ATOMIC_RELAXED);
+		}
+	}
+
+	unsigned int length = target->length;
+	if (length > m_header->maxSize) {
+		// Not written by a sender of this queue
+		length = m_header->maxSize;
+	}
+	outMessage.Assign(reinterpret_cast<const char *>(target) + sizeof(Slot), length);
+	__atomic_store_n(&target->sequence, position + m_header->maxCount, __ATOMIC_RELEASE);
+	return true;
+}
+
+Result ShmMpmcQueue::Send(const ByteBuffer &message)
+{
+	return TimedSend(message, 0UL);
+}
+
+Result ShmMpmcQueue::TimedSend(const ByteBuffer &message, unsigned long millisec)
+{
+	if (m_header == NULL) {
+		return Result::CreateError("message queue send error [%s]","queue not found");
+	}
+
+	if (message.Size() > m_header->maxSize) {
+		return Result::CreateError("message queue send error [%s]",std::strerror(EMSGSIZE));
+	}
+
+	if (!tryEnqueue(message)) {
+		timespec deadline;
+		if (millisec > 0) {
+			deadline = deadlineAfter(millisec);
+		}
+		while (true) {
+			// Full: count this sender as sleeping, then try once more before sleeping
+			unsigned int event = __atomic_load_n(&m_header->notFullEvent, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&m_header->waitingSenders, 1U, __ATOMIC_SEQ_CST);
+			bool isSent = tryEnqueue(message);
+			int error = 0;
+			if (!isSent) {
+				error = futexWait(&m_header->notFullEvent, event, (millisec > 0 ? &deadline : NULL));
+			}
+			__atomic_sub_fetch(&m_header->waitingSenders, 1U, __ATOMIC_SEQ_CST);
+			if (isSent || tryEnqueue(message)) {
+				break;
+			}
+			if (error != 0) {
+				return Result::CreateError("message queue send error [%s]",std::strerror(error));
+			}
+		}
+	}
+	signalEvent(&m_header->notEmptyEvent, &m_header->waitingReceivers, 1);
+
+	return Result::CreateSuccess();
+}
+
+Result ShmMpmcQueue::Receive(ByteBuffer &outMessage)
+{
+	return TimedReceive(outMessage, 0UL);
+}
+
+Result ShmMpmcQueue::TimedReceive(ByteBuffer &outMessage, unsigned long millisec)
+{
+	if (m_header == NULL) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	if (!tryDequeue(outMessage)) {
+		timespec deadline;
+		if (millisec > 0) {
+			deadline = deadlineAfter(millisec);
+		}
+		while (true) {
+			// Empty: count this receiver as sleeping, then try once more before sleeping
+			unsigned int event = __atomic_load_n(&m_header->notEmptyEvent, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&m_header->waitingReceivers, 1U, __ATOMIC_SEQ_CST);
+			bool isReceived = tryDequeue(outMessage);
+			int error = 0;
+			if (!isReceived) {
+				error = futexWait(&m_header->notEmptyEvent, event, (millisec > 0 ? &deadline : NULL));
+			}
+			__atomic_sub_fetch(&m_header->waitingReceivers, 1U, __ATOMIC_SEQ_CST);
+			if (isReceived || tryDequeue(outMessage)) {
+				break;
+			}
+			if (error != 0) {
+				return Result::CreateError("message queue receive error [%s]",std::strerror(error));
+			}
+		}
+	}
+	signalEvent(&m_header->notFullEvent, &m_header->waitingSenders, 1);
+
+	return Result::CreateSuccess();
+}
+
+Result ShmMpmcQueue::Receive(std::vector<ByteBuffer> &outMessages)
+{
+	outMessages.clear();
+	if (m_header == NULL) {
+		return Result::CreateError("message queue receive error [%s]","queue not found");
+	}
+
+	// At most one round of the slots, the senders may keep the queue filled
+	ByteBuffer message;
+	for (unsigned int i = 0; i < m_header->maxCount && tryDequeue(message); i++) {
+		outMessages.push_back(message);
+	}
+	if (!outMessages.empty()) {
+		signalEvent(&m_header->notFullEvent, &m_header->waitingSenders, static_cast<int>(outMessages.size()));
+	}
+
+	return Result::CreateSuccess();
+}
+
+}
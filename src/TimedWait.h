@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////
+/// @file	TimedWait.h
+/// @brief	Deadlines and futex waits shared by the sources (not installed)
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_TIMED_WAIT__
+#define __LIGHT_IPC_TIMED_WAIT__
+
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <cerrno>
+
+namespace LightIPC {
+
+///////////////////////////////////////////////////////////
+/// @brief		Absolute time usec microseconds from now
+/// @param[in]	usec Microseconds
+/// @param[in]	clock Clock of the deadline (CLOCK_REALTIME for mq_timedsend/mq_timedreceive)
+/// @return		Deadline
+///////////////////////////////////////////////////////////
+inline timespec deadlineAfterUsec(unsigned long long usec, clockid_t clock = CLOCK_MONOTONIC)
+{
+	timespec deadline;
+	::clock_gettime(clock, &deadline);
+	deadline.tv_sec += static_cast<time_t>(usec / 1000000ULL);
+	deadline.tv_nsec += static_cast<long>(usec % 1000000ULL) * 1000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_nsec -= 1000000000L;
+		deadline.tv_sec++;
+	}
+	return deadline;
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Absolute time msec milliseconds from now
+/// @param[in]	msec Milliseconds
+/// @param[in]	clock Clock of the deadline (CLOCK_REALTIME for mq_timedsend/mq_timedreceive)
+/// @return		Deadline
+///////////////////////////////////////////////////////////
+inline timespec deadlineAfter(unsigned long msec, clockid_t clock = CLOCK_MONOTONIC)
+{
+	return deadlineAfterUsec(static_cast<unsigned long long>(msec) * 1000ULL, clock);
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Sleep on a shared futex while *word is value
+/// @param[in]	word Futex word (may be in shared memory, the waker may be another process)
+/// @param[in]	value Value read before the sleep
+/// @param[in]	deadline CLOCK_MONOTONIC deadline (NULL: none)
+/// @return		0: woken up or *word was not value, ETIMEDOUT: the deadline has passed
+///////////////////////////////////////////////////////////
+inline int futexWait(unsigned int *word, unsigned int value, const timespec *deadline)
+{
+	timespec remaining;
+	timespec *timeout = NULL;
+	if (deadline) {
+		timespec now;
+		::clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining.tv_sec = deadline->tv_sec - now.tv_sec;
+		remaining.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+		if (remaining.tv_nsec < 0) {
+			remaining.tv_nsec += 1000000000L;
+			remaining.tv_sec--;
+		}
+		if (remaining.tv_sec < 0) {
+			return ETIMEDOUT;
+		}
+		timeout = &remaining;
+	}
+
+	// Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+	if (::syscall(SYS_futex, word, FUTEX_WAIT, value, timeout, NULL, 0) == -1 && errno == ETIMEDOUT) {
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////
+/// @brief		Wake up count sleepers of a shared futex
+/// @param[in]	word Futex word
+/// @param[in]	count Number of sleepers to wake up
+///////////////////////////////////////////////////////////
+inline void futexWake(unsigned int *word, int count)
+{
+	::syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+}
+
+#endif
@@ -1,7 +1,19 @@
 #include "UnixDomainSocket.h"
+#include "IoUring.h"
+#include "Crc32c.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <linux/sockios.h>
+#include <time.h>
 
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -10,25 +22,378 @@
 
 namespace LightIPC {
 
+// First datagram of a fragmented message sent without Frame (older peers)
 struct ProtocolHeader
 {
 	unsigned char hexspeak[4]; // 0xDEADC0DE
 	unsigned int size;		   // message body size
 };
 
-UnixDomainSocket::UnixDomainSocket(const std::string &path, bool isOwner)
+// Leading part of a message, fixed and aligned (copied with one memcpy)
+struct FrameHeader
+{
+	unsigned char hexspeak[4];	// 0xDEADC0DE
+	unsigned char version;		// FRAME_VERSION
+	unsigned char control;		// FRAME_BODY_IN_DESCRIPTOR, FRAME_FRAGMENTED, FRAME_CHECKSUM
+	unsigned char type;			// Frame::type
+	unsigned char flags;		// Frame::flags
+	unsigned int correlationId;	// Frame::correlationId
+	unsigned int size;			// message body size
+	unsigned int headerSize;	// application header size
+	unsigned int checksum;		// CRC32C with FRAME_CHECKSUM
+};
+
+// Version of FrameHeader, a frame of another version is rejected
+static const unsigned char FRAME_VERSION = 1;
+
+static const size_t MAX_HEADER_SIZE = 512;
+static const size_t TRANSMIT_SIZE = 1024;
+
+// FrameHeader::control flag: the body is in the memfd passed with SCM_RIGHTS
+static const unsigned char FRAME_BODY_IN_DESCRIPTOR = 0x01;
+
+// FrameHeader::control flag: header and body follow as separate datagrams
+static const unsigned char FRAME_FRAGMENTED = 0x02;
+
+// FrameHeader::control flag: checksum is the CRC32C of the message
+static const unsigned char FRAME_CHECKSUM = 0x04;
+
+// Seals required on a passed memfd, the receiver maps it safely
+static const int DESCRIPTOR_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+// Control message space for one descriptor
+union DescriptorControl
+{
+	cmsghdr align;
+	char buffer[CMSG_SPACE(sizeof(int))];
+};
+
+// Messages of one sendmmsg/recvmmsg
+static const size_t MAX_BATCH_MESSAGES = 64;
+
+// Default datagram size of the io_uring reception buffers
+static const size_t URING_DATAGRAM_SIZE = 64 * 1024;
+
+// unix_dgram_sendmsg() rejects datagrams larger than sk_sndbuf - 32
+static const size_t DATAGRAM_OVERHEAD = 32;
+
+// Messages sent between the backlog checks of the buffer autotuning
+static const unsigned int AUTOTUNE_INTERVAL = 64;
+
+static void setHexspeak(unsigned char *hexspeak)
+{
+	hexspeak[0] = 0xDE; // dead code
+	hexspeak[1] = 0xAD;
+	hexspeak[2] = 0xC0;
+	hexspeak[3] = 0xDE;
+}
+
+static bool isHexspeak(const unsigned char *hexspeak)
+{
+	return hexspeak[0] == 0xDE
+		&& hexspeak[1] == 0xAD
+		&& hexspeak[2] == 0xC0
+		&& hexspeak[3] == 0xDE;
+}
+
+// Fill the frame header of a message
+// frame: NULL sends zero fields
+static void setFrameHeader(FrameHeader &fh, const UnixDomainSocket::Frame *frame, unsigned char control
+	, size_t headerSize, size_t size)
+{
+	setHexspeak(fh.hexspeak);
+	fh.version		 = FRAME_VERSION;
+	fh.control		 = control;
+	fh.type			 = (frame != NULL ? frame->type : 0);
+	fh.flags		 = (frame != NULL ? frame->flags : 0);
+	fh.correlationId = (frame != NULL ? frame->correlationId : 0);
+	fh.size			 = static_cast<unsigned int>(size);
+	fh.headerSize	 = static_cast<unsigned int>(headerSize);
+	fh.checksum		 = 0;
+}
+
+// CRC32C of a message: FrameHeader (checksum as 0), header and body
+static unsigned int frameChecksum(const FrameHeader &fh, const char *header, size_t headerSize, const char *body, size_t size)
+{
+	FrameHeader copy = fh;
+	copy.checksum = 0;
+	unsigned int crc = Crc32c::Compute(&copy, sizeof(FrameHeader));
+	crc = Crc32c::Extend(crc, header, headerSize);
+	return Crc32c::Extend(crc, body, size);
+}
+
+// Add the checksum of the message to a filled frame header
+static void setChecksum(FrameHeader &fh, const ByteBuffer &header, const ByteBuffer &body)
+{
+	fh.control |= FRAME_CHECKSUM;
+	fh.checksum = frameChecksum(fh, header.Data().data(), header.Size(), body.Data().data(), body.Size());
+}
+
+// Verify the checksum of a received message (a message without one passes)
+static Result verifyChecksum(const FrameHeader &fh, const ByteBuffer &header, const char *body, size_t size)
+{
+	if ((fh.control & FRAME_CHECKSUM) == 0) {
+		return Result::CreateSuccess();
+	}
+	unsigned int crc = frameChecksum(fh, header.Data().data(), header.Size(), body, size);
+	if (crc != fh.checksum) {
+		return Result::CreateError("receive checksum error [%s:0x%08X]","checksum mismatch", fh.checksum);
+	}
+	return Result::CreateSuccess();
+}
+
+static Result verifyChecksum(const FrameHeader &fh, const ByteBuffer &header, const ByteBuffer &body)
+{
+	return verifyChecksum(fh, header, body.Data().data(), body.Size());
+}
+
+// Check if a received datagram can start a message, the others are the rest of a message
+// whose start was lost. The sizes must match the datagram, decodeDatagram() checks the rest
+// isStrict: the datagram came inside a fragmented message, it must be a FrameHeader of this
+//           version whose checksum (if any) matches (not a body that looks like a message)
+static bool isMessageStart(const FrameHeader &fh, const char *payload, ssize_t len, int flags, bool isStrict)
+{
+	if (len < static_cast<ssize_t>(sizeof(ProtocolHeader)) || !isHexspeak(fh.hexspeak)) {
+		return false;
+	}
+	if (len == static_cast<ssize_t>(sizeof(ProtocolHeader))) {
+		return !isStrict;
+	}
+	if (flags & MSG_TRUNC) {
+		// Reported as truncated
+		return !isStrict;
+	}
+	if (len < static_cast<ssize_t>(sizeof(FrameHeader)) || fh.headerSize > MAX_HEADER_SIZE) {
+		return false;
+	}
+	if (fh.version != FRAME_VERSION) {
+		// Reported as unsupported
+		return !isStrict;
+	}
+
+	size_t expected = sizeof(FrameHeader);
+	bool isWhole = (fh.control & (FRAME_FRAGMENTED | FRAME_BODY_IN_DESCRIPTOR)) == 0;
+	if ((fh.control & FRAME_FRAGMENTED) == 0) {
+		expected += fh.headerSize;
+	}
+	if (isWhole) {
+		expected += fh.size;
+	}
+	if (static_cast<size_t>(len) != expected) {
+		return false;
+	}
+	if (isStrict && isWhole && (fh.control & FRAME_CHECKSUM)) {
+		return frameChecksum(fh, payload, fh.headerSize, payload + fh.headerSize, fh.size) == fh.checksum;
+	}
+	return true;
+}
+
+// Fill a socket address
+// isAbstract: sun_path starts with NUL, the name is not a file
+static bool setAddress(sockaddr_un &address, const std::string &name, bool isAbstract)
+{
+	::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	size_t offset = (isAbstract ? 1 : 0);
+	if (offset + name.size() >= sizeof(address.sun_path)) {
+		return false;
+	}
+	::memcpy(address.sun_path + offset, name.data(), name.size());
+	return true;
+}
+
+// Length of a socket address, an abstract name is not terminated by NUL
+static socklen_t addressSize(const sockaddr_un *address)
+{
+	if (address == NULL) {
+		return 0;
+	}
+	if (address->sun_path[0] != '\0') {
+		return sizeof(sockaddr_un);
+	}
+	return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + ::strlen(address->sun_path + 1));
+}
+
+UnixDomainSocket::UnixDomainSocket(const std::string &path, bool isOwner, SocketMode mode, AddressType addressType, IoEngine engine)
 	: m_path(path)
 	, m_isOwner(isOwner)
+	, m_socketMode(mode)
+	, m_addressType(addressType)
 	, m_txSocketFd(-1)
 	, m_rxSocketFd(-1)
 	, m_isOpend(false)
 	, m_limitSize(0xffffff) // 24bit(16.7Mb)
+	, m_framingMode(FRAMING_DATAGRAM)
+	, m_maxDatagramSize(0)
+	, m_maxReceiveSize(0)
+	, m_receiveBuffer(NULL)
+	, m_receiveBufferSize(0)
+	, m_sendTimeout(500)
+	, m_isSendTimedOut(false)
+	, m_batchBuffer(NULL)
+	, m_batchBufferSize(0)
+	, m_descriptorThreshold(0)
+	, m_busyPollTime(0)
+	, m_busyPollHits(0)
+	, m_busyPollMisses(0)
+	, m_isChecksum(false)
+	, m_resyncCount(0)
+	, m_heldDatagram(NULL)
+	, m_heldSize(0)
+	, m_heldBufferSize(0)
+	, m_heldSocketFd(-1)
+	, m_sendBufferSize(0)
+	, m_socketReceiveBufferSize(0)
+	, m_autotuneLimit(0)
+	, m_peakSendSize(0)
+	, m_autotuneCount(0)
+	, m_ioEngine(engine)
+	, m_uring(NULL)
+	, m_sendUring(NULL)
+	, m_uringDatagramSize(URING_DATAGRAM_SIZE)
+	, m_singleBuffer()
+	, m_wakeupFd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
 {
 }
 
 UnixDomainSocket::~UnixDomainSocket()
 {
 	CloseSocket();
+	delete [] m_receiveBuffer;
+	delete [] m_batchBuffer;
+	delete [] m_heldDatagram;
+	if (m_wakeupFd != -1) {
+		::close(m_wakeupFd);
+	}
+}
+
+// The largest datagram accepted by the kernel depends on SO_SNDBUF
+static size_t maxDatagramSize(int socketFd)
+{
+	int sendBufferSize = 0;
+	socklen_t optlen = sizeof(sendBufferSize);
+	if (::getsockopt(socketFd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, &optlen) == 0
+	 && static_cast<size_t>(sendBufferSize) > DATAGRAM_OVERHEAD + TRANSMIT_SIZE) {
+		return static_cast<size_t>(sendBufferSize) - DATAGRAM_OVERHEAD;
+	}
+	return TRANSMIT_SIZE;
+}
+
+// Largest datagram to try after the kernel refused one of refusedSize bytes (EMSGSIZE)
+// SO_SNDBUF may have been lowered since the socket was opened, take its limit again
+static size_t refusedDatagramSize(int socketFd, size_t refusedSize)
+{
+	size_t limit = maxDatagramSize(socketFd);
+	return (limit < refusedSize ? limit : refusedSize - 1);
+}
+
+// Get a socket buffer size (SO_SNDBUF/SO_RCVBUF), 0 on error
+static size_t bufferSize(int socketFd, int option)
+{
+	int size = 0;
+	socklen_t optlen = sizeof(size);
+	if (socketFd == -1 || ::getsockopt(socketFd, SOL_SOCKET, option, &size, &optlen) == -1) {
+		return 0;
+	}
+	return static_cast<size_t>(size);
+}
+
+// Set a socket buffer size, beyond the system limit with forceOption if permitted
+static bool setBufferSize(int socketFd, int option, int forceOption, size_t size)
+{
+	int value = (size > 0x3fffffff ? 0x3fffffff : static_cast<int>(size));
+	if (::setsockopt(socketFd, SOL_SOCKET, option, &value, sizeof(value)) == -1) {
+		return false;
+	}
+	// The kernel doubles the value, capped by net.core.wmem_max/rmem_max
+	if (bufferSize(socketFd, option) < static_cast<size_t>(value) * 2) {
+		::setsockopt(socketFd, SOL_SOCKET, forceOption, &value, sizeof(value));
+	}
+	return true;
+}
+
+Result UnixDomainSocket::OpenSocket()
+{
+	if (IsOpend()) {
+		return Result::CreateSuccess();
+	}
+
+	Result result;
+	if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+		result = openSeqpacketSocket();
+	} else {
+		result = openDatagramSocket();
+	}
+	if (result.IsSuccess()) {
+		m_maxReceiveSize = m_maxDatagramSize;
+		// Tuning only, the sockets work with the default sizes
+		applyBufferSizes(m_txSocketFd, true, m_txSocketFd == m_rxSocketFd);
+		if (m_rxSocketFd != m_txSocketFd) {
+			applyBufferSizes(m_rxSocketFd, false, true);
+		}
+		openEngine();
+	}
+	return result;
+}
+
+Result UnixDomainSocket::applyBufferSizes(int socketFd, bool isSend, bool isReceive)
+{
+	if (socketFd == -1) {
+		return Result::CreateSuccess();
+	}
+	if (isSend && m_sendBufferSize > 0) {
+		if (!setBufferSize(socketFd, SO_SNDBUF, SO_SNDBUFFORCE, m_sendBufferSize)) {
+			return Result::CreateError("socket buffer error [%s]",::strerror(errno));
+		}
+		// A smaller buffer rejects the larger datagrams
+		size_t limit = maxDatagramSize(socketFd);
+		if (limit < m_maxDatagramSize) {
+			m_maxDatagramSize = limit;
+		}
+	}
+	if (isReceive && m_socketReceiveBufferSize > 0) {
+		if (!setBufferSize(socketFd, SO_RCVBUF, SO_RCVBUFFORCE, m_socketReceiveBufferSize)) {
+			return Result::CreateError("socket buffer error [%s]",::strerror(errno));
+		}
+	}
+	if (isReceive) {
+		// A partner with a larger SO_SNDBUF sends larger datagrams, accept them up to SO_RCVBUF
+		size_t receiveSize = bufferSize(socketFd, SO_RCVBUF);
+		if (receiveSize > DATAGRAM_OVERHEAD) {
+			growReceiveSize(receiveSize - DATAGRAM_OVERHEAD);
+		}
+	}
+	return Result::CreateSuccess();
+}
+
+void UnixDomainSocket::openEngine()
+{
+	if (m_ioEngine != IO_ENGINE_URING || m_uring != NULL) {
+		return;
+	}
+	if (m_socketMode == SOCKET_MODE_SEQPACKET && m_isOwner) {
+		// The accepted connections are received with recvmmsg
+		return;
+	}
+
+	// A batch holds at most MAX_BATCH_MESSAGES buffers, the others receive the fragments meanwhile
+	// A larger datagram is truncated once, then the buffers are rebuilt for its size
+	IoUring *uring = new IoUring();
+	Result result = uring->Open(m_rxSocketFd, m_uringDatagramSize
+			, sizeof(DescriptorControl), MAX_BATCH_MESSAGES * 2);
+	IoUring *sendUring = new IoUring();
+	if (result.IsSuccess()) {
+		result = sendUring->OpenSend(MAX_BATCH_MESSAGES);
+	}
+	if (result.IsError()) {
+		// Fall back to IO_ENGINE_SOCKET
+		delete uring;
+		delete sendUring;
+		return;
+	}
+	uring->SetWakeupFd(m_wakeupFd);
+	m_uring = uring;
+	m_sendUring = sendUring;
 }
 
 /*
@@ -38,35 +403,37 @@ UnixDomainSocket::~UnixDomainSocket()
 	send -> ${m_path}.tx -> recv 
 	recv <- ${m_path}.rx <- send
 */
-Result UnixDomainSocket::OpenSocket()
+Result UnixDomainSocket::openDatagramSocket()
 {
 	Result result;
-	if (IsOpend()) {
-		return result;
-	}
+	bool isAbstract = (m_addressType == ADDRESS_ABSTRACT);
 
 	// tx socket
 	if (m_txSocketFd == -1) {
 		std::string name(m_path);
 		name += (m_isOwner ? ".tx" : ".rx");
+		if (!setAddress(m_txAddress, name, isAbstract)) {
+			return Result::CreateError("open socket error [%s]", "path too long");
+		}
 
 		m_txSocketFd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
-		m_txAddress.sun_family = AF_UNIX;
-		::strcpy(m_txAddress.sun_path, name.c_str());
+		m_maxDatagramSize = maxDatagramSize(m_txSocketFd);
 	}
 
 	// rx socket
 	if (m_rxSocketFd == -1) {
 		std::string name(m_path);
 		name += (m_isOwner ? ".rx" : ".tx");
+		if (!setAddress(m_rxAddress, name, isAbstract)) {
+			return Result::CreateError("open socket error [%s]", "path too long");
+		}
 
 		m_rxSocketFd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
-		::unlink(name.c_str());
-
-		m_rxAddress.sun_family = AF_UNIX;
-		::strcpy(m_rxAddress.sun_path, name.c_str());
+		if (!isAbstract) {
+			::unlink(name.c_str());
+		}
 
-		int ret = ::bind(m_rxSocketFd, (sockaddr*)&m_rxAddress, sizeof(m_rxAddress));
+		int ret = ::bind(m_rxSocketFd, (sockaddr*)&m_rxAddress, addressSize(&m_rxAddress));
 		if (ret == -1) {
 			result = Result::CreateError("open socket error [%s]", ::strerror(errno));
 		}
@@ -75,24 +442,87 @@ Result UnixDomainSocket::OpenSocket()
 	return result;
 }
 
+/*
+ server listens on ${m_path}, each client connects to it
+   server						  client
+	accept <- ${m_path} <- connect
+	send/recv  <-- connection -->  send/recv
+*/
+Result UnixDomainSocket::openSeqpacketSocket()
+{
+	int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		return Result::CreateError("open socket error [%s]", ::strerror(errno));
+	}
+	m_maxDatagramSize = maxDatagramSize(fd);
+
+	bool isAbstract = (m_addressType == ADDRESS_ABSTRACT);
+	sockaddr_un address;
+	if (!setAddress(address, m_path, isAbstract)) {
+		::close(fd);
+		return Result::CreateError("open socket error [%s]", "path too long");
+	}
+
+	int ret = 0;
+	if (m_isOwner) {
+		if (!isAbstract) {
+			::unlink(m_path.c_str());
+		}
+		ret = ::bind(fd, (sockaddr*)&address, addressSize(&address));
+		if (ret != -1) {
+			ret = ::listen(fd, SOMAXCONN);
+		}
+		m_rxAddress = address;
+	} else {
+		ret = ::connect(fd, (sockaddr*)&address, addressSize(&address));
+		m_txAddress = address;
+	}
+	if (ret == -1) {
+		Result result = Result::CreateError("open socket error [%s]", ::strerror(errno));
+		::close(fd);
+		return result;
+	}
+
+	// The listening socket (server) or the connection (client)
+	m_rxSocketFd = fd;
+	m_txSocketFd = (m_isOwner ? -1 : fd);
+	m_isOpend = true;
+	return Result::CreateSuccess();
+}
+
 void UnixDomainSocket::CloseSocket()
 {
-	if (!IsOpend()) {
+	if (m_txSocketFd == -1 && m_rxSocketFd == -1) {
 		return;
 	}
 
-	if (m_txSocketFd != -1) {
+	// Stop io_uring before the socket is closed
+	delete m_uring;
+	m_uring = NULL;
+	delete m_sendUring;
+	m_sendUring = NULL;
+	m_heldSize = 0;
+
+	if (m_txSocketFd != -1 && m_txSocketFd != m_rxSocketFd) {
 		::close(m_txSocketFd);
-		m_txSocketFd = -1;
 	}
+	m_txSocketFd = -1;
 	if (m_rxSocketFd != -1) {
 		::close(m_rxSocketFd);
 		m_rxSocketFd = -1;
 	}
 
-	std::string name(m_path);
-	name += (m_isOwner ? ".rx" : ".tx");
-	::unlink(name.c_str());
+	if (m_addressType == ADDRESS_ABSTRACT) {
+		// Abstract names disappear with the socket
+	} else if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+		if (m_isOwner) {
+			::unlink(m_path.c_str());
+		}
+	} else {
+		std::string name(m_path);
+		name += (m_isOwner ? ".rx" : ".tx");
+		::unlink(name.c_str());
+	}
 
 	m_isOpend = false;
 }
@@ -103,8 +533,12 @@ bool UnixDomainSocket::IsOpend()
 }
 
 // Transmission procedure
+// FRAMING_DATAGRAM
+// 1. FrameHeader + header + body Send as one datagram (sendmsg)
+//    Falls back to the fragmented procedure when it exceeds MaxDatagramSize()
+// FRAMING_FRAGMENTED
 // At this time read, data that exceeds the specified size is discarded, so it is necessary to acquire it once.
-// 1. ProtocolHeader Send
+// 1. FrameHeader (FRAME_FRAGMENTED) Send, ProtocolHeader without Frame
 // 2. header Send
 // 3. body Split send
 Result UnixDomainSocket::Send(const ByteBuffer &header, const ByteBuffer &body)
@@ -113,36 +547,166 @@ Result UnixDomainSocket::Send(const ByteBuffer &header, const ByteBuffer &body)
 		return Result::CreateError("send socket error [%s]","socket closed");
 	}
 
-	if (header.Size() > 512) {
+	if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+		if (m_txSocketFd == -1) {
+			return Result::CreateError("send socket error [%s]","not connected");
+		}
+		return sendMessage(m_txSocketFd, NULL, NULL, header, body);
+	}
+	return sendMessage(m_txSocketFd, &m_txAddress, NULL, header, body);
+}
+
+Result UnixDomainSocket::Send(const Frame &frame, const ByteBuffer &header, const ByteBuffer &body)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("send socket error [%s]","socket closed");
+	}
+
+	if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+		if (m_txSocketFd == -1) {
+			return Result::CreateError("send socket error [%s]","not connected");
+		}
+		return sendMessage(m_txSocketFd, NULL, &frame, header, body);
+	}
+	return sendMessage(m_txSocketFd, &m_txAddress, &frame, header, body);
+}
+
+Result UnixDomainSocket::Send(int socketFd, const ByteBuffer &header, const ByteBuffer &body)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("send socket error [%s]","socket closed");
+	}
+
+	return sendMessage(socketFd, NULL, NULL, header, body);
+}
+
+Result UnixDomainSocket::Send(int socketFd, const Frame &frame, const ByteBuffer &header, const ByteBuffer &body)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("send socket error [%s]","socket closed");
+	}
+
+	return sendMessage(socketFd, NULL, &frame, header, body);
+}
+
+Result UnixDomainSocket::checkMessage(const ByteBuffer &header, const ByteBuffer &body)
+{
+	if (header.Size() > MAX_HEADER_SIZE) {
 		return Result::CreateError("send header error [%s:%lu]"
 				,"header too big size"
 				, static_cast<unsigned long>(header.Size()));
 	}
 
-	size_t size = body.Size();
-
-	if (0 < m_limitSize && m_limitSize < size) {
+	if (0 < m_limitSize && m_limitSize < body.Size()) {
 		return Result::CreateError("send header error [%s:%lu]"
 				,"body too big size"
-				, static_cast<unsigned long>(size));
+				, static_cast<unsigned long>(body.Size()));
+	}
+	return Result::CreateSuccess();
+}
+
+Result UnixDomainSocket::sendMessage(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body)
+{
+	Result result = checkMessage(header, body);
+	if (result.IsError()) {
+		return result;
+	}
+
+	size_t size = body.Size();
+
+	if (m_framingMode == FRAMING_FRAGMENTED) {
+		return sendFragmented(socketFd, address, frame, header, body, TRANSMIT_SIZE);
+	}
+
+	if (0 < m_descriptorThreshold && m_descriptorThreshold <= size) {
+		return sendDescriptor(socketFd, address, frame, header, body);
+	}
+
+	size_t total = sizeof(FrameHeader) + header.Size() + size;
+	if (total <= m_maxDatagramSize) {
+		autotune(socketFd, total);
+		FrameHeader fh;
+		setFrameHeader(fh, frame, 0, header.Size(), size);
+		if (m_isChecksum) {
+			setChecksum(fh, header, body);
+		}
+
+		iovec iov[3];
+		iov[0].iov_base = &fh;
+		iov[0].iov_len  = sizeof(FrameHeader);
+		iov[1].iov_base = const_cast<char *>(header.Data().data());
+		iov[1].iov_len  = header.Size();
+		iov[2].iov_base = const_cast<char *>(body.Data().data());
+		iov[2].iov_len  = size;
+
+		msghdr msg;
+		::memset(&msg, 0, sizeof(msg));
+		msg.msg_name	= const_cast<sockaddr_un *>(address);
+		msg.msg_namelen = addressSize(address);
+		msg.msg_iov		= iov;
+		msg.msg_iovlen	= 3;
+
+		ssize_t sentSize = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+		while (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+			sentSize = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+		}
+		if (sentSize == static_cast<ssize_t>(total)) {
+			return Result::CreateSuccess();
+		}
+		if (sentSize != -1 || errno != EMSGSIZE) {
+			return Result::CreateError("send datagram error [%s]",::strerror(errno));
+		}
+		// The kernel refused the size, do not try it again
+		m_maxDatagramSize = refusedDatagramSize(socketFd, total);
 	}
 
-	ProtocolHeader ph;
-	ph.hexspeak[0] = 0xDE; // dead code
-	ph.hexspeak[1] = 0xAD;
-	ph.hexspeak[2] = 0xC0;
-	ph.hexspeak[3] = 0xDE;
-	ph.size		   = static_cast<unsigned int>(size);
+	return sendFragmented(socketFd, address, frame, header, body, m_maxDatagramSize);
+}
+
+Result UnixDomainSocket::sendFragmented(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body, size_t transmitSize)
+{
+	size_t size = body.Size();
+	socklen_t addressLength = addressSize(address);
+	autotune(socketFd, sizeof(FrameHeader) + header.Size() + size);
 
 	ssize_t sentSize = 0;
-	sentSize = ::sendto(m_txSocketFd, &ph, sizeof(ProtocolHeader), 0,(sockaddr*)&m_txAddress, sizeof(m_txAddress));
-	if (sentSize != sizeof(ProtocolHeader)) {
-		return Result::CreateError("send protocol header error [%s]",::strerror(errno));
+	// Older peers have no SOCK_SEQPACKET mode, whose connections end at the empty header datagram
+	bool isLegacy = (frame == NULL && !m_isChecksum && m_socketMode != SOCKET_MODE_SEQPACKET);
+	if (isLegacy) {
+		ProtocolHeader ph;
+		setHexspeak(ph.hexspeak);
+		ph.size = static_cast<unsigned int>(size);
+		sentSize = ::sendto(socketFd, &ph, sizeof(ProtocolHeader), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		while (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+			sentSize = ::sendto(socketFd, &ph, sizeof(ProtocolHeader), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		}
+		if (sentSize != sizeof(ProtocolHeader)) {
+			return Result::CreateError("send protocol header error [%s]",::strerror(errno));
+		}
+	} else {
+		FrameHeader fh;
+		setFrameHeader(fh, frame, FRAME_FRAGMENTED, header.Size(), size);
+		if (m_isChecksum) {
+			setChecksum(fh, header, body);
+		}
+		sentSize = ::sendto(socketFd, &fh, sizeof(FrameHeader), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		while (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+			sentSize = ::sendto(socketFd, &fh, sizeof(FrameHeader), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		}
+		if (sentSize != sizeof(FrameHeader)) {
+			return Result::CreateError("send protocol header error [%s]",::strerror(errno));
+		}
 	}
 
-	sentSize = ::sendto(m_txSocketFd, header.Data().data(), header.Size(), 0,(sockaddr*)&m_txAddress, sizeof(m_txAddress));
-	if (sentSize != static_cast<ssize_t>(header.Size())) {
-		return Result::CreateError("send application header error [%s]",::strerror(errno));
+	// An empty header is not sent after a FrameHeader (an empty datagram ends a SOCK_SEQPACKET connection)
+	if (isLegacy || header.Size() > 0) {
+		sentSize = ::sendto(socketFd, header.Data().data(), header.Size(), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		while (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+			sentSize = ::sendto(socketFd, header.Data().data(), header.Size(), MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		}
+		if (sentSize != static_cast<ssize_t>(header.Size())) {
+			return Result::CreateError("send application header error [%s]",::strerror(errno));
+		}
 	}
 
 	if (size == 0) {
@@ -150,16 +714,18 @@ Result UnixDomainSocket::Send(const ByteBuffer &header, const ByteBuffer &body)
 	}
 
 	// send divided data
-	static const size_t TRANSMIT_SIZE = 1024;
 	const char *msg = body.Data().data();
 	size_t txSize = 0;
-	size_t transmitSize = 0;
+	size_t chunkSize = 0;
 	while (txSize != size) {
-		transmitSize = size - txSize;
-		if (transmitSize > TRANSMIT_SIZE) {
-			transmitSize = TRANSMIT_SIZE;
+		chunkSize = size - txSize;
+		if (chunkSize > transmitSize) {
+			chunkSize = transmitSize;
+		}
+		sentSize = ::sendto(socketFd, msg + txSize, chunkSize, MSG_NOSIGNAL,(const sockaddr*)address, addressLength);
+		if (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+			continue;
 		}
-		sentSize = ::sendto(m_txSocketFd, msg + txSize, transmitSize, 0,(sockaddr*)&m_txAddress, sizeof(m_txAddress));
 		if (sentSize == -1) {
 			return Result::CreateError("send body error [%s]",::strerror(errno));
 		}
@@ -169,87 +735,1326 @@ Result UnixDomainSocket::Send(const ByteBuffer &header, const ByteBuffer &body)
 	return Result::CreateSuccess();
 }
 
-Result UnixDomainSocket::Receive(ByteBuffer &outHeader, ByteBuffer &outBody)
+// Descriptor transmission procedure
+// 1. Write body to a memfd and seal it (the size and contents can no longer change)
+// 2. FrameHeader + header Send as one datagram, the memfd is passed with SCM_RIGHTS
+Result UnixDomainSocket::sendDescriptor(int socketFd, const sockaddr_un *address, const Frame *frame, const ByteBuffer &header, const ByteBuffer &body)
 {
-	if (!IsOpend()) {
-		return Result::CreateError("receive socket error [%s]","socket closed");
+	int memoryFd = ::memfd_create("LightIPC", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memoryFd == -1) {
+		return Result::CreateError("send descriptor error [%s]",::strerror(errno));
 	}
 
-	static const size_t RECEIVE_SIZE = 1024;
-	char msg[RECEIVE_SIZE];
+	size_t size = body.Size();
+	const char *data = body.Data().data();
+	size_t written = 0;
+	while (written != size) {
+		ssize_t len = ::write(memoryFd, data + written, size - written);
+		if (len == -1) {
+			Result result = Result::CreateError("send descriptor error [%s]",::strerror(errno));
+			::close(memoryFd);
+			return result;
+		}
+		written += static_cast<size_t>(len);
+	}
+	if (::fcntl(memoryFd, F_ADD_SEALS, DESCRIPTOR_SEALS | F_SEAL_SEAL) == -1) {
+		Result result = Result::CreateError("send descriptor error [%s]",::strerror(errno));
+		::close(memoryFd);
+		return result;
+	}
 
-	ssize_t len = 0;
-	len = ::recvfrom(m_rxSocketFd, msg, RECEIVE_SIZE, 0, NULL, NULL);
-	if (len == -1 || len != sizeof(ProtocolHeader)) {
-		return Result::CreateError("receive protocol header error [%s]",::strerror(errno));
+	autotune(socketFd, sizeof(FrameHeader) + header.Size());
+	FrameHeader fh;
+	setFrameHeader(fh, frame, FRAME_BODY_IN_DESCRIPTOR, header.Size(), size);
+	if (m_isChecksum) {
+		setChecksum(fh, header, body);
 	}
 
-	ProtocolHeader ph;
-	::memcpy(&ph, msg, sizeof(ProtocolHeader));
+	iovec iov[2];
+	iov[0].iov_base = &fh;
+	iov[0].iov_len  = sizeof(FrameHeader);
+	iov[1].iov_base = const_cast<char *>(header.Data().data());
+	iov[1].iov_len  = header.Size();
 
-	if (ph.hexspeak[0] != 0xDE
-	 || ph.hexspeak[1] != 0xAD
-	 || ph.hexspeak[2] != 0xC0
-	 || ph.hexspeak[3] != 0xDE
-	) {
-		return Result::CreateError("receive protocol header error [%s:0x%02X%02X%02X%02X]"
-				,"invalid hexspeak",
-				ph.hexspeak[0], ph.hexspeak[1], ph.hexspeak[2], ph.hexspeak[3]);
-	}
+	DescriptorControl control;
+	::memset(&control, 0, sizeof(control));
 
-	if (0 < m_limitSize && m_limitSize < ph.size) {
-		return Result::CreateError("receive protocol header error [%s:%lu]"
-				,"body too big size", ph.size);
-	}
+	msghdr msg;
+	::memset(&msg, 0, sizeof(msg));
+	msg.msg_name	   = const_cast<sockaddr_un *>(address);
+	msg.msg_namelen	   = addressSize(address);
+	msg.msg_iov		   = iov;
+	msg.msg_iovlen	   = 2;
+	msg.msg_control	   = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
 
-	len = ::recvfrom(m_rxSocketFd, msg, RECEIVE_SIZE, 0, NULL, NULL);
-	if (len == -1 || len > 512) {
-		return Result::CreateError("receive application header error [%s]",::strerror(errno));
+	cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type	 = SCM_RIGHTS;
+	cmsg->cmsg_len	 = CMSG_LEN(sizeof(int));
+	::memcpy(CMSG_DATA(cmsg), &memoryFd, sizeof(int));
+
+	ssize_t sentSize = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+	while (sentSize == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+		sentSize = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+	}
+	Result result;
+	if (sentSize != static_cast<ssize_t>(sizeof(FrameHeader) + header.Size())) {
+		result = Result::CreateError("send descriptor error [%s]",::strerror(errno));
 	}
-	outHeader = ByteBuffer(msg, len, len);
+	// The receiver holds its own reference to the memfd
+	::close(memoryFd);
+	return result;
+}
 
-	unsigned long rsize = ph.size;
-	char *req = msg;
-	bool isAllocate = false;
-	if (rsize > RECEIVE_SIZE) {
-		req = new char[rsize];
-		isAllocate = true;
+Result UnixDomainSocket::SendBatch(const std::vector<MessageBuffer> &messages)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("send socket error [%s]","socket closed");
 	}
 
-	// receive divided data
-	size_t rxSize = 0;
-	size_t receiveSize = 0;
-	while (rxSize != rsize) {
-		receiveSize = rsize - rxSize;
-		if (receiveSize > RECEIVE_SIZE) {
-			receiveSize = RECEIVE_SIZE;
-		}
-		len = ::read(m_rxSocketFd, req + rxSize, receiveSize);
-		if (len == -1) {
-			if (isAllocate) {
-				delete [] req;
-			}
-			return Result::CreateError("receive body error [%s]",::strerror(errno));
+	if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+		if (m_txSocketFd == -1) {
+			return Result::CreateError("send socket error [%s]","not connected");
 		}
-		rxSize += static_cast<size_t>(len);
+		return sendBatch(m_txSocketFd, NULL, messages);
 	}
+	return sendBatch(m_txSocketFd, &m_txAddress, messages);
+}
 
-	outBody = ByteBuffer(req, rsize);
-	if (isAllocate) {
-		delete [] req;
+Result UnixDomainSocket::SendBatch(int socketFd, const std::vector<MessageBuffer> &messages, bool &outIsTimedOut)
+{
+	outIsTimedOut = false;
+	if (!IsOpend()) {
+		return Result::CreateError("send socket error [%s]","socket closed");
 	}
 
-	return Result::CreateSuccess();
+	m_isSendTimedOut = false;
+	Result result = sendBatch(socketFd, NULL, messages);
+	outIsTimedOut = result.IsError() && m_isSendTimedOut;
+	return result;
 }
 
-void UnixDomainSocket::SetLimitSize(unsigned int limit)
+// Batch transmission procedure
+// 1. Gather the following messages that fit a datagram (at most MAX_BATCH_MESSAGES)
+// 2. Send them with sendmmsg (io_uring: one io_uring_enter)
+// 3. A message that does not fit is sent fragmented, then continue with 1.
+Result UnixDomainSocket::sendBatch(int socketFd, const sockaddr_un *address, const std::vector<MessageBuffer> &messages)
 {
-	m_limitSize = limit;
-}
+	if (m_framingMode == FRAMING_FRAGMENTED) {
+		for (size_t i = 0; i < messages.size(); i++) {
+			Result result = sendMessage(socketFd, address, messages[i].frame, *messages[i].header, *messages[i].body);
+			if (result.IsError()) {
+				return result;
+			}
+		}
+		return Result::CreateSuccess();
+	}
 
-unsigned int UnixDomainSocket::LimitSize()
-{
+	FrameHeader fh[MAX_BATCH_MESSAGES];
+	iovec iov[MAX_BATCH_MESSAGES * 3];
+	mmsghdr msgs[MAX_BATCH_MESSAGES];
+	size_t indexes[MAX_BATCH_MESSAGES]; // messages[] of msgs[]
+	size_t next = 0;
+	while (next < messages.size()) {
+		size_t count = 0;
+		size_t batchSize = 0;
+		bool isSingle = false;
+		while (next < messages.size() && count < MAX_BATCH_MESSAGES) {
+			const ByteBuffer &header = *messages[next].header;
+			const ByteBuffer &body = *messages[next].body;
+			size_t total = sizeof(FrameHeader) + header.Size() + body.Size();
+			if (checkMessage(header, body).IsError() || total > m_maxDatagramSize
+			 || (0 < m_descriptorThreshold && m_descriptorThreshold <= body.Size())) {
+				isSingle = true;
+				break;
+			}
+
+			setFrameHeader(fh[count], messages[next].frame, 0, header.Size(), body.Size());
+			if (m_isChecksum) {
+				setChecksum(fh[count], header, body);
+			}
+
+			iovec *part = &iov[count * 3];
+			part[0].iov_base = &fh[count];
+			part[0].iov_len  = sizeof(FrameHeader);
+			part[1].iov_base = const_cast<char *>(header.Data().data());
+			part[1].iov_len  = header.Size();
+			part[2].iov_base = const_cast<char *>(body.Data().data());
+			part[2].iov_len  = body.Size();
+
+			::memset(&msgs[count], 0, sizeof(mmsghdr));
+			msgs[count].msg_hdr.msg_name	= const_cast<sockaddr_un *>(address);
+			msgs[count].msg_hdr.msg_namelen = addressSize(address);
+			msgs[count].msg_hdr.msg_iov		= part;
+			msgs[count].msg_hdr.msg_iovlen	= 3;
+			indexes[count] = next;
+			batchSize += total;
+			count++;
+			next++;
+		}
+		if (count > 0) {
+			autotune(socketFd, batchSize);
+		}
+
+		size_t sent = 0;
+		while (sent < count) {
+			int ret = sendDatagrams(socketFd, msgs + sent, count - sent);
+			if (ret != -1) {
+				sent += static_cast<size_t>(ret);
+				continue;
+			}
+			if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(socketFd)) {
+				continue;
+			}
+			if (errno != EMSGSIZE) {
+				return Result::CreateError("send datagram error [%s]",::strerror(errno));
+			}
+			// The kernel refused the size, do not try it again and fragment the message
+			const MessageBuffer &message = messages[indexes[sent]];
+			m_maxDatagramSize = refusedDatagramSize(socketFd, sizeof(FrameHeader) + message.header->Size() + message.body->Size());
+			Result result = sendFragmented(socketFd, address, message.frame, *message.header, *message.body, m_maxDatagramSize);
+			if (result.IsError()) {
+				return result;
+			}
+			sent++;
+		}
+
+		if (isSingle) {
+			// Fragmented or passed by descriptor, or the error of the message
+			Result result = sendMessage(socketFd, address, messages[next].frame, *messages[next].header, *messages[next].body);
+			if (result.IsError()) {
+				return result;
+			}
+			next++;
+		}
+	}
+	return Result::CreateSuccess();
+}
+
+// Datagrams of a batch not decoded yet
+struct UnixDomainSocket::ReceivedDatagrams
+{
+	mmsghdr *messages;
+	size_t index;
+	size_t count;
+};
+
+// Descriptor passed with a received datagram (-1: none), the others are closed
+static int receivedDescriptor(msghdr &msg)
+{
+	int descriptor = -1;
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < count; i++) {
+			int fd = -1;
+			::memcpy(&fd, CMSG_DATA(cmsg) + sizeof(int) * i, sizeof(int));
+			if (descriptor == -1) {
+				descriptor = fd;
+			} else {
+				::close(fd);
+			}
+		}
+	}
+	return descriptor;
+}
+
+// Map the body of a memfd passed by sendDescriptor() (outData is NULL for an empty body)
+static Result mapDescriptor(int descriptor, unsigned int size, void *&outData)
+{
+	outData = NULL;
+	if (descriptor == -1) {
+		return Result::CreateError("receive descriptor error [%s]","no descriptor");
+	}
+
+	// Without the seals the sender could shrink the memfd while it is mapped (SIGBUS)
+	int seals = ::fcntl(descriptor, F_GET_SEALS);
+	if (seals == -1 || (seals & DESCRIPTOR_SEALS) != DESCRIPTOR_SEALS) {
+		return Result::CreateError("receive descriptor error [%s]","descriptor not sealed");
+	}
+
+	struct stat status;
+	if (::fstat(descriptor, &status) == -1 || status.st_size < static_cast<off_t>(size)) {
+		return Result::CreateError("receive descriptor error [%s:%u]","invalid descriptor size", size);
+	}
+
+	if (size == 0) {
+		return Result::CreateSuccess();
+	}
+
+	void *data = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, descriptor, 0);
+	if (data == MAP_FAILED) {
+		return Result::CreateError("receive descriptor error [%s]",::strerror(errno));
+	}
+	outData = data;
+	return Result::CreateSuccess();
+}
+
+// Read the body from a memfd passed by sendDescriptor()
+// The body is copied out of the mapping, the mapping does not outlive the call
+static Result readDescriptor(int descriptor, unsigned int size, ByteBuffer &outBody)
+{
+	void *data = NULL;
+	Result result = mapDescriptor(descriptor, size, data);
+	if (result.IsError()) {
+		return result;
+	}
+	if (data == NULL) {
+		outBody.Clear();
+		return result;
+	}
+	outBody.Assign(static_cast<const char *>(data), size);
+	::munmap(data, size);
+	return result;
+}
+
+// Decode a received datagram
+// descriptor: Descriptor passed with the datagram (-1: none)
+// outFrame: Frame of the message (NULL: not needed)
+// outMapping: receives the mapping of a body passed by descriptor, outBody is emptied
+//             (NULL: the body is copied into outBody)
+// outSize: body size of the message
+// outIsFragmented: the datagram only starts a fragmented message, header and body follow
+// fh: a ProtocolHeader is converted to the FrameHeader of the same message
+static Result decodeDatagram(FrameHeader &fh, const char *payload, ssize_t len, int flags, unsigned int limitSize
+	, int descriptor, UnixDomainSocket::Frame *outFrame, ByteBuffer &outHeader, ByteBuffer &outBody
+	, void **outMapping, unsigned int &outSize, bool &outIsFragmented)
+{
+	outIsFragmented = false;
+	if (len < static_cast<ssize_t>(sizeof(ProtocolHeader))) {
+		return Result::CreateError("receive protocol header error [%s:%ld]"
+				,"invalid datagram size", static_cast<long>(len));
+	}
+
+	if (!isHexspeak(fh.hexspeak)) {
+		return Result::CreateError("receive protocol header error [%s:0x%02X%02X%02X%02X]"
+				,"invalid hexspeak",
+				fh.hexspeak[0], fh.hexspeak[1], fh.hexspeak[2], fh.hexspeak[3]);
+	}
+
+	if (len == static_cast<ssize_t>(sizeof(ProtocolHeader))) {
+		// Fragmented message without Frame
+		ProtocolHeader ph;
+		::memcpy(&ph, &fh, sizeof(ProtocolHeader));
+		if (0 < limitSize && limitSize < ph.size) {
+			return Result::CreateError("receive protocol header error [%s:%u]"
+					,"body too big size", ph.size);
+		}
+		setFrameHeader(fh, NULL, FRAME_FRAGMENTED, 0, ph.size);
+		if (outFrame != NULL) {
+			::memset(outFrame, 0, sizeof(UnixDomainSocket::Frame));
+		}
+		outSize = ph.size;
+		outIsFragmented = true;
+		return Result::CreateSuccess();
+	}
+
+	if (len < static_cast<ssize_t>(sizeof(FrameHeader))) {
+		return Result::CreateError("receive datagram error [%s:%ld]"
+				,"invalid datagram size", static_cast<long>(len));
+	}
+
+	if (fh.version != FRAME_VERSION) {
+		return Result::CreateError("receive protocol header error [%s:%u]"
+				,"unsupported frame version", static_cast<unsigned int>(fh.version));
+	}
+
+	// The Frame is set from here on, also when the message fails (the receiver can fail its request)
+	if (outFrame != NULL) {
+		outFrame->type			= fh.type;
+		outFrame->flags			= fh.flags;
+		outFrame->correlationId = fh.correlationId;
+	}
+
+	if (0 < limitSize && limitSize < fh.size) {
+		return Result::CreateError("receive protocol header error [%s:%u]"
+				,"body too big size", fh.size);
+	}
+	outSize = fh.size;
+
+	if (fh.control & FRAME_FRAGMENTED) {
+		if (len != static_cast<ssize_t>(sizeof(FrameHeader))) {
+			return Result::CreateError("receive datagram error [%s:%ld]"
+					,"invalid datagram size", static_cast<long>(len));
+		}
+		outIsFragmented = true;
+		return Result::CreateSuccess();
+	}
+
+	if (flags & MSG_TRUNC) {
+		return Result::CreateError("receive datagram error [%s:%ld]"
+				,"datagram truncated", static_cast<long>(len));
+	}
+
+	bool isDescriptor = (fh.control & FRAME_BODY_IN_DESCRIPTOR) != 0;
+	size_t headerSize = fh.headerSize;
+	size_t bodySize = (isDescriptor ? 0 : static_cast<size_t>(fh.size));
+	size_t payloadSize = static_cast<size_t>(len) - sizeof(FrameHeader);
+	if (headerSize > MAX_HEADER_SIZE
+	 || payloadSize != headerSize + bodySize) {
+		return Result::CreateError("receive datagram error [%s:%ld]"
+				,"invalid datagram size", static_cast<long>(len));
+	}
+
+	outHeader.Assign(payload, headerSize);
+	if (isDescriptor && outMapping != NULL) {
+		void *data = NULL;
+		Result result = mapDescriptor(descriptor, fh.size, data);
+		if (result.IsError()) {
+			return result;
+		}
+		outBody.Clear();
+		result = verifyChecksum(fh, outHeader, static_cast<const char *>(data), fh.size);
+		if (result.IsError()) {
+			if (data != NULL) {
+				::munmap(data, fh.size);
+			}
+			return result;
+		}
+		*outMapping = data;
+		return result;
+	}
+	if (isDescriptor) {
+		Result result = readDescriptor(descriptor, fh.size, outBody);
+		if (result.IsError()) {
+			return result;
+		}
+	} else {
+		outBody.Assign(payload + headerSize, fh.size);
+	}
+
+	return verifyChecksum(fh, outHeader, outBody);
+}
+
+// A fragmented message is followed by its header datagram unless a FrameHeader says the header is empty
+// (fh of a ProtocolHeader has been normalized by decodeDatagram())
+static bool isHeaderSent(const FrameHeader &fh, ssize_t len)
+{
+	return len == static_cast<ssize_t>(sizeof(ProtocolHeader)) || fh.headerSize > 0;
+}
+
+// Reception procedure
+// 1. Receive one datagram
+// 2. FrameHeader + header + body: the whole message has been received
+//    FrameHeader (FRAME_FRAGMENTED) or ProtocolHeader only: receive header and divided body (fragmented)
+Result UnixDomainSocket::Receive(ByteBuffer &outHeader, ByteBuffer &outBody)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	bool isClosed = false;
+	Result result = receiveMessage(m_rxSocketFd, NULL, outHeader, outBody, NULL, isClosed);
+	if (isClosed) {
+		// The connection partner closed the connection, it can not be used any more
+		m_isOpend = false;
+	}
+	return result;
+}
+
+Result UnixDomainSocket::Receive(Frame &outFrame, ByteBuffer &outHeader, ByteBuffer &outBody)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	bool isClosed = false;
+	Result result = receiveMessage(m_rxSocketFd, &outFrame, outHeader, outBody, NULL, isClosed);
+	if (isClosed) {
+		// The connection partner closed the connection, it can not be used any more
+		m_isOpend = false;
+	}
+	return result;
+}
+
+Result UnixDomainSocket::Receive(Frame &outFrame, ByteBuffer &outHeader, MappedBody &outBody)
+{
+	outBody.Release();
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	// A body passed by descriptor is mapped into outBody, the others are copied into it
+	bool isClosed = false;
+	Result result = receiveMessage(m_rxSocketFd, &outFrame, outHeader, outBody.m_body, &outBody, isClosed);
+	if (isClosed) {
+		// The connection partner closed the connection, it can not be used any more
+		m_isOpend = false;
+	}
+	return result;
+}
+
+UnixDomainSocket::MappedBody::MappedBody()
+	: m_mapping(NULL)
+	, m_mappingSize(0)
+	, m_body()
+{
+}
+
+UnixDomainSocket::MappedBody::~MappedBody()
+{
+	Release();
+}
+
+const char *UnixDomainSocket::MappedBody::Data() const
+{
+	if (m_mapping != NULL) {
+		return static_cast<const char *>(m_mapping);
+	}
+	return m_body.Data().data();
+}
+
+size_t UnixDomainSocket::MappedBody::Size() const
+{
+	if (m_mapping != NULL) {
+		return m_mappingSize;
+	}
+	return m_body.Size();
+}
+
+bool UnixDomainSocket::MappedBody::IsMapped() const
+{
+	return m_mapping != NULL;
+}
+
+void UnixDomainSocket::MappedBody::Release()
+{
+	if (m_mapping != NULL) {
+		::munmap(m_mapping, m_mappingSize);
+		m_mapping = NULL;
+		m_mappingSize = 0;
+	}
+	m_body.Clear();
+}
+
+void UnixDomainSocket::MappedBody::assign(void *mapping, size_t size)
+{
+	Release();
+	m_mapping = mapping;
+	m_mappingSize = size;
+}
+
+Result UnixDomainSocket::Receive(int socketFd, ByteBuffer &outHeader, ByteBuffer &outBody, bool &outIsClosed)
+{
+	outIsClosed = false;
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	return receiveMessage(socketFd, NULL, outHeader, outBody, NULL, outIsClosed);
+}
+
+Result UnixDomainSocket::Receive(int socketFd, Frame &outFrame, ByteBuffer &outHeader, ByteBuffer &outBody, bool &outIsClosed)
+{
+	outIsClosed = false;
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	return receiveMessage(socketFd, &outFrame, outHeader, outBody, NULL, outIsClosed);
+}
+
+Result UnixDomainSocket::receiveMessage(int socketFd, Frame *outFrame, ByteBuffer &outHeader, ByteBuffer &outBody, MappedBody *outMapped, bool &outIsClosed)
+{
+	if (m_heldSize > 0 && m_heldSocketFd == socketFd) {
+		return receiveHeld(socketFd, outFrame, outHeader, outBody);
+	}
+
+	if (m_uring != NULL && socketFd == m_rxSocketFd) {
+		// io_uring receives as a batch of one message
+		m_singleBuffer.resize(1);
+		m_singleBuffer[0].frame = outFrame;
+		m_singleBuffer[0].header = &outHeader;
+		m_singleBuffer[0].body = &outBody;
+		m_singleBuffer[0].mapped = outMapped;
+		size_t count = 0;
+		return receiveBatch(socketFd, m_singleBuffer, count, outIsClosed);
+	}
+
+	if (m_receiveBufferSize < m_maxReceiveSize) {
+		delete [] m_receiveBuffer;
+		m_receiveBuffer = new char[m_maxReceiveSize];
+		m_receiveBufferSize = m_maxReceiveSize;
+	}
+
+	FrameHeader fh;
+	iovec iov[2];
+	iov[0].iov_base = &fh;
+	iov[0].iov_len  = sizeof(FrameHeader);
+	iov[1].iov_base = m_receiveBuffer;
+	iov[1].iov_len  = m_receiveBufferSize;
+
+	DescriptorControl control;
+
+	msghdr msg;
+	::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov		   = iov;
+	msg.msg_iovlen	   = 2;
+	msg.msg_control	   = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+
+	ssize_t len = -1;
+	while (true) {
+		bool isReceived = false;
+		if (m_busyPollTime > 0) {
+			// Spin without blocking, the message is taken without waking up from a sleep
+			timespec start;
+			::clock_gettime(CLOCK_MONOTONIC, &start);
+			do {
+				msg.msg_controllen = sizeof(control.buffer);
+				len = ::recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT | MSG_TRUNC);
+				isReceived = (len != -1 || (errno != EAGAIN && errno != EWOULDBLOCK));
+			} while (!isReceived && IsBusyPollTime(start));
+			CountBusyPoll(isReceived);
+		}
+		if (!isReceived) {
+			// Block in poll so that Wakeup() can interrupt the wait
+			msg.msg_controllen = sizeof(control.buffer);
+			len = ::recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT | MSG_TRUNC);
+			while (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitReadable(socketFd)) {
+				msg.msg_controllen = sizeof(control.buffer);
+				len = ::recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT | MSG_TRUNC);
+			}
+		}
+		if (len == 0 && m_socketMode == SOCKET_MODE_SEQPACKET) {
+			outIsClosed = true;
+			return Result::CreateError("receive socket error [%s]","connection closed");
+		}
+		if (len == -1) {
+			return Result::CreateError("receive protocol header error [%s]",::strerror(errno));
+		}
+		if (isMessageStart(fh, m_receiveBuffer, len, msg.msg_flags, false)) {
+			break;
+		}
+		// The rest of a broken message
+		int descriptor = receivedDescriptor(msg);
+		if (descriptor != -1) {
+			::close(descriptor);
+		}
+		countResync();
+	}
+
+	if ((msg.msg_flags & MSG_TRUNC) && len > static_cast<ssize_t>(sizeof(FrameHeader))) {
+		// Lost, the next datagram of this size fits (len is the size before truncation)
+		growReceiveSize(static_cast<size_t>(len) - sizeof(FrameHeader));
+	}
+
+	int descriptor = receivedDescriptor(msg);
+	unsigned int size = 0;
+	bool isFragmented = false;
+	void *mapping = NULL;
+	Result result = decodeDatagram(fh, m_receiveBuffer, len, msg.msg_flags, m_limitSize, descriptor
+			, outFrame, outHeader, outBody, (outMapped != NULL ? &mapping : NULL), size, isFragmented);
+	if (descriptor != -1) {
+		// The mapping stays valid without the descriptor
+		::close(descriptor);
+	}
+	if (mapping != NULL) {
+		outMapped->assign(mapping, size);
+	}
+	if (result.IsError() || !isFragmented) {
+		return result;
+	}
+	result = receiveFragmented(socketFd, NULL, isHeaderSent(fh, len), size, outHeader, outBody);
+	if (result.IsError()) {
+		return result;
+	}
+	return verifyChecksum(fh, outHeader, outBody);
+}
+
+Result UnixDomainSocket::receiveHeld(int socketFd, Frame *outFrame, ByteBuffer &outHeader, ByteBuffer &outBody)
+{
+	// Receiving the rest of the message may hold another datagram
+	FrameHeader fh;
+	::memcpy(&fh, m_heldDatagram, sizeof(FrameHeader));
+	ssize_t len = static_cast<ssize_t>(m_heldSize);
+	m_heldSize = 0;
+
+	unsigned int size = 0;
+	bool isFragmented = false;
+	Result result = decodeDatagram(fh, m_heldDatagram + sizeof(FrameHeader), len, 0, m_limitSize, -1
+			, outFrame, outHeader, outBody, NULL, size, isFragmented);
+	if (result.IsError() || !isFragmented) {
+		return result;
+	}
+	result = receiveFragmented(socketFd, NULL, isHeaderSent(fh, len), size, outHeader, outBody);
+	if (result.IsError()) {
+		return result;
+	}
+	return verifyChecksum(fh, outHeader, outBody);
+}
+
+Result UnixDomainSocket::ReceiveBatch(const std::vector<MessageBuffer> &buffers, size_t &outCount)
+{
+	outCount = 0;
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	bool isClosed = false;
+	Result result = receiveBatch(m_rxSocketFd, buffers, outCount, isClosed);
+	if (isClosed) {
+		// The connection partner closed the connection, it can not be used any more
+		m_isOpend = false;
+	}
+	return result;
+}
+
+Result UnixDomainSocket::ReceiveBatch(int socketFd, const std::vector<MessageBuffer> &buffers, size_t &outCount, bool &outIsClosed)
+{
+	outCount = 0;
+	outIsClosed = false;
+	if (!IsOpend()) {
+		return Result::CreateError("receive socket error [%s]","socket closed");
+	}
+
+	return receiveBatch(socketFd, buffers, outCount, outIsClosed);
+}
+
+// Batch reception procedure
+// 1. Receive the waiting datagrams with one recvmmsg (blocks until the first one)
+// 2. Decode them in order, the datagrams following a FrameHeader (FRAME_FRAGMENTED) or ProtocolHeader only datagram
+//    are the header and body of a fragmented message (the rest is read from the socket)
+// 3. Datagrams that can not start a message are discarded, receive again when nothing is left
+Result UnixDomainSocket::receiveBatch(int socketFd, const std::vector<MessageBuffer> &buffers, size_t &outCount, bool &outIsClosed)
+{
+	size_t maxCount = buffers.size();
+	if (maxCount > MAX_BATCH_MESSAGES) {
+		maxCount = MAX_BATCH_MESSAGES;
+	}
+	if (maxCount == 0) {
+		return Result::CreateSuccess();
+	}
+
+	if (m_heldSize > 0 && m_heldSocketFd == socketFd) {
+		const MessageBuffer &buffer = buffers[0];
+		Result result = receiveHeld(socketFd, buffer.frame, *buffer.header, *buffer.body);
+		if (result.IsSuccess()) {
+			outCount = 1;
+		}
+		return result;
+	}
+
+	if (m_receiveBufferSize < m_maxReceiveSize) {
+		delete [] m_receiveBuffer;
+		m_receiveBuffer = new char[m_maxReceiveSize];
+		m_receiveBufferSize = m_maxReceiveSize;
+	}
+
+	// The pages of a slot are touched only as far as the datagram reaches
+	size_t slotSize = sizeof(FrameHeader) + m_receiveBufferSize;
+	if (m_batchBufferSize < slotSize * maxCount) {
+		delete [] m_batchBuffer;
+		m_batchBuffer = new char[slotSize * maxCount];
+		m_batchBufferSize = slotSize * maxCount;
+	}
+
+	iovec iov[MAX_BATCH_MESSAGES];
+	DescriptorControl controls[MAX_BATCH_MESSAGES];
+	mmsghdr msgs[MAX_BATCH_MESSAGES];
+	int bufferIds[MAX_BATCH_MESSAGES];
+	int descriptors[MAX_BATCH_MESSAGES];
+	Result result;
+	while (outCount == 0 && result.IsSuccess() && !outIsClosed) {
+		::memset(msgs, 0, sizeof(mmsghdr) * maxCount);
+		for (size_t i = 0; i < maxCount; i++) {
+			iov[i].iov_base = m_batchBuffer + slotSize * i;
+			iov[i].iov_len  = slotSize;
+			msgs[i].msg_hdr.msg_iov		   = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen	   = 1;
+			msgs[i].msg_hdr.msg_control	   = controls[i].buffer;
+			msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+		}
+
+		int ret = receiveDatagrams(socketFd, msgs, iov, bufferIds, maxCount);
+		if (ret == -1) {
+			return Result::CreateError("receive protocol header error [%s]",::strerror(errno));
+		}
+
+		// Take the descriptors of all datagrams, they are closed whatever happens
+		for (int i = 0; i < ret; i++) {
+			descriptors[i] = receivedDescriptor(msgs[i].msg_hdr);
+		}
+
+		ReceivedDatagrams pending;
+		pending.messages = msgs;
+		pending.index = 0;
+		pending.count = static_cast<size_t>(ret);
+		if (m_socketMode == SOCKET_MODE_SEQPACKET) {
+			// An empty datagram is the end of the connection
+			for (size_t i = 0; i < pending.count; i++) {
+				if (msgs[i].msg_len == 0) {
+					pending.count = i;
+					outIsClosed = true;
+					break;
+				}
+			}
+		}
+
+		if (outIsClosed && pending.count == 0) {
+			result = Result::CreateError("receive socket error [%s]","connection closed");
+		}
+		// A failed message does not stop the others, the next message starts a new datagram
+		while (pending.index < pending.count) {
+			size_t index = pending.index++;
+			const mmsghdr &msg = msgs[index];
+			const char *data = static_cast<const char *>(msg.msg_hdr.msg_iov->iov_base);
+			FrameHeader fh;
+			::memcpy(&fh, data, sizeof(FrameHeader));
+			ssize_t len = static_cast<ssize_t>(msg.msg_len);
+			if (!isMessageStart(fh, data + sizeof(FrameHeader), len, msg.msg_hdr.msg_flags, false)) {
+				// The rest of a broken message
+				countResync();
+				continue;
+			}
+			if ((msg.msg_hdr.msg_flags & MSG_TRUNC) && len > static_cast<ssize_t>(sizeof(FrameHeader))) {
+				growReceiveSize(static_cast<size_t>(len) - sizeof(FrameHeader));
+			}
+
+			const MessageBuffer &buffer = buffers[outCount];
+			unsigned int size = 0;
+			bool isFragmented = false;
+			void *mapping = NULL;
+			if (buffer.mapped != NULL) {
+				buffer.mapped->Release();
+			}
+			Result decoded = decodeDatagram(fh, data + sizeof(FrameHeader), len
+					, msg.msg_hdr.msg_flags, m_limitSize, descriptors[index]
+					, buffer.frame, *buffer.header, *buffer.body, (buffer.mapped != NULL ? &mapping : NULL)
+					, size, isFragmented);
+			if (mapping != NULL) {
+				buffer.mapped->assign(mapping, size);
+			}
+			if (decoded.IsSuccess() && isFragmented) {
+				decoded = receiveFragmented(socketFd, &pending, isHeaderSent(fh, len), size, *buffer.header, *buffer.body);
+				if (decoded.IsSuccess()) {
+					decoded = verifyChecksum(fh, *buffer.header, *buffer.body);
+				}
+			}
+			if (decoded.IsError()) {
+				if (result.IsSuccess()) {
+					result = decoded;
+				}
+				continue;
+			}
+			outCount++;
+		}
+
+		for (int i = 0; i < ret; i++) {
+			if (descriptors[i] != -1) {
+				::close(descriptors[i]);
+			}
+		}
+		if (m_uring != NULL) {
+			m_uring->Release(bufferIds, ret);
+		}
+	}
+	return result;
+}
+
+int UnixDomainSocket::sendDatagrams(int socketFd, mmsghdr *msgs, size_t count)
+{
+	if (m_sendUring != NULL && socketFd == m_txSocketFd) {
+		int ret = m_sendUring->Send(socketFd, msgs, count);
+		if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			// io_uring does not wait for room (poll does not tell the room of an unconnected
+			// partner either): the first datagram waits in sendmsg, the next call goes on
+			ssize_t len = ::sendmsg(socketFd, &msgs[0].msg_hdr, MSG_NOSIGNAL);
+			if (len == -1) {
+				return -1;
+			}
+			msgs[0].msg_len = static_cast<unsigned int>(len);
+			return 1;
+		}
+		return ret;
+	}
+	return ::sendmmsg(socketFd, msgs, count, MSG_NOSIGNAL);
+}
+
+int UnixDomainSocket::receiveDatagrams(int socketFd, mmsghdr *msgs, iovec *iov, int *outBufferIds, size_t maxCount)
+{
+	bool isUring = (m_uring != NULL && socketFd == m_rxSocketFd);
+	int ret = -1;
+	bool isReceived = false;
+	if (m_busyPollTime > 0) {
+		// Spin without blocking, the messages are taken without waking up from a sleep
+		// (io_uring: the completion ring is checked without system calls)
+		timespec start;
+		::clock_gettime(CLOCK_MONOTONIC, &start);
+		do {
+			if (isUring) {
+				ret = m_uring->Receive(msgs, iov, outBufferIds, maxCount, false);
+				isReceived = (ret != 0);
+			} else {
+				ret = ::recvmmsg(socketFd, msgs, maxCount, MSG_WAITFORONE | MSG_CMSG_CLOEXEC | MSG_DONTWAIT | MSG_TRUNC, NULL);
+				isReceived = (ret != -1 || (errno != EAGAIN && errno != EWOULDBLOCK));
+			}
+		} while (!isReceived && IsBusyPollTime(start));
+		CountBusyPoll(isReceived);
+	}
+	if (!isReceived) {
+		if (isUring) {
+			ret = m_uring->Receive(msgs, iov, outBufferIds, maxCount, true);
+		} else {
+			// Block in poll so that Wakeup() can interrupt the wait
+			do {
+				for (size_t i = 0; i < maxCount; i++) {
+					msgs[i].msg_hdr.msg_controllen = sizeof(DescriptorControl);
+				}
+				ret = ::recvmmsg(socketFd, msgs, maxCount, MSG_WAITFORONE | MSG_CMSG_CLOEXEC | MSG_DONTWAIT | MSG_TRUNC, NULL);
+			} while (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitReadable(socketFd));
+		}
+	}
+	if (!isUring) {
+		for (size_t i = 0; i < maxCount; i++) {
+			outBufferIds[i] = -1;
+		}
+	}
+	return ret;
+}
+
+ssize_t UnixDomainSocket::readDatagram(int socketFd, ReceivedDatagrams *pending, char *buffer, size_t size)
+{
+	if ((pending == NULL || pending->index >= pending->count) && m_uring != NULL && socketFd == m_rxSocketFd) {
+		// Every datagram of the socket goes through io_uring, a direct recv would overtake it
+		mmsghdr msg;
+		iovec iov;
+		int bufferId = -1;
+		int ret = m_uring->Receive(&msg, &iov, &bufferId, 1, true);
+		if (ret == -1) {
+			return -1;
+		}
+		int descriptor = receivedDescriptor(msg.msg_hdr);
+		if (descriptor != -1) {
+			::close(descriptor);
+		}
+		// iov_len: the part of a truncated datagram in the buffer
+		size_t len = iov.iov_len;
+		if (len > size) {
+			len = size;
+		}
+		::memcpy(buffer, iov.iov_base, len);
+		m_uring->Release(&bufferId, 1);
+		if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+		return static_cast<ssize_t>(len);
+	}
+	if (pending == NULL || pending->index >= pending->count) {
+		ssize_t len = ::recv(socketFd, buffer, size, MSG_DONTWAIT);
+		while (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitReadable(socketFd)) {
+			len = ::recv(socketFd, buffer, size, MSG_DONTWAIT);
+		}
+		return len;
+	}
+
+	const mmsghdr &msg = pending->messages[pending->index++];
+	if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+		// msg_len is the size before truncation
+		errno = EMSGSIZE;
+		return -1;
+	}
+	size_t len = msg.msg_len;
+	if (len > size) {
+		len = size;
+	}
+	::memcpy(buffer, msg.msg_hdr.msg_iov->iov_base, len);
+	return static_cast<ssize_t>(len);
+}
+
+Result UnixDomainSocket::receiveFragmented(int socketFd, ReceivedDatagrams *pending, bool isHeaderSent, unsigned int size, ByteBuffer &outHeader, ByteBuffer &outBody)
+{
+	ssize_t len = 0;
+	bool isPending = false;
+	outHeader.Clear();
+	if (isHeaderSent) {
+		isPending = (pending != NULL && pending->index < pending->count);
+		len = readDatagram(socketFd, pending, m_receiveBuffer, m_receiveBufferSize);
+		if (len == -1) {
+			return Result::CreateError("receive application header error [%s]",::strerror(errno));
+		}
+		// A message start is larger than any application header, check it first
+		if (holdMessageStart(socketFd, pending, isPending, m_receiveBuffer, len)) {
+			return Result::CreateError("receive application header error [%s]","datagram lost");
+		}
+		if (len > static_cast<ssize_t>(MAX_HEADER_SIZE)) {
+			return Result::CreateError("receive application header error [%s]","header too large");
+		}
+		outHeader.Assign(m_receiveBuffer, len);
+	}
+
+	// The sender decides the size of each datagram
+	// Read each one whole so that a message start after a lost fragment is not cut to the rest of the body
+	size_t rsize = size;
+	char *req = outBody.Resize(rsize);
+	size_t rxSize = 0;
+	while (rxSize != rsize) {
+		isPending = (pending != NULL && pending->index < pending->count);
+		len = readDatagram(socketFd, pending, m_receiveBuffer, m_receiveBufferSize);
+		if (len <= 0) {
+			outBody.Clear();
+			return Result::CreateError("receive body error [%s]",::strerror(errno));
+		}
+		if (holdMessageStart(socketFd, pending, isPending, m_receiveBuffer, len)) {
+			outBody.Clear();
+			return Result::CreateError("receive body error [%s]","datagram lost");
+		}
+		if (static_cast<size_t>(len) > rsize - rxSize) {
+			outBody.Clear();
+			return Result::CreateError("receive body error [%s]","fragment exceeds the body");
+		}
+		::memcpy(req + rxSize, m_receiveBuffer, len);
+		rxSize += static_cast<size_t>(len);
+	}
+
+	return Result::CreateSuccess();
+}
+
+bool UnixDomainSocket::holdMessageStart(int socketFd, ReceivedDatagrams *pending, bool isPending, const char *data, ssize_t len)
+{
+	if (len < static_cast<ssize_t>(sizeof(FrameHeader))) {
+		return false;
+	}
+	FrameHeader fh;
+	::memcpy(&fh, data, sizeof(FrameHeader));
+	if (!isMessageStart(fh, data + sizeof(FrameHeader), len, 0, true)) {
+		return false;
+	}
+
+	if (isPending) {
+		// Decoded next by the batch
+		pending->index--;
+		return true;
+	}
+	if (m_heldBufferSize < static_cast<size_t>(len)) {
+		delete [] m_heldDatagram;
+		m_heldDatagram = new char[len];
+		m_heldBufferSize = static_cast<size_t>(len);
+	}
+	::memcpy(m_heldDatagram, data, len);
+	m_heldSize = static_cast<size_t>(len);
+	m_heldSocketFd = socketFd;
+	return true;
+}
+
+void UnixDomainSocket::countResync()
+{
+	// Read by other threads
+	__atomic_fetch_add(&m_resyncCount, 1, __ATOMIC_RELAXED);
+}
+
+void UnixDomainSocket::SetLimitSize(unsigned int limit)
+{
+	m_limitSize = limit;
+}
+
+unsigned int UnixDomainSocket::LimitSize()
+{
 	return m_limitSize;
 }
 
+void UnixDomainSocket::SetFramingMode(FramingMode mode)
+{
+	m_framingMode = mode;
+}
+
+UnixDomainSocket::FramingMode UnixDomainSocket::Framing()
+{
+	return m_framingMode;
+}
+
+void UnixDomainSocket::SetSendTimeout(unsigned int msec)
+{
+	m_sendTimeout = msec;
+}
+
+void UnixDomainSocket::SetUringDatagramSize(size_t size)
+{
+	m_uringDatagramSize = size;
+}
+
+size_t UnixDomainSocket::UringDatagramSize()
+{
+	return (m_uring != NULL ? m_uring->DatagramSize() : m_uringDatagramSize);
+}
+
+void UnixDomainSocket::growReceiveSize(size_t size)
+{
+	if (size > m_maxReceiveSize) {
+		m_maxReceiveSize = size;
+	}
+}
+
+bool UnixDomainSocket::waitWritable(int socketFd)
+{
+	pollfd fds;
+	fds.fd = socketFd;
+	fds.events = POLLOUT;
+	while (true) {
+		fds.revents = 0;
+		int ret = ::poll(&fds, 1, static_cast<int>(m_sendTimeout));
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (ret == 0) {
+			m_isSendTimedOut = true;
+			errno = ETIMEDOUT;
+			return false;
+		}
+		// Writable, or an error/hangup that the send reports
+		return true;
+	}
+}
+
+size_t UnixDomainSocket::MaxDatagramSize()
+{
+	return m_maxDatagramSize;
+}
+
+void UnixDomainSocket::SetDescriptorThreshold(size_t size)
+{
+	m_descriptorThreshold = size;
+}
+
+size_t UnixDomainSocket::DescriptorThreshold()
+{
+	return m_descriptorThreshold;
+}
+
+void UnixDomainSocket::SetBusyPoll(unsigned int microseconds)
+{
+	m_busyPollTime = microseconds;
+}
+
+unsigned int UnixDomainSocket::BusyPoll()
+{
+	return m_busyPollTime;
+}
+
+unsigned long UnixDomainSocket::BusyPollHits()
+{
+	return __atomic_load_n(&m_busyPollHits, __ATOMIC_RELAXED);
+}
+
+unsigned long UnixDomainSocket::BusyPollMisses()
+{
+	return __atomic_load_n(&m_busyPollMisses, __ATOMIC_RELAXED);
+}
+
+bool UnixDomainSocket::IsBusyPollTime(const timespec &start)
+{
+	timespec now;
+	::clock_gettime(CLOCK_MONOTONIC, &now);
+	long elapsed = (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000L;
+	return elapsed < static_cast<long>(m_busyPollTime);
+}
+
+void UnixDomainSocket::CountBusyPoll(bool isHit)
+{
+	// Read by other threads
+	__atomic_fetch_add(isHit ? &m_busyPollHits : &m_busyPollMisses, 1, __ATOMIC_RELAXED);
+}
+
+void UnixDomainSocket::SetChecksum(bool isEnabled)
+{
+	m_isChecksum = isEnabled;
+}
+
+bool UnixDomainSocket::IsChecksum()
+{
+	return m_isChecksum;
+}
+
+unsigned long UnixDomainSocket::ResyncCount()
+{
+	return __atomic_load_n(&m_resyncCount, __ATOMIC_RELAXED);
+}
+
+Result UnixDomainSocket::SetSendBufferSize(size_t size)
+{
+	m_sendBufferSize = size;
+	if (!IsOpend()) {
+		return Result::CreateSuccess();
+	}
+	return applyBufferSizes(m_txSocketFd, true, false);
+}
+
+size_t UnixDomainSocket::SendBufferSize()
+{
+	return bufferSize(m_txSocketFd != -1 ? m_txSocketFd : m_rxSocketFd, SO_SNDBUF);
+}
+
+Result UnixDomainSocket::SetReceiveBufferSize(size_t size)
+{
+	m_socketReceiveBufferSize = size;
+	if (!IsOpend()) {
+		return Result::CreateSuccess();
+	}
+	return applyBufferSizes(m_rxSocketFd, false, true);
+}
+
+size_t UnixDomainSocket::ReceiveBufferSize()
+{
+	return bufferSize(m_rxSocketFd, SO_RCVBUF);
+}
+
+void UnixDomainSocket::SetBufferAutotune(size_t maxSize)
+{
+	m_autotuneLimit = maxSize;
+}
+
+size_t UnixDomainSocket::BufferAutotune()
+{
+	return m_autotuneLimit;
+}
+
+size_t UnixDomainSocket::SendQueueSize()
+{
+	int queued = 0;
+	if (m_txSocketFd == -1 || ::ioctl(m_txSocketFd, SIOCOUTQ, &queued) == -1) {
+		return 0;
+	}
+	return static_cast<size_t>(queued);
+}
+
+size_t UnixDomainSocket::ReceiveQueueSize()
+{
+	int queued = 0;
+	if (m_rxSocketFd == -1 || ::ioctl(m_rxSocketFd, SIOCINQ, &queued) == -1) {
+		return 0;
+	}
+	return static_cast<size_t>(queued);
+}
+
+void UnixDomainSocket::autotune(int socketFd, size_t size)
+{
+	if (m_autotuneLimit == 0) {
+		return;
+	}
+
+	// A new peak is checked at once, the backlog from time to time (a system call)
+	size_t backlog = 0;
+	bool isCheck = false;
+	if (size > m_peakSendSize) {
+		m_peakSendSize = size;
+		isCheck = true;
+	}
+	if (++m_autotuneCount >= AUTOTUNE_INTERVAL) {
+		m_autotuneCount = 0;
+		int queued = 0;
+		if (::ioctl(socketFd, SIOCOUTQ, &queued) == 0) {
+			backlog = static_cast<size_t>(queued);
+		}
+		isCheck = true;
+	}
+	if (!isCheck) {
+		return;
+	}
+
+	size_t needed = 2 * (backlog + m_peakSendSize);
+	if (needed > m_autotuneLimit) {
+		needed = m_autotuneLimit;
+	}
+	// SO_SNDBUF reports twice the size that was set
+	size_t current = bufferSize(socketFd, SO_SNDBUF) / 2;
+	if (current == 0 || needed <= current) {
+		return;
+	}
+	// Grow in powers of 2, not a little for every message
+	size_t grown = current;
+	while (grown < needed) {
+		grown *= 2;
+	}
+	if (grown > m_autotuneLimit) {
+		grown = m_autotuneLimit;
+	}
+	setBufferSize(socketFd, SO_SNDBUF, SO_SNDBUFFORCE, grown);
+}
+
+UnixDomainSocket::SocketMode UnixDomainSocket::Mode()
+{
+	return m_socketMode;
+}
+
+UnixDomainSocket::IoEngine UnixDomainSocket::Engine()
+{
+	return (m_uring != NULL ? IO_ENGINE_URING : IO_ENGINE_SOCKET);
+}
+
+UnixDomainSocket::AddressType UnixDomainSocket::Address()
+{
+	return m_addressType;
+}
+
+int UnixDomainSocket::ReceiveSocketFd()
+{
+	return m_rxSocketFd;
+}
+
+bool UnixDomainSocket::waitReadable(int socketFd)
+{
+	pollfd fds[2];
+	fds[0].fd = socketFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = m_wakeupFd;
+	fds[1].events = POLLIN;
+	while (true) {
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		if (::poll(fds, 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (fds[1].revents & POLLIN) {
+			errno = ECANCELED;
+			return false;
+		}
+		// Readable, or an error/hangup that the reception reports
+		return true;
+	}
+}
+
+void UnixDomainSocket::Wakeup()
+{
+	uint64_t value = 1;
+	if (::write(m_wakeupFd, &value, sizeof(value)) == -1) {
+		// Already signaled as far as the counter goes
+	}
+}
+
+void UnixDomainSocket::ClearWakeup()
+{
+	uint64_t value = 0;
+	if (::read(m_wakeupFd, &value, sizeof(value)) == -1) {
+		// Not signaled
+	}
+}
+
+int UnixDomainSocket::WakeupFd()
+{
+	return m_wakeupFd;
+}
+
+int UnixDomainSocket::AcceptConnection()
+{
+	if (!IsOpend() || m_socketMode != SOCKET_MODE_SEQPACKET || !m_isOwner) {
+		return -1;
+	}
+	int socketFd = ::accept4(m_rxSocketFd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (socketFd != -1) {
+		// Tuning only, the connection works with the default sizes
+		applyBufferSizes(socketFd, true, true);
+	}
+	return socketFd;
+}
+
 }
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -9,17 +10,193 @@
 #include <cerrno>
 #include <cassert>
 #include "MutexLock.h"
+#include "TimedWait.h"
+#include "UnixDomainSocketProtocol.h"
 
 namespace LightIPC {
 
-UnixDomainSocketClient::UnixDomainSocketClient(const std::string &path)
-	: UnixDomainSocket(path, false)
+// Generation of the rings created by this process
+static unsigned int s_bulkGeneration = 0;
+
+ResponseFuture::ResponseFuture()
+	: m_mutex()
+	, m_client(NULL)
+	, m_requestId(0)
+	, m_isReady(false)
+	, m_result()
+	, m_response()
+	, m_output(&m_response)
+{
+}
+
+ResponseFuture::~ResponseFuture()
+{
+	bool isPending = false;
+	{
+		MutexLock lock(&m_mutex);
+		isPending = (m_client && !m_isReady);
+	}
+	// Do not hold m_mutex, the response thread locks the client first
+	if (isPending) {
+		m_client->abandonRequest(m_requestId);
+	}
+}
+
+unsigned int ResponseFuture::RequestId()
+{
+	MutexLock lock(&m_mutex);
+	return m_requestId;
+}
+
+bool ResponseFuture::IsReady()
+{
+	MutexLock lock(&m_mutex);
+	return m_isReady;
+}
+
+Result ResponseFuture::Wait()
+{
+	MutexLock lock(&m_mutex);
+	if (m_client == NULL) {
+		return Result::CreateError("no request");
+	}
+	// wait() When exiting, it exits with the lock applied again (it is the same as before waiting())
+	while (!m_isReady) {
+		lock.Wait(); // Internally unlock and wait
+	}
+	return m_result;
+}
+
+Result ResponseFuture::TimedWait(unsigned int msec)
+{
+	timespec deadline = deadlineAfter(msec);
+	MutexLock lock(&m_mutex);
+	if (m_client == NULL) {
+		return Result::CreateError("no request");
+	}
+	while (!m_isReady) {
+		if (!lock.TimedWait(deadline)) {
+			break;
+		}
+	}
+	if (!m_isReady) {
+		return Result::CreateError("response timeout [%u msec]", msec);
+	}
+	return m_result;
+}
+
+Result ResponseFuture::Cancel()
+{
+	UnixDomainSocketClient *client = NULL;
+	unsigned int requestId = 0;
+	{
+		MutexLock lock(&m_mutex);
+		if (m_client == NULL || m_isReady) {
+			return Result::CreateError("no request in progress");
+		}
+		client = m_client;
+		requestId = m_requestId;
+	}
+	// Do not hold m_mutex, the client completes this handle
+	return client->CancelRequest(requestId);
+}
+
+ByteBuffer &ResponseFuture::Response()
+{
+	return m_response;
+}
+
+void ResponseFuture::complete(const Result &result, ByteBuffer *response)
+{
+	MutexLock lock(&m_mutex);
+	if (response) {
+		*m_output = *response; // copy
+	}
+	m_result = result;
+	m_isReady = true;
+	lock.Broadcast();
+}
+
+StreamWriter::StreamWriter()
+	: m_client(NULL)
+	, m_streamId(0)
+	, m_future()
+{
+}
+
+StreamWriter::~StreamWriter()
+{
+	if (m_client) {
+		Abort();
+	}
+}
+
+bool StreamWriter::IsOpen()
+{
+	return m_client != NULL;
+}
+
+Result StreamWriter::Write(const ByteBuffer &chunk)
+{
+	if (!m_client) {
+		return Result::CreateError("stream not open");
+	}
+	if (m_future.IsReady()) {
+		// The request failed (e.g. the server closed the connection)
+		return m_future.Wait();
+	}
+	return m_client->sendStream(m_streamId, 0, chunk);
+}
+
+Result StreamWriter::Close(ByteBuffer &response)
+{
+	if (!m_client) {
+		return Result::CreateError("stream not open");
+	}
+
+	ByteBuffer chunk;
+	Result result = m_client->sendStream(m_streamId, STREAM_END, chunk);
+	m_client = NULL;
+	if (result.IsError()) {
+		m_future.Cancel();
+		return result;
+	}
+	result = m_future.Wait();
+	if (result.IsSuccess()) {
+		const std::string &data = m_future.Response().Data();
+		response.Assign(data.data(), data.size());
+	}
+	return result;
+}
+
+Result StreamWriter::Abort()
+{
+	if (!m_client) {
+		return Result::CreateError("stream not open");
+	}
+
+	ByteBuffer chunk;
+	Result result = m_client->sendStream(m_streamId, STREAM_ABORT, chunk);
+	m_client = NULL;
+	m_future.Cancel();
+	return result;
+}
+
+UnixDomainSocketClient::UnixDomainSocketClient(const std::string &path, SocketMode mode, AddressType addressType, IoEngine engine)
+	: UnixDomainSocket(path, false, mode, addressType, engine)
 	, m_mutex()
 	, m_responseThread()
 	, m_receiver(NULL)
 	, m_isActive(false)
-	, m_responseArrived(false)
-	, m_isResponseError()
+	, m_responseMutex()
+	, m_nextRequestId(1)
+	, m_pendingRequests()
+	, m_notifyUpdate(0)
+	, m_noHeader(0)
+	, m_bulkRequestRing(NULL)
+	, m_bulkResponseRing(NULL)
+	, m_bulkThreshold(0)
+	, m_bulkDescriptor(0)
 {
 	OpenSocket();
 	start(false);
@@ -29,6 +206,8 @@ UnixDomainSocketClient::~UnixDomainSocketClient()
 {
 	stop();
 	CloseSocket();
+	delete m_bulkRequestRing;
+	delete m_bulkResponseRing;
 }
 
 void UnixDomainSocketClient::SetNotifyReceiver(INotifyReceiver *receiver)
@@ -41,114 +220,437 @@ Result UnixDomainSocketClient::SendReceive(ByteBuffer &request, ByteBuffer &resp
 	return privateSendReceive(request, response, 0);
 }
 
+Result UnixDomainSocketClient::TimedSendReceive(ByteBuffer &request, ByteBuffer &response, unsigned int msec)
+{
+	ResponseFuture future;
+	future.m_client = this;
+	future.m_output = &response; // The response thread writes directly to the caller's buffer
+
+	PendingRequest pending;
+	pending.handle = &future;
+	pending.receiver = NULL;
+	unsigned int requestId = 0;
+	Result result = sendRequest(request, REQUEST_MESSAGE, pending, requestId);
+	if (result.IsError()) {
+		future.complete(result, NULL);
+		return result;
+	}
+
+	result = future.TimedWait(msec);
+	if (future.IsReady()) {
+		return result;
+	}
+	// The late response is discarded by its request ID
+	if (future.Cancel().IsSuccess()) {
+		return Result::CreateError("response timeout [%u msec]", msec);
+	}
+	// The response arrived meanwhile
+	return future.Wait();
+}
+
+Result UnixDomainSocketClient::AsyncSendReceive(ByteBuffer &request, ResponseFuture &outResponse)
+{
+	return sendFutureRequest(request, REQUEST_MESSAGE, outResponse);
+}
+
+Result UnixDomainSocketClient::sendFutureRequest(ByteBuffer &request, unsigned int requestType, ResponseFuture &outResponse)
+{
+	{
+		MutexLock lock(&outResponse.m_mutex);
+		if (outResponse.m_client && !outResponse.m_isReady) {
+			return Result::CreateError("request in progress [%u]", outResponse.m_requestId);
+		}
+		outResponse.m_client = this;
+		outResponse.m_requestId = 0;
+		outResponse.m_isReady = false;
+		outResponse.m_result = Result::CreateSuccess();
+		outResponse.m_response.Clear();
+		outResponse.m_output = &outResponse.m_response;
+	}
+
+	PendingRequest pending;
+	pending.handle = &outResponse;
+	pending.receiver = NULL;
+	unsigned int requestId = 0;
+	Result result = sendRequest(request, requestType, pending, requestId);
+	if (result.IsError()) {
+		outResponse.complete(result, NULL);
+	}
+	return result;
+}
+
+Result UnixDomainSocketClient::AsyncSendReceive(ByteBuffer &request, IResponseReceiver *receiver, unsigned int &outRequestId)
+{
+	if (receiver == NULL) {
+		return Result::CreateError("no response receiver");
+	}
+	PendingRequest pending;
+	pending.handle = NULL;
+	pending.receiver = receiver;
+	return sendRequest(request, REQUEST_MESSAGE, pending, outRequestId);
+}
+
 Result UnixDomainSocketClient::privateSendReceive(ByteBuffer &request, ByteBuffer &response, unsigned int requestType)
+{
+	ResponseFuture future;
+	future.m_client = this;
+	future.m_output = &response; // The response thread writes directly to the caller's buffer
+
+	PendingRequest pending;
+	pending.handle = &future;
+	pending.receiver = NULL;
+	unsigned int requestId = 0;
+	Result result = sendRequest(request, requestType, pending, requestId);
+	if (result.IsError()) {
+		future.complete(result, NULL);
+		return result;
+	}
+	return future.Wait();
+}
+
+Result UnixDomainSocketClient::sendRequest(ByteBuffer &request, unsigned int requestType, const PendingRequest &pending, unsigned int &outRequestId)
 {
 	if (!IsOpend()) {
 		return Result::CreateError("closed socket");
 	}
-	// Synchronous processing during transmission and reception
-	MutexLock lock(&m_mutex);
-	// Access to received information is synchronous
-	MutexLock responseLock(&m_responseMutex);
+
+	// Register before sending, the response may arrive before Send() returns
+	unsigned int requestId = 0;
+	{
+		MutexLock responseLock(&m_responseMutex);
+		if (!m_isActive) {
+			return Result::CreateError("currently innactive");
+		}
+		// After a wrap, skip 0 (no correlation) and the IDs of the requests still waiting
+		do {
+			requestId = m_nextRequestId++;
+		} while (requestId == 0 || m_pendingRequests.count(requestId) != 0);
+		m_pendingRequests.insert(std::make_pair(requestId, pending));
+		if (pending.handle) {
+			MutexLock lock(&pending.handle->m_mutex);
+			pending.handle->m_requestId = requestId;
+		}
+	}
 
 	// Send request
-	ByteBuffer header;
-	header.Append(requestType);
-	Result result = Send(header, request);
+	Frame frame;
+	frame.type = static_cast<unsigned char>(requestType);
+	frame.flags = 0;
+	frame.correlationId = requestId;
+	Result result;
+	{
+		// Synchronous processing during transmission only
+		MutexLock lock(&m_mutex);
+		if (requestType == REQUEST_MESSAGE && m_bulkRequestRing && request.Size() >= m_bulkThreshold
+			&& m_bulkRequestRing->Write(request, m_bulkDescriptor)) {
+			// Only the descriptor goes over the socket
+			frame.flags = BULK_BODY;
+			result = Send(frame, m_noHeader, m_bulkDescriptor);
+			if (result.IsError()) {
+				m_bulkRequestRing->Discard();
+			}
+		} else {
+			result = Send(frame, m_noHeader, request);
+		}
+	}
 	if (result.IsError()) {
+		MutexLock responseLock(&m_responseMutex);
+		m_pendingRequests.erase(requestId);
 		return result;
 	}
 
-	// Response waiting process
-	{
-		// Clear received information
-		m_responseArrived = false;
-		m_isResponseError = Result::CreateSuccess();
-		m_responseHeader.Clear();
-		m_response.Clear();
+	outRequestId = requestId;
+	return result;
+}
 
-		// Wait until response data is received
-		// wait() When exiting, it exits with the lock applied again (it is the same as before waiting())
-		while (!m_responseArrived && m_isActive) {
-			responseLock.Wait(); // Internally unlock and wait
+void UnixDomainSocketClient::completeRequest(unsigned int requestId, ByteBuffer &response)
+{
+	IResponseReceiver *receiver = NULL;
+	{
+		MutexLock responseLock(&m_responseMutex);
+		std::map<unsigned int, PendingRequest>::iterator it = m_pendingRequests.find(requestId);
+		if (it == m_pendingRequests.end()) {
+			return; // nobody is waiting (throw away)
 		}
+		PendingRequest pending = it->second;
+		m_pendingRequests.erase(it);
 
-		// When inactive, do not care about subsequent states
-		if (!m_isActive) {
-			return Result::CreateError("currently innactive");
+		// Complete the handle under m_responseMutex so that it is not destroyed meanwhile
+		if (pending.handle) {
+			pending.handle->complete(Result::CreateSuccess(), &response);
+			return;
 		}
+		receiver = pending.receiver;
+	}
+	// Callback is called without any lock held
+	receiver->ReceiveResponse(requestId, Result::CreateSuccess(), response);
+}
 
-		if (m_isResponseError) {
-			return m_isResponseError;
+void UnixDomainSocketClient::receiveNotifyBatch(ByteBuffer &batch)
+{
+	int count = 0;
+	if (batch.Size() < sizeof(count)) {
+		return;
+	}
+	batch.Value(count);
+	for (int i = 0; i < count; i++) {
+		int size = 0;
+		if (batch.Size() - batch.Position() < sizeof(size)) {
+			break;
 		}
+		batch.Value(size);
+		unsigned int position = batch.Position();
+		if (size < 0 || batch.Size() - position < static_cast<size_t>(size)) {
+			break;
+		}
+		m_notifyUpdate.Assign(batch.Data().data() + position, size);
+		batch.SetPosition(position + size);
+		m_receiver->ReceiveNotify(m_notifyUpdate);
+	}
+}
 
-		// Check the received data because it has already been received
-		unsigned int responseType;
-		m_responseHeader.Value(responseType);
-		if (responseType == 0 || responseType == 2) {
-			response = m_response; // copy
+void UnixDomainSocketClient::failPendingRequests(const Result &result)
+{
+	std::map<unsigned int, IResponseReceiver *> receivers;
+	{
+		MutexLock responseLock(&m_responseMutex);
+		std::map<unsigned int, PendingRequest>::iterator ite = m_pendingRequests.begin();
+		std::map<unsigned int, PendingRequest>::iterator end = m_pendingRequests.end();
+		for (; ite != end; ite++) {
+			if (ite->second.handle) {
+				ite->second.handle->complete(result, NULL);
+			} else {
+				receivers.insert(std::make_pair(ite->first, ite->second.receiver));
+			}
 		}
+		m_pendingRequests.clear();
+	}
 
-		// Clear received information
-		m_responseArrived = false;
-		m_isResponseError = Result::CreateSuccess();
-		m_responseHeader.Clear();
-		m_response.Clear();
+	ByteBuffer empty;
+	std::map<unsigned int, IResponseReceiver *>::iterator ite = receivers.begin();
+	std::map<unsigned int, IResponseReceiver *>::iterator end = receivers.end();
+	for (; ite != end; ite++) {
+		ite->second->ReceiveResponse(ite->first, result, empty);
 	}
+}
 
+Result UnixDomainSocketClient::CancelRequest(unsigned int requestId)
+{
+	if (!failRequest(requestId, Result::CreateError("request canceled [%u]", requestId))) {
+		return Result::CreateError("no request in progress [%u]", requestId);
+	}
 	return Result::CreateSuccess();
 }
 
+bool UnixDomainSocketClient::failRequest(unsigned int requestId, const Result &result)
+{
+	IResponseReceiver *receiver = NULL;
+	{
+		MutexLock responseLock(&m_responseMutex);
+		std::map<unsigned int, PendingRequest>::iterator it = m_pendingRequests.find(requestId);
+		if (it == m_pendingRequests.end()) {
+			return false;
+		}
+		PendingRequest pending = it->second;
+		m_pendingRequests.erase(it);
+
+		if (pending.handle) {
+			pending.handle->complete(result, NULL);
+			return true;
+		}
+		receiver = pending.receiver;
+	}
+	// Callback is called without any lock held
+	ByteBuffer empty;
+	receiver->ReceiveResponse(requestId, result, empty);
+	return true;
+}
+
+Result UnixDomainSocketClient::OpenStream(StreamWriter &outWriter)
+{
+	if (outWriter.m_client) {
+		return Result::CreateError("stream in progress [%u]", outWriter.m_streamId);
+	}
+
+	// The first chunk (empty) opens the stream on the server, the response is sent when it ends
+	ByteBuffer chunk;
+	Result result = sendFutureRequest(chunk, STREAM_REQUEST, outWriter.m_future);
+	if (result.IsError()) {
+		return result;
+	}
+	outWriter.m_client = this;
+	outWriter.m_streamId = outWriter.m_future.RequestId();
+	return result;
+}
+
+Result UnixDomainSocketClient::sendStream(unsigned int streamId, unsigned int flags, const ByteBuffer &chunk)
+{
+	if (!IsOpend()) {
+		return Result::CreateError("closed socket");
+	}
+
+	Frame frame;
+	frame.type = STREAM_REQUEST;
+	frame.flags = static_cast<unsigned char>(flags);
+	frame.correlationId = streamId;
+
+	// Synchronous processing during transmission only
+	MutexLock lock(&m_mutex);
+	return Send(frame, m_noHeader, chunk);
+}
+
+Result UnixDomainSocketClient::EnableBulkChannel(size_t threshold, size_t capacity)
+{
+	if (threshold == 0 || threshold > capacity) {
+		return Result::CreateError("bulk channel error [threshold %lu, capacity %lu]"
+			, static_cast<unsigned long>(threshold), static_cast<unsigned long>(capacity));
+	}
+	{
+		MutexLock lock(&m_mutex);
+		if (m_bulkRequestRing) {
+			return Result::CreateError("bulk channel error [%s]", "already enabled");
+		}
+	}
+
+	BulkChannelOffer offer;
+	::memset(&offer, 0, sizeof(offer));
+	offer.capacity = capacity;
+	offer.generation = __sync_add_and_fetch(&s_bulkGeneration, 1);
+	offer.threshold = static_cast<unsigned int>(threshold);
+	std::snprintf(offer.requestRing, sizeof(offer.requestRing), "/LightIPC.bulk.%d.%u.req", ::getpid(), offer.generation);
+	std::snprintf(offer.responseRing, sizeof(offer.responseRing), "/LightIPC.bulk.%d.%u.res", ::getpid(), offer.generation);
+
+	BulkRing *requestRing = new BulkRing(offer.requestRing, capacity, offer.generation, true);
+	BulkRing *responseRing = new BulkRing(offer.responseRing, capacity, offer.generation, true);
+	if (!requestRing->IsOpend() || !responseRing->IsOpend()) {
+		delete requestRing;
+		delete responseRing;
+		return Result::CreateError("bulk channel error [%s]", "shared memory not created");
+	}
+
+	// The server may send the responses through the ring as soon as it has opened it
+	{
+		MutexLock responseLock(&m_responseMutex);
+		if (m_bulkResponseRing) {
+			// Another EnableBulkChannel() is in progress
+			delete requestRing;
+			delete responseRing;
+			return Result::CreateError("bulk channel error [%s]", "already enabled");
+		}
+		m_bulkResponseRing = responseRing;
+	}
+
+	// The server returns an empty response when it has opened the rings, the error otherwise
+	ByteBuffer request;
+	ByteBuffer response;
+	request.Assign(reinterpret_cast<const char *>(&offer), sizeof(offer));
+	Result result = privateSendReceive(request, response, BULK_OPEN);
+	if (result.IsSuccess() && !response.IsEmpty()) {
+		result = Result::CreateError("bulk channel error [%s]", response.Data().c_str());
+	}
+	if (result.IsError()) {
+		{
+			// The response thread reads the ring under m_responseMutex
+			MutexLock responseLock(&m_responseMutex);
+			m_bulkResponseRing = NULL;
+		}
+		delete requestRing;
+		delete responseRing;
+		return result;
+	}
+
+	MutexLock lock(&m_mutex);
+	m_bulkThreshold = threshold;
+	m_bulkRequestRing = requestRing;
+	return result;
+}
+
+bool UnixDomainSocketClient::IsBulkChannel()
+{
+	MutexLock lock(&m_mutex);
+	return m_bulkRequestRing != NULL;
+}
+
+void UnixDomainSocketClient::abandonRequest(unsigned int requestId)
+{
+	MutexLock responseLock(&m_responseMutex);
+	m_pendingRequests.erase(requestId);
+}
+
 Result UnixDomainSocketClient::Ping()
 {
 	ByteBuffer req;
 	ByteBuffer res;
 	req.Append("PING");
-	return privateSendReceive(req,res, 2);
+	return privateSendReceive(req,res, CLIENT_PING);
 }
 
 // Since there is an asynchronous notification from server , receive processing is performed by thread processing
 void UnixDomainSocketClient::Run()
 {
+	Result result;
+	Frame frame;
 	ByteBuffer header;
 	ByteBuffer response;
 	unsigned int responseType;
 	while (m_isActive) {
-		m_isResponseError = Receive(header, response);
-		if (m_isResponseError) {
-			// Receive error
-			MutexLock responseLock(&m_responseMutex);
-			m_responseArrived = true;
-			responseLock.Signal();
+		frame.correlationId = 0;
+		result = Receive(frame, header, response);
+		if (!m_isActive) {
+			break;
+		}
+		if (result.IsError()) {
+			if (!IsOpend()) {
+				// The server closed the connection (SOCKET_MODE_SEQPACKET), no more responses
+				{
+					MutexLock responseLock(&m_responseMutex);
+					m_isActive = false;
+				}
+				failPendingRequests(result);
+				break;
+			}
+			// Only the message whose Frame Header was decoded failed (request IDs start at 1),
+			// otherwise the socket skips to the next message and no request is affected
+			if (frame.correlationId != 0) {
+				failRequest(frame.correlationId, result);
+			}
 			continue;
 		}
 
-		if (!m_isActive) {
-			break;
+		responseType = frame.type;
+		if (responseType == REQUEST_MESSAGE && (frame.flags & RESPONSE_ERROR)) { // request/response message, failed on the server
+			failRequest(frame.correlationId, Result::CreateError("%s", response.Data().c_str()));
 		}
-		
-		header.Value(responseType);
-		header.SetPosition(0);
-		if (responseType == 0) { // request/response message
-			MutexLock responseLock(&m_responseMutex);
-			m_responseArrived = true;
-			m_responseHeader = header;
-			m_response = response;
-			responseLock.Signal();
+		else if (responseType == REQUEST_MESSAGE && (frame.flags & BULK_BODY)) { // request/response message, body in the bulk channel
+			{
+				// EnableBulkChannel() may drop the ring meanwhile
+				MutexLock responseLock(&m_responseMutex);
+				if (m_bulkResponseRing) {
+					result = m_bulkResponseRing->Read(response, response);
+				} else {
+					result = Result::CreateError("bulk channel error [%s]", "not enabled");
+				}
+			}
+			if (result.IsSuccess()) {
+				completeRequest(frame.correlationId, response);
+			} else {
+				failRequest(frame.correlationId, result);
+			}
+		}
+		else if (responseType == REQUEST_MESSAGE || responseType == CLIENT_PING || responseType == STREAM_REQUEST || responseType == BULK_OPEN) { // request/response message, PING from Client(Response), end of stream, bulk channel opened
+			completeRequest(frame.correlationId, response);
 		}
-		else if (responseType == 1){ // notify message
+		else if (responseType == NOTIFY_MESSAGE){ // notify message
 			if (m_receiver) {
 				m_receiver->ReceiveNotify(response);
 			}
 		}
-		else if (responseType == 2){ // PING from Client(Response)
-			MutexLock responseLock(&m_responseMutex);
-			m_responseArrived = true;
-			m_responseHeader = header;
-			m_response = response;
-			responseLock.Signal();
+		else if (responseType == NOTIFY_BATCH){ // coalesced notify messages
+			if (m_receiver) {
+				receiveNotifyBatch(response);
+			}
 		}
-		else if (responseType == 3){ // PING from Server(Notify)
+		else if (responseType == SERVER_PING){ // PING from Server(Notify)
 			// throw away
 		}
 		else {
@@ -173,9 +675,15 @@ void UnixDomainSocketClient::start(bool isBlock)
 
 void UnixDomainSocketClient::stop()
 {
-	m_isActive = false;
-	m_responseThread.Cancel();
+	{
+		MutexLock responseLock(&m_responseMutex);
+		m_isActive = false;
+	}
+	failPendingRequests(Result::CreateError("currently innactive"));
+	// Wake up the response thread blocked in Receive() instead of canceling it
+	Wakeup();
 	m_responseThread.Join();
+	ClearWakeup();
 }
 
 }
@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////
+/// @file	UnixDomainSocketProtocol.h
+/// @brief	Message types and flags of UnixDomainSocketClient and UnixDomainSocketServer (not installed)
+/// @author	henaiguo
+///////////////////////////////////////////////////////////
+
+#ifndef __LIGHT_IPC_UNIX_DOMAIN_SOCKET_PROTOCOL__
+#define __LIGHT_IPC_UNIX_DOMAIN_SOCKET_PROTOCOL__
+
+namespace LightIPC {
+
+// Message types in Frame::type
+static const unsigned int REQUEST_MESSAGE = 0;	// request and its response
+static const unsigned int NOTIFY_MESSAGE = 1;	// Notify() of the server
+static const unsigned int CLIENT_PING = 2;		// Ping() of the client, answered by the server
+static const unsigned int SERVER_PING = 3;		// Ping() of the server, discarded by the clients
+static const unsigned int STREAM_REQUEST = 4;	// chunk of a streamed request body
+static const unsigned int NOTIFY_BATCH = 5;		// coalesced notifications
+static const unsigned int BULK_OPEN = 6;		// opens the bulk channel
+
+// Stream flags in Frame::flags (STREAM_REQUEST)
+static const unsigned int STREAM_END = 0x1;
+static const unsigned int STREAM_ABORT = 0x2;
+
+// Body flag in Frame::flags: the body is a descriptor of a BulkRing (REQUEST_MESSAGE)
+static const unsigned int BULK_BODY = 0x4;
+
+// Response flag in Frame::flags: the request failed, the body is the error message (REQUEST_MESSAGE)
+static const unsigned int RESPONSE_ERROR = 0x8;
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -9,23 +10,96 @@
 #include <cerrno>
 #include <cassert>
 #include "MutexLock.h"
+#include "TimedWait.h"
+#include "UnixDomainSocketProtocol.h"
 
 namespace LightIPC {
 
-UnixDomainSocketServer::UnixDomainSocketServer(const std::string &path)
-	: UnixDomainSocket(path, true)
+// Requests the reception thread may queue ahead of the worker threads
+static const size_t MAX_QUEUED_REQUESTS = 1024;
+
+// epoll events handled per epoll_wait()
+static const int MAX_EPOLL_EVENTS = 64;
+
+// Upper limit of SetReceiveBatchSize() (messages of one recvmmsg)
+static const unsigned int MAX_RECEIVE_BATCH_SIZE = 64;
+
+UnixDomainSocketServer::UnixDomainSocketServer(const std::string &path, SocketMode mode, AddressType addressType, IoEngine engine)
+	: UnixDomainSocket(path, true, mode, addressType, engine)
 	, m_mutex()
+	, m_epollFd(-1)
+	, m_connections()
+	, m_nextConnectionId(0)
 	, m_receiveThread()
 	, m_requestReceiver(NULL)
+	, m_streamReceiver(NULL)
+	, m_streams()
+	, m_nextStreamId(0)
+	, m_bulkChannels()
 	, m_isActive(false)
+	, m_isStarted(false)
+	, m_workerCount(0)
+	, m_responseOrder(RESPONSE_ORDER_COMPLETION)
+	, m_workerThreads()
+	, m_worker(this)
+	, m_queueMutex()
+	, m_requestQueue()
+	, m_freeRequests()
+	, m_receiveBatchSize(16)
+	, m_receivingRequests()
+	, m_receiveBuffers()
+	, m_responseQueue()
+	, m_sendingRequests()
+	, m_sendBuffers()
+	, m_noHeader(0)
+	, m_isWorking(false)
+	, m_responseSequences()
+	, m_orderedRequests()
+	, m_notifyMutex()
+	, m_notifyMaxBytes(0)
+	, m_notifyDelay(0)
+	, m_notifyUpdates()
+	, m_notifyCount(0)
+	, m_notifyBytes(0)
+	, m_notifyKeys()
+	, m_notifyDeadline()
+	, m_isNotifying(false)
+	, m_notifyThread()
+	, m_notifyFlusher(this)
+	, m_notifyBatch()
 {
 	OpenSocket();
+	if (mode == SOCKET_MODE_SEQPACKET && IsOpend()) {
+		m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+		if (m_epollFd != -1) {
+			epoll_event event;
+			::memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.fd = ReceiveSocketFd();
+			::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, ReceiveSocketFd(), &event);
+			// Stop() wakes up epoll_wait() through it
+			event.data.fd = WakeupFd();
+			::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, WakeupFd(), &event);
+		}
+	}
 }
 
 UnixDomainSocketServer::~UnixDomainSocketServer()
 {
 	Stop();
+	closeConnections();
+	if (m_epollFd != -1) {
+		::close(m_epollFd);
+		m_epollFd = -1;
+	}
 	CloseSocket();
+	for (size_t i = 0; i < m_freeRequests.size(); i++) {
+		delete m_freeRequests[i];
+	}
+	MutexLock lock(&m_mutex);
+	while (!m_bulkChannels.empty()) {
+		closeBulkChannel(m_bulkChannels.begin()->first);
+	}
 }
 
 void UnixDomainSocketServer::SetReceiver(IRequestReceiver *receiver)
@@ -33,59 +107,662 @@ void UnixDomainSocketServer::SetReceiver(IRequestReceiver *receiver)
 	m_requestReceiver = receiver;
 }
 
+void UnixDomainSocketServer::SetStreamReceiver(IStreamReceiver *receiver)
+{
+	m_streamReceiver = receiver;
+}
+
+void UnixDomainSocketServer::SetWorkerCount(unsigned int count)
+{
+	m_workerCount = count;
+}
+
+void UnixDomainSocketServer::SetResponseOrder(ResponseOrder order)
+{
+	m_responseOrder = order;
+}
+
+void UnixDomainSocketServer::SetNotifyCoalescing(size_t maxBytes, unsigned int delayUsec)
+{
+	MutexLock lock(&m_notifyMutex);
+	m_notifyMaxBytes = maxBytes;
+	m_notifyDelay = delayUsec;
+}
+
+void UnixDomainSocketServer::SetReceiveBatchSize(unsigned int count)
+{
+	if (count < 1) {
+		count = 1;
+	}
+	if (count > MAX_RECEIVE_BATCH_SIZE) {
+		count = MAX_RECEIVE_BATCH_SIZE;
+	}
+	m_receiveBatchSize = count;
+}
+
 void UnixDomainSocketServer::Run()
 {
+	if (Mode() == SOCKET_MODE_SEQPACKET) {
+		runReactor();
+		return;
+	}
+
 	Result result;
-	ByteBuffer header;
-	ByteBuffer request;
-	ByteBuffer response;
 	while (m_isActive) {
-		// Block here until data is received
-		result = Receive(header, request);
+		prepareReceive();
+		size_t count = 0;
+		// Block here until data is received or Stop() wakes it up
+		result = ReceiveBatch(m_receiveBuffers, count);
+
+		// The requests received before an error are valid (also when stopping)
+		dispatchRequests(count, -1);
+		if (!m_isActive) {
+			break;
+		}
 		if (result.IsError()) {
 			if (m_requestReceiver) {
 				m_requestReceiver->ReceiveError(result);
 			}
+		}
+	}
+	m_isActive = false;
+}
+
+// One thread waits for the listening socket and all connections.
+// Level triggered: one batch is received per event so that a busy client does not starve the others,
+// the remaining messages are reported again by the next epoll_wait()
+void UnixDomainSocketServer::runReactor()
+{
+	if (m_epollFd == -1) {
+		if (m_requestReceiver) {
+			m_requestReceiver->ReceiveError(Result::CreateError("epoll error [%s]", "not opened"));
+		}
+		m_isActive = false;
+		return;
+	}
+
+	Result result;
+	epoll_event events[MAX_EPOLL_EVENTS];
+	while (m_isActive) {
+		int count = 0;
+		if (BusyPoll() > 0) {
+			// Spin on the events before sleeping in epoll_wait()
+			timespec start;
+			::clock_gettime(CLOCK_MONOTONIC, &start);
+			do {
+				count = ::epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, 0);
+			} while (count == 0 && IsBusyPollTime(start) && m_isActive);
+			CountBusyPoll(count != 0);
+		}
+		if (count == 0) {
+			count = ::epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, -1);
+		}
+		if (count == -1) {
+			if (errno != EINTR && m_requestReceiver) {
+				m_requestReceiver->ReceiveError(Result::CreateError("epoll error [%s]", ::strerror(errno)));
+			}
 			continue;
 		}
-		if (!m_isActive) {
-			break;
+
+		for (int i = 0; i < count && m_isActive; i++) {
+			int socketFd = events[i].data.fd;
+			if (socketFd == ReceiveSocketFd()) {
+				acceptConnection();
+				continue;
+			}
+			if (socketFd == WakeupFd()) {
+				// Stop() cleared m_isActive
+				continue;
+			}
+			if (!(events[i].events & EPOLLIN)) {
+				// EPOLLHUP/EPOLLERR without data
+				closeConnection(socketFd);
+				continue;
+			}
+
+			prepareReceive();
+			size_t received = 0;
+			bool isClosed = false;
+			result = ReceiveBatch(socketFd, m_receiveBuffers, received, isClosed);
+			dispatchRequests(received, socketFd);
+			if (!m_isActive) {
+				// Woken up by Stop(), the connection is still alive
+				break;
+			}
+			if (isClosed) {
+				closeConnection(socketFd);
+				continue;
+			}
+			if (result.IsError()) {
+				// The rest of the message can not be found any more, drop the connection
+				if (m_requestReceiver) {
+					m_requestReceiver->ReceiveError(result);
+				}
+				closeConnection(socketFd);
+			}
 		}
-		
-		unsigned int requestType;
-		header.Value(requestType);
-		if (requestType == 2) { // PING
-			header.SetPosition(0);
-			response.Append("OK");
+	}
+	m_isActive = false;
+}
+
+void UnixDomainSocketServer::acceptConnection()
+{
+	int socketFd = AcceptConnection();
+	if (socketFd == -1) {
+		if (m_requestReceiver) {
+			m_requestReceiver->ReceiveError(Result::CreateError("accept error [%s]", ::strerror(errno)));
 		}
-		else {
-			if (m_requestReceiver) {
-				m_requestReceiver->Received(request,response);
+		return;
+	}
+
+	MutexLock lock(&m_mutex);
+	epoll_event event;
+	::memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.fd = socketFd;
+	if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, socketFd, &event) == -1) {
+		::close(socketFd);
+		return;
+	}
+	m_connections[socketFd] = ++m_nextConnectionId;
+}
+
+void UnixDomainSocketServer::closeConnection(int socketFd)
+{
+	// Responses of the connection still being processed are discarded by sendResponse()
+	unsigned long connectionId = 0;
+	{
+		MutexLock lock(&m_mutex);
+		std::map<int, unsigned long>::iterator it = m_connections.find(socketFd);
+		if (it == m_connections.end()) {
+			return;
+		}
+		connectionId = it->second;
+		m_connections.erase(it);
+		::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, socketFd, NULL);
+		::close(socketFd);
+		closeBulkChannel(connectionId);
+		dropResponseSequence(connectionId);
+	}
+	abortStreams(connectionId);
+}
+
+void UnixDomainSocketServer::closeConnections()
+{
+	MutexLock lock(&m_mutex);
+	std::map<int, unsigned long>::iterator ite = m_connections.begin();
+	std::map<int, unsigned long>::iterator end = m_connections.end();
+	for (; ite != end; ite++) {
+		::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, ite->first, NULL);
+		::close(ite->first);
+	}
+	m_connections.clear();
+}
+
+size_t UnixDomainSocketServer::ConnectionCount()
+{
+	MutexLock lock(&m_mutex);
+	return m_connections.size();
+}
+
+void UnixDomainSocketServer::prepareReceive()
+{
+	while (m_receivingRequests.size() < m_receiveBatchSize) {
+		m_receivingRequests.push_back(allocateRequest());
+	}
+	m_receiveBuffers.resize(m_receivingRequests.size());
+	for (size_t i = 0; i < m_receivingRequests.size(); i++) {
+		Request *request = m_receivingRequests[i];
+		request->header.Clear();
+		request->request.Clear();
+		m_receiveBuffers[i].frame = &request->frame;
+		m_receiveBuffers[i].header = &request->header;
+		m_receiveBuffers[i].body = &request->request;
+	}
+}
+
+void UnixDomainSocketServer::dispatchRequests(size_t count, int socketFd)
+{
+	if (count == 0) {
+		return;
+	}
+
+	unsigned long connectionId = 0;
+	ResponseSequence *sequence = NULL;
+	{
+		MutexLock lock(&m_mutex);
+		if (socketFd != -1) {
+			connectionId = m_connections[socketFd];
+		}
+		// The entry is removed only by closeConnection() on this thread
+		sequence = &m_responseSequences[connectionId];
+	}
+
+	// Stream chunks and bulk channels are handled here in the order of arrival,
+	// the other requests are kept for processing
+	size_t kept = 0;
+	bool isResponded = false;
+	for (size_t i = 0; i < count; i++) {
+		Request *request = m_receivingRequests[i];
+		request->socketFd = socketFd;
+		request->connectionId = connectionId;
+		if (request->frame.type == BULK_OPEN) {
+			openBulkChannel(request);
+			request->sequence = sequence->nextRequest++;
+			MutexLock lock(&m_queueMutex);
+			m_responseQueue.push_back(request);
+			isResponded = true;
+			continue;
+		}
+		if (request->frame.type != STREAM_REQUEST) {
+			if (request->frame.flags & BULK_BODY) {
+				// The ring is released in the order of arrival, read the body now
+				Result result = readBulkBody(request);
+				if (result.IsError()) {
+					if (m_requestReceiver) {
+						m_requestReceiver->ReceiveError(result);
+					}
+					// The client waits for the response, return the error instead
+					const std::string &error = result.ErrorMessage();
+					request->isFailed = true;
+					request->response.Assign(error.data(), error.size());
+					request->sequence = sequence->nextRequest++;
+					MutexLock lock(&m_queueMutex);
+					m_responseQueue.push_back(request);
+					isResponded = true;
+					continue;
+				}
 			}
+			request->sequence = sequence->nextRequest++;
+			m_receivingRequests[kept++] = request;
+			continue;
+		}
+		if (handleStream(request)) {
+			request->sequence = sequence->nextRequest++;
+			MutexLock lock(&m_queueMutex);
+			m_responseQueue.push_back(request);
+			isResponded = true;
+		} else {
+			releaseRequest(request);
 		}
+	}
+	m_receivingRequests.erase(m_receivingRequests.begin() + kept, m_receivingRequests.begin() + count);
+	count = kept;
+	if (isResponded) {
+		flushResponses();
+	}
+	if (count == 0) {
+		return;
+	}
 
-		// Synchronous processing during transmission
+	if (m_workerThreads.empty()) {
+		// Process them all, then send the responses together
+		for (size_t i = 0; i < count; i++) {
+			processRequest(m_receivingRequests[i]);
+		}
 		{
-			MutexLock lock(&m_mutex);
-			result = Send(header, response);
-			if (result.IsError()) {
-				if (m_requestReceiver && requestType != 2) {
-					m_requestReceiver->ResponseError(result);
+			MutexLock lock(&m_queueMutex);
+			m_responseQueue.insert(m_responseQueue.end(), m_receivingRequests.begin(), m_receivingRequests.begin() + count);
+		}
+		m_receivingRequests.erase(m_receivingRequests.begin(), m_receivingRequests.begin() + count);
+		flushResponses();
+		return;
+	}
+
+	// Queue for the worker threads, wait while they are behind
+	{
+		MutexLock lock(&m_queueMutex);
+		for (size_t i = 0; i < count; i++) {
+			while (m_requestQueue.size() >= MAX_QUEUED_REQUESTS && m_isWorking) {
+				lock.Wait();
+			}
+			m_requestQueue.push_back(m_receivingRequests[i]);
+			lock.Broadcast();
+		}
+	}
+	m_receivingRequests.erase(m_receivingRequests.begin(), m_receivingRequests.begin() + count);
+}
+
+bool UnixDomainSocketServer::handleStream(Request *request)
+{
+	unsigned int requestId = request->frame.correlationId;
+	unsigned int flags = request->frame.flags;
+
+	// The first chunk opens the stream
+	std::pair<unsigned long, unsigned int> key(request->connectionId, requestId);
+	std::map<std::pair<unsigned long, unsigned int>, unsigned long>::iterator it = m_streams.find(key);
+	unsigned long streamId = 0;
+	if (it == m_streams.end()) {
+		if (flags & STREAM_ABORT) {
+			return false;
+		}
+		streamId = ++m_nextStreamId;
+		m_streams.insert(std::make_pair(key, streamId));
+		if (m_streamReceiver) {
+			m_streamReceiver->StreamBegin(streamId);
+		}
+	} else {
+		streamId = it->second;
+	}
+
+	if (flags & STREAM_ABORT) {
+		m_streams.erase(key);
+		if (m_streamReceiver) {
+			m_streamReceiver->StreamAborted(streamId);
+		}
+		return false;
+	}
+	if (!request->request.IsEmpty() && m_streamReceiver) {
+		m_streamReceiver->StreamReceived(streamId, request->request);
+	}
+	if (flags & STREAM_END) {
+		m_streams.erase(key);
+		if (m_streamReceiver) {
+			m_streamReceiver->StreamEnd(streamId, request->response);
+		}
+		return true;
+	}
+	return false;
+}
+
+void UnixDomainSocketServer::abortStreams(unsigned long connectionId)
+{
+	std::map<std::pair<unsigned long, unsigned int>, unsigned long>::iterator it = m_streams.begin();
+	while (it != m_streams.end()) {
+		if (it->first.first != connectionId) {
+			it++;
+			continue;
+		}
+		unsigned long streamId = it->second;
+		m_streams.erase(it++);
+		if (m_streamReceiver) {
+			m_streamReceiver->StreamAborted(streamId);
+		}
+	}
+}
+
+void UnixDomainSocketServer::openBulkChannel(Request *request)
+{
+	BulkChannelOffer offer;
+	if (request->request.Size() != sizeof(offer)) {
+		std::string error("invalid offer");
+		request->response.Assign(error.data(), error.size());
+		return;
+	}
+	::memcpy(&offer, request->request.Data().data(), sizeof(offer));
+	offer.requestRing[sizeof(offer.requestRing) - 1] = '\0';
+	offer.responseRing[sizeof(offer.responseRing) - 1] = '\0';
+
+	BulkChannel channel;
+	channel.requestRing = new BulkRing(offer.requestRing, static_cast<size_t>(offer.capacity), offer.generation, false);
+	channel.responseRing = new BulkRing(offer.responseRing, static_cast<size_t>(offer.capacity), offer.generation, false);
+	channel.threshold = offer.threshold;
+	if (!channel.requestRing->IsOpend() || !channel.responseRing->IsOpend() || channel.threshold == 0) {
+		delete channel.requestRing;
+		delete channel.responseRing;
+		std::string error("rings not opened");
+		request->response.Assign(error.data(), error.size());
+		return;
+	}
+
+	// A client that opens the channel again replaces its rings
+	MutexLock lock(&m_mutex);
+	closeBulkChannel(request->connectionId);
+	m_bulkChannels.insert(std::make_pair(request->connectionId, channel));
+}
+
+Result UnixDomainSocketServer::readBulkBody(Request *request)
+{
+	BulkRing *ring = NULL;
+	{
+		MutexLock lock(&m_mutex);
+		std::map<unsigned long, BulkChannel>::iterator it = m_bulkChannels.find(request->connectionId);
+		if (it != m_bulkChannels.end()) {
+			ring = it->second.requestRing;
+		}
+	}
+	if (ring == NULL) {
+		return Result::CreateError("bulk channel error [%s]", "not opened");
+	}
+	// Only the reception thread closes the channel, the ring stays valid without the lock
+	return ring->Read(request->request, request->request);
+}
+
+void UnixDomainSocketServer::closeBulkChannel(unsigned long connectionId)
+{
+	std::map<unsigned long, BulkChannel>::iterator it = m_bulkChannels.find(connectionId);
+	if (it == m_bulkChannels.end()) {
+		return;
+	}
+	delete it->second.requestRing;
+	delete it->second.responseRing;
+	m_bulkChannels.erase(it);
+}
+
+void UnixDomainSocketServer::dropResponseSequence(unsigned long connectionId)
+{
+	std::map<unsigned long, ResponseSequence>::iterator found = m_responseSequences.find(connectionId);
+	if (found == m_responseSequences.end()) {
+		return;
+	}
+	std::map<unsigned long, Request *>::iterator ite = found->second.completed.begin();
+	std::map<unsigned long, Request *>::iterator end = found->second.completed.end();
+	for (; ite != end; ite++) {
+		releaseRequest(ite->second);
+	}
+	m_responseSequences.erase(found);
+}
+
+// Called when the reception thread ends
+void UnixDomainSocketServer::Cleanup()
+{
+	for (size_t i = 0; i < m_receivingRequests.size(); i++) {
+		releaseRequest(m_receivingRequests[i]);
+	}
+	m_receivingRequests.clear();
+}
+
+void UnixDomainSocketServer::processQueue()
+{
+	while (true) {
+		Request *request = NULL;
+		{
+			MutexLock lock(&m_queueMutex);
+			while (m_requestQueue.empty() && m_isWorking) {
+				lock.Wait();
+			}
+			// Process the remaining requests before stopping
+			if (m_requestQueue.empty()) {
+				break;
+			}
+			request = m_requestQueue.front();
+			m_requestQueue.pop_front();
+			lock.Broadcast();
+		}
+		processRequest(request);
+		{
+			MutexLock lock(&m_queueMutex);
+			m_responseQueue.push_back(request);
+		}
+		flushResponses();
+	}
+}
+
+void UnixDomainSocketServer::processRequest(Request *request)
+{
+	if (request->frame.type == CLIENT_PING) {
+		request->response.Append("OK");
+	}
+	else {
+		if (m_requestReceiver) {
+			m_requestReceiver->Received(request->request, request->response);
+		}
+	}
+}
+
+// The thread that gets m_mutex sends the responses queued meanwhile by the other workers as well,
+// a worker whose response has already been sent finds the queue empty
+void UnixDomainSocketServer::flushResponses()
+{
+	// Synchronous processing during transmission
+	MutexLock lock(&m_mutex);
+	{
+		MutexLock queueLock(&m_queueMutex);
+		if (m_responseQueue.empty()) {
+			return;
+		}
+		m_sendingRequests.swap(m_responseQueue);
+	}
+
+	if (m_responseOrder == RESPONSE_ORDER_REQUEST && !m_workerThreads.empty()) {
+		// Hold back the responses until the preceding ones of the same connection are ready,
+		// a slow request of one client does not delay the others
+		for (size_t i = 0; i < m_sendingRequests.size(); i++) {
+			Request *request = m_sendingRequests[i];
+			std::map<unsigned long, ResponseSequence>::iterator found = m_responseSequences.find(request->connectionId);
+			if (found == m_responseSequences.end()) {
+				// The connection has been closed
+				releaseRequest(request);
+				continue;
+			}
+			ResponseSequence &sequence = found->second;
+			sequence.completed.insert(std::make_pair(request->sequence, request));
+			std::map<unsigned long, Request *>::iterator it = sequence.completed.find(sequence.nextResponse);
+			while (it != sequence.completed.end()) {
+				m_orderedRequests.push_back(it->second);
+				sequence.completed.erase(it);
+				it = sequence.completed.find(++sequence.nextResponse);
+			}
+		}
+		m_sendingRequests.swap(m_orderedRequests);
+		m_orderedRequests.clear();
+	}
+
+	sendResponses();
+	for (size_t i = 0; i < m_sendingRequests.size(); i++) {
+		releaseRequest(m_sendingRequests[i]);
+	}
+	m_sendingRequests.clear();
+}
+
+void UnixDomainSocketServer::sendResponses()
+{
+	size_t begin = 0;
+	while (begin < m_sendingRequests.size()) {
+		// Responses to the same connection are sent together
+		int socketFd = m_sendingRequests[begin]->socketFd;
+		unsigned long connectionId = m_sendingRequests[begin]->connectionId;
+		bool isPing = true;
+		BulkChannel *channel = NULL;
+		std::map<unsigned long, BulkChannel>::iterator bulk = m_bulkChannels.find(connectionId);
+		if (bulk != m_bulkChannels.end()) {
+			channel = &bulk->second;
+		}
+		m_sendBuffers.clear();
+		size_t end = begin;
+		for (; end < m_sendingRequests.size(); end++) {
+			Request *request = m_sendingRequests[end];
+			if (request->socketFd != socketFd || request->connectionId != connectionId) {
+				break;
+			}
+			MessageBuffer message;
+			message.frame = &request->frame;
+			message.header = &request->header;
+			message.body = &request->response;
+			if (request->frame.type == REQUEST_MESSAGE) {
+				// The frame of the request is returned, the flag tells where this body is
+				request->frame.flags = 0;
+				if (request->isFailed) {
+					request->frame.flags = RESPONSE_ERROR;
+				} else if (channel && request->response.Size() >= channel->threshold
+					&& channel->responseRing->Write(request->response, request->bulk)) {
+					request->frame.flags = BULK_BODY;
+					message.body = &request->bulk;
 				}
 			}
+			m_sendBuffers.push_back(message);
+			isPing = isPing && (request->frame.type == CLIENT_PING);
 		}
+		begin = end;
 
-		response.Clear();
-		request.Clear();
+		Result result;
+		if (Mode() == SOCKET_MODE_SEQPACKET) {
+			// The client may have disconnected and its descriptor may have been reused
+			std::map<int, unsigned long>::iterator it = m_connections.find(socketFd);
+			if (it == m_connections.end() || it->second != connectionId) {
+				continue;
+			}
+			result = sendToConnection(socketFd, m_sendBuffers);
+		} else {
+			result = SendBatch(m_sendBuffers);
+		}
+		if (result.IsError()) {
+			if (m_requestReceiver && !isPing) {
+				m_requestReceiver->ResponseError(result);
+			}
+		}
 	}
-	m_isActive = false;
+}
+
+UnixDomainSocketServer::Request *UnixDomainSocketServer::allocateRequest()
+{
+	{
+		MutexLock lock(&m_queueMutex);
+		if (!m_freeRequests.empty()) {
+			Request *request = m_freeRequests.back();
+			m_freeRequests.pop_back();
+			return request;
+		}
+	}
+	return new Request();
+}
+
+void UnixDomainSocketServer::releaseRequest(Request *request)
+{
+	request->header.Clear();
+	request->request.Clear();
+	request->response.Clear();
+	request->bulk.Clear();
+	request->isFailed = false;
+
+	MutexLock lock(&m_queueMutex);
+	m_freeRequests.push_back(request);
 }
 
 void UnixDomainSocketServer::Start(bool isBlock)
 {
+	if (m_isStarted) {
+		return;
+	}
+	m_isStarted = true;
+	m_isActive = true;
+	{
+		MutexLock lock(&m_mutex);
+		m_responseSequences.clear();
+	}
+	{
+		MutexLock lock(&m_queueMutex);
+		m_isWorking = true;
+	}
+	for (unsigned int i = 0; i < m_workerCount; i++) {
+		Thread *worker = new Thread(&m_worker, NULL);
+		worker->SetName("requestWorker");
+		worker->Start();
+		m_workerThreads.push_back(worker);
+	}
+
+	{
+		MutexLock lock(&m_notifyMutex);
+		m_isNotifying = (m_notifyMaxBytes > 0 && m_notifyDelay > 0);
+	}
+	if (m_isNotifying) {
+		m_notifyThread.SetRunner(&m_notifyFlusher, NULL);
+		m_notifyThread.SetName("notifyThread");
+		m_notifyThread.Start();
+	}
+
 	m_receiveThread.SetRunner(this, NULL);
 	m_receiveThread.SetName("receiveThread");
-	m_isActive = true;
 	m_receiveThread.Start();
 	if (isBlock) {
 		m_receiveThread.Join();
@@ -94,30 +771,231 @@ void UnixDomainSocketServer::Start(bool isBlock)
 
 void UnixDomainSocketServer::Stop()
 {
+	// Stop() is also called by the destructor, the thread can be joined only once
+	if (!m_isStarted) {
+		return;
+	}
+	m_isStarted = false;
+	// Wake up the reception thread blocked in poll()/epoll_wait() instead of canceling it,
+	// it dispatches what it has received and returns
 	m_isActive = false;
-	m_receiveThread.Cancel();
+	Wakeup();
 	m_receiveThread.Join();
+	ClearWakeup();
+
+	// Worker threads finish the queued requests and stop
+	{
+		MutexLock lock(&m_queueMutex);
+		m_isWorking = false;
+		lock.Broadcast();
+	}
+	for (size_t i = 0; i < m_workerThreads.size(); i++) {
+		m_workerThreads[i]->Join();
+		delete m_workerThreads[i];
+	}
+	m_workerThreads.clear();
+
+	// The flush thread sends the queued notifications and stops
+	bool isNotifying = false;
+	{
+		MutexLock lock(&m_notifyMutex);
+		isNotifying = m_isNotifying;
+		m_isNotifying = false;
+		lock.Broadcast();
+	}
+	if (isNotifying) {
+		m_notifyThread.Join();
+	}
+
+	// Responses held back for the order can no longer be completed
+	MutexLock lock(&m_mutex);
+	while (!m_responseSequences.empty()) {
+		dropResponseSequence(m_responseSequences.begin()->first);
+	}
 }
 
 Result UnixDomainSocketServer::Notify(ByteBuffer &update)
 {
 	// Synchronous processing during transmission
 	MutexLock lock(&m_mutex);
-	ByteBuffer header;
-	unsigned int requestType = 1;
-	header.Append(requestType);
-	return Send(header, update); 
+	Frame frame = {NOTIFY_MESSAGE, 0, 0};
+	m_sendBuffers.resize(1);
+	m_sendBuffers[0].frame = &frame;
+	m_sendBuffers[0].header = &m_noHeader;
+	m_sendBuffers[0].body = &update;
+	return broadcast(m_sendBuffers);
+}
+
+Result UnixDomainSocketServer::Notify(std::vector<ByteBuffer> &updates)
+{
+	// Synchronous processing during transmission
+	MutexLock lock(&m_mutex);
+	Frame frame = {NOTIFY_MESSAGE, 0, 0};
+	m_sendBuffers.resize(updates.size());
+	for (size_t i = 0; i < updates.size(); i++) {
+		m_sendBuffers[i].frame = &frame;
+		m_sendBuffers[i].header = &m_noHeader;
+		m_sendBuffers[i].body = &updates[i];
+	}
+	return broadcast(m_sendBuffers);
+}
+
+Result UnixDomainSocketServer::QueueNotify(ByteBuffer &update)
+{
+	return queueNotify(false, 0, update);
+}
+
+Result UnixDomainSocketServer::QueueNotify(unsigned int key, ByteBuffer &update)
+{
+	return queueNotify(true, key, update);
+}
+
+Result UnixDomainSocketServer::queueNotify(bool isKeyed, unsigned int key, ByteBuffer &update)
+{
+	bool isDisabled = false;
+	{
+		MutexLock lock(&m_notifyMutex);
+		if (m_notifyMaxBytes == 0) {
+			isDisabled = true;
+		}
+		else {
+			const std::string &data = update.Data();
+			std::map<unsigned int, size_t>::iterator it = m_notifyKeys.end();
+			if (isKeyed) {
+				it = m_notifyKeys.find(key);
+			}
+			if (it != m_notifyKeys.end()) {
+				// Latest value wins
+				ByteBuffer &queued = m_notifyUpdates[it->second];
+				m_notifyBytes -= queued.Size();
+				queued.Assign(data.data(), data.size());
+			}
+			else {
+				if (m_notifyCount == m_notifyUpdates.size()) {
+					m_notifyUpdates.push_back(ByteBuffer(0));
+				}
+				m_notifyUpdates[m_notifyCount].Assign(data.data(), data.size());
+				if (isKeyed) {
+					m_notifyKeys.insert(std::make_pair(key, m_notifyCount));
+				}
+				m_notifyCount++;
+				if (m_notifyCount == 1) {
+					// The first update starts the delay
+					m_notifyDeadline = deadlineAfterUsec(m_notifyDelay);
+					lock.Signal();
+				}
+			}
+			m_notifyBytes += data.size();
+			if (m_notifyBytes < m_notifyMaxBytes) {
+				return Result::CreateSuccess();
+			}
+		}
+	}
+
+	if (isDisabled) {
+		return Notify(update);
+	}
+	return FlushNotify();
+}
+
+Result UnixDomainSocketServer::FlushNotify()
+{
+	// Synchronous processing during transmission
+	MutexLock lock(&m_mutex);
+	{
+		MutexLock notifyLock(&m_notifyMutex);
+		if (m_notifyCount == 0) {
+			return Result::CreateSuccess();
+		}
+		// count, then each update with its size
+		m_notifyBatch.Clear();
+		m_notifyBatch.Append(static_cast<int>(m_notifyCount));
+		for (size_t i = 0; i < m_notifyCount; i++) {
+			m_notifyBatch.Append(m_notifyUpdates[i]);
+			m_notifyUpdates[i].Clear();
+		}
+		m_notifyCount = 0;
+		m_notifyBytes = 0;
+		m_notifyKeys.clear();
+	}
+
+	Frame frame = {NOTIFY_BATCH, 0, 0};
+	m_sendBuffers.resize(1);
+	m_sendBuffers[0].frame = &frame;
+	m_sendBuffers[0].header = &m_noHeader;
+	m_sendBuffers[0].body = &m_notifyBatch;
+	return broadcast(m_sendBuffers);
+}
+
+void UnixDomainSocketServer::flushNotifyQueue()
+{
+	while (true) {
+		{
+			MutexLock lock(&m_notifyMutex);
+			while (m_notifyCount == 0 && m_isNotifying) {
+				lock.Wait();
+			}
+			if (!m_isNotifying) {
+				break;
+			}
+			// Woken up by the first update, or the updates were sent by size meanwhile
+			while (m_notifyCount > 0 && m_isNotifying && lock.TimedWait(m_notifyDeadline)) {
+			}
+		}
+		Result result = FlushNotify();
+		if (result.IsError() && m_requestReceiver) {
+			m_requestReceiver->ResponseError(result);
+		}
+	}
+
+	// Send the remaining updates before stopping
+	Result result = FlushNotify();
+	if (result.IsError() && m_requestReceiver) {
+		m_requestReceiver->ResponseError(result);
+	}
 }
 
 Result UnixDomainSocketServer::Ping()
 {
 	MutexLock lock(&m_mutex);
-	ByteBuffer header;
 	ByteBuffer body;
-	unsigned int requestType = 3; // PING from Server
-	header.Append(requestType);
+	Frame frame = {SERVER_PING, 0, 0};
 	body.Append("PING");
-	return Send(header, body); 
+	m_sendBuffers.resize(1);
+	m_sendBuffers[0].frame = &frame;
+	m_sendBuffers[0].header = &m_noHeader;
+	m_sendBuffers[0].body = &body;
+	return broadcast(m_sendBuffers);
+}
+
+Result UnixDomainSocketServer::broadcast(const std::vector<MessageBuffer> &messages)
+{
+	if (Mode() != SOCKET_MODE_SEQPACKET) {
+		return SendBatch(messages);
+	}
+
+	Result result;
+	std::map<int, unsigned long>::iterator ite = m_connections.begin();
+	std::map<int, unsigned long>::iterator end = m_connections.end();
+	for (; ite != end; ite++) {
+		Result sent = sendToConnection(ite->first, messages);
+		if (sent.IsError() && result.IsSuccess()) {
+			result = sent;
+		}
+	}
+	return result;
 }
 
-}
\ No newline at end of file
+Result UnixDomainSocketServer::sendToConnection(int socketFd, const std::vector<MessageBuffer> &messages)
+{
+	bool isTimedOut = false;
+	Result result = SendBatch(socketFd, messages, isTimedOut);
+	if (isTimedOut) {
+		// The client does not receive: the rest of a message can not be sent later,
+		// shut the connection down so that the reception thread closes it
+		::shutdown(socketFd, SHUT_RDWR);
+	}
+	return result;
+}
+
+}